@@ -1,12 +1,14 @@
 #include "stdafx.h"
 #include "app_manager.h"
 #include "PlayerDlg.h"
+#include "game_downloader.h"
 
 const DWORD PLAY_TIMER = ::RegisterWindowMessageW(L"WG_FORGE_PLAY_TIMER");
 
 PlayerDlg::PlayerDlg(AppManager::GameController* pController)
 	: m_pController(pController)
 	, m_bMouseCaptured(false)
+	, m_nLoadedUntil(-1)
 	, m_hParentWnd(HWND_DESKTOP)
 	, m_hThread(NULL)
 	, m_hTerminateEvent(::CreateEvent(NULL, TRUE, FALSE, NULL))
@@ -31,6 +33,22 @@ void PlayerDlg::maxTurn(int val)
 
 void PlayerDlg::tick(float deltaTime)
 {
+	// downloaded part of the game is shown as trackbar selection
+	DownloadProgress progress = m_pController->downloadProgress();
+	if (progress.loadedUntil != m_nLoadedUntil)
+	{
+		m_nLoadedUntil = progress.loadedUntil;
+		if (m_nLoadedUntil < progress.firstTurn)
+		{
+			m_tracker.ClearSel(TRUE);
+		}
+		else
+		{
+			m_tracker.SetSelection(progress.firstTurn, m_nLoadedUntil);
+			m_tracker.Invalidate(FALSE);
+		}
+	}
+
 	if (!m_bPause)
 	{
 		auto newTurnValue = m_pController->turn() + deltaTime / m_stepTime;
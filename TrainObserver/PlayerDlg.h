@@ -61,6 +61,7 @@ protected:
 private:
 	AppManager::GameController* m_pController;
 	int m_nMaxTurn;
+	int m_nLoadedUntil;
 	CTrackBarCtrl m_tracker;	
 
 	// for move window implement
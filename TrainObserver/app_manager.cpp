@@ -2,7 +2,11 @@
 #include "app_manager.h"
 #include "scene_manager.h"
 #include "window_manager.h"
-#include "connection_manager.h"
+#include "async_connection.h"
+#include "game_downloader.h"
+#include "replay_transport.h"
+#include "trace.h"
+#include "network_stats.h"
 #include "render_dx9.h"
 #include "log.h"
 #include "json_query_builder.h"
@@ -11,15 +15,26 @@
 #include "SelectGameDlg.h"
 #include "PlayerDlg.h"
 
+const uint DEFAULT_DOWNLOAD_SESSIONS = 4;
+// longest the observer session waits for a response before the connection is considered dead
+const int RECEIVE_TIMEOUT_MS = 5000;
 
 AppManager::AppManager()
 	: m_sceneManager(new SceneManager())
 	, m_windowManager(new WindowManager())
 	, m_renderSystem(new RenderSystemDX9())
 	, m_connectionManager(new ConnectionManager())
+	, m_connection(new AsyncConnection(*m_connectionManager))
+	, m_downloader(new GameDownloader())
+	, m_stats(std::make_shared<NetworkStats>())
+	, m_port(0)
+	, m_downloadSessions(DEFAULT_DOWNLOAD_SESSIONS)
 	, m_connected(false)
-	, m_gameController(this, m_connectionManager.get())
+	, m_gameController(this, m_connection.get())
 {
+	m_connectionManager->setStats(m_stats);
+	m_connectionManager->setReceiveTimeout(RECEIVE_TIMEOUT_MS);
+	m_downloader->setStats(m_stats);
 }
 
 
@@ -79,43 +94,58 @@ bool AppManager::connect(const char* servername, uint16_t portNumber)
 		disconnect();
 	}
 
-	if (!m_connectionManager->connect(servername, portNumber))
+	std::string server = servername;
+	bool		connected =
+		m_connection->execute([&server, portNumber](ConnectionManager& c) { return c.connect(server.c_str(), portNumber); })
+			.get();
+	if (!connected)
 	{
 		LOG(MSG_ERROR, "Connection failed");
-		m_connectionManager->reset();
+		m_connection->execute([](ConnectionManager& c) { c.reset(); return true; }).get();
 		return false;
 	}
 
-	if (m_connectionManager->sendMessage(Action::OBSERVER, true))
+	m_serverAddr = servername;
+	m_port = portNumber;
+
+	Response response = m_connection->request(Action::OBSERVER).get();
+	if (response.result == Result::OKEY)
 	{
-		std::string msg;
-		Result res = m_connectionManager->receiveMessage(msg);
-		if (res == Result::OKEY)
+		LOG(MSG_NORMAL, "Logged in to server as Observer.");
+		m_connected = true;
+
+		JSONDocument data;
+		data.parse(response.body.data(), response.body.end());
+		std::map<uint32_t, std::string> games;
+		std::map<uint32_t, unsigned int> lengths;
+		for (JSONQueryReader game : data.root().getValue("games").asArray())
 		{
-			LOG(MSG_NORMAL, "Logged in to server as Observer.");
-			m_connected = true;
-
-			JSONQueryReader data(msg);
-			std::map<uint32_t, std::string> games;
-			std::map<uint32_t, unsigned int> lengths;
-			auto gamesData = data.getValue("games").asArray();
-			for (const auto& game : gamesData)
-			{
-				std::string name = game.get<std::string>("name");
-				uint32_t idx = game.get<unsigned int>("idx");
-				games[idx] = name;
-				lengths[idx] = game.get<unsigned int>("length");
-			}
+			std::string name = game.get<std::string>("name");
+			uint32_t idx = game.get<unsigned int>("idx");
+			games[idx] = name;
+			lengths[idx] = game.get<unsigned int>("length");
+		}
 
-			SelectGameDlg dlg(games);
-			if (IDOK == dlg.DoModal())
+		SelectGameDlg dlg(games);
+		if (IDOK == dlg.DoModal())
+		{
+			uint32_t idGame = dlg.getGameID();
+			JSONQueryWriter writer;
+			writer.add("idx", idGame);
+			m_gameController.maxTurn(lengths[idGame]);
+			if (m_connection->request(Action::GAME, writer.str()).get().result != Result::OKEY)
 			{
-				uint32_t idGame = dlg.getGameID();
-				JSONQueryWriter writer;
-				writer.add("idx", idGame);
-				m_gameController.maxTurn(lengths[idGame]);
-				return m_connectionManager->sendMessage(Action::GAME, false, &writer.str());
+				return false;
 			}
+
+			// a dropped session logs in to the same game again, the space asks for the displayed turn afterwards
+			std::string server = m_serverAddr;
+			m_connection->setReconnect([server, portNumber, idGame](ConnectionManager& c) {
+				return c.init() && c.connect(server.c_str(), portNumber) && GameDownloader::login(c, idGame);
+			});
+
+			downloadGame(idGame, lengths[idGame]);
+			return true;
 		}
 	}
 
@@ -127,11 +157,66 @@ uint AppManager::mainLoop()
 	return m_windowManager->mainLoop();
 }
 
+bool AppManager::recordTrace(const char* path)
+{
+	m_trace = std::make_shared<TraceWriter>();
+	if (!m_trace->open(path))
+	{
+		m_trace.reset();
+		return false;
+	}
+
+	m_connectionManager->setTrace(m_trace);
+	m_downloader->setTrace(m_trace);
+	return true;
+}
+
+bool AppManager::replayTrace(const char* path)
+{
+	auto trace = std::make_shared<TraceReader>();
+	if (!trace->open(path))
+	{
+		return false;
+	}
+
+	LOG(MSG_NORMAL, "Replaying %u recorded requests from %s", uint(trace->size()), path);
+	m_connectionManager->setTransport(createReplayTransport(trace));
+	m_downloader.reset(new GameDownloader([trace] { return createReplayTransport(trace); }));
+	m_downloader->setStats(m_stats);
+	return true;
+}
+
+void AppManager::cacheBudget(size_t bytes)
+{
+	m_sceneManager->space().setCacheBudget(bytes);
+}
+
+void AppManager::mapCacheDir(const char* path)
+{
+	m_sceneManager->space().setMapCacheDir(path);
+}
+
+void AppManager::downloadGame(uint gameIdx, int maxTurn)
+{
+	if (m_downloadSessions == 0)
+	{
+		return;
+	}
+
+	Space& space = m_sceneManager->space();
+	space.clearStoredLayers();
+	m_downloader->start(m_serverAddr.c_str(), m_port, gameIdx, 0, maxTurn, m_downloadSessions,
+		[&space](int turn, const MessageBuffer& body) { return space.storeDynamicLayer(turn, body.data(), body.end()); });
+}
+
 void AppManager::disconnect()
 {
+	m_downloader->cancel();
+	m_connection->setReconnect(nullptr);
+
 	if (m_connected)
 	{
-		if (m_connectionManager->sendMessage(Action::LOGOUT))
+		if (m_connection->request(Action::LOGOUT).get().result == Result::OKEY)
 		{
 			LOG(MSG_NORMAL, "Logged out from server.");
 			m_connected = false;
@@ -142,14 +227,31 @@ void AppManager::disconnect()
 void AppManager::finalize()
 {
 	m_gameController.finalize();
+	m_downloader->cancel();
+	m_connection->stop();
 	m_connectionManager->reset();
+	if (m_trace)
+	{
+		m_trace->close();
+	}
+	if (!m_statsPath.empty() && m_stats->dump(m_statsPath.c_str()))
+	{
+		LOG(MSG_NORMAL, "Network statistics written to %s", m_statsPath.c_str());
+	}
+
+	TurnCacheStats cache = m_sceneManager->space().cacheStats();
+	LOG(MSG_NORMAL, "Turn cache: %u turns, %u KB of %u KB, hits %llu, misses %llu, evictions %llu", uint(cache.turns),
+		uint(cache.bytes / 1024), uint(cache.budget / 1024), (unsigned long long)cache.hits,
+		(unsigned long long)cache.misses, (unsigned long long)cache.evictions);
+	const GameHistory& history = m_sceneManager->space().history();
+	LOG(MSG_NORMAL, "Game history: %u turns in %u KB", uint(history.turns()), uint(history.memoryUsage() / 1024));
 	m_renderSystem->fini();
 	m_windowManager->destroy();
 }
 
 bool AppManager::loadStaticSpace()
 {
-	return m_sceneManager->initStaticScene(*m_connectionManager);
+	return m_sceneManager->initStaticScene(*m_connection);
 }
 
 void AppManager::tick(float deltaTime)
@@ -158,7 +260,7 @@ void AppManager::tick(float deltaTime)
 	pController->tick(deltaTime);
 }
 
-AppManager::GameController::GameController(AppManager *pManager, class ConnectionManager *pConnection)
+AppManager::GameController::GameController(AppManager *pManager, class AsyncConnection *pConnection)
 	: m_pAppManager(pManager)
 	, m_pConnection(pConnection)
 	, m_dlg(new PlayerDlg(this))
@@ -190,6 +292,12 @@ void AppManager::GameController::maxTurn(int val)
 {
 	m_nMaxTurn = val;
 	m_dlg->maxTurn(val);
+	m_pAppManager->m_sceneManager->space().setMaxTurn(val);
+}
+
+DownloadProgress AppManager::GameController::downloadProgress() const
+{
+	return m_pAppManager->m_downloader->progress();
 }
 
 void AppManager::GameController::tick(float deltaTime)
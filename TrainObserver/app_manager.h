@@ -1,5 +1,6 @@
 #pragma once
 #include <memory>
+#include <string>
 #include "defs.hpp"
 #include "message_interface.h"
 
@@ -15,7 +16,7 @@ public:
 
 	struct GameController : public ITickable
 	{
-		 GameController(AppManager *pManager, class ConnectionManager *pConnection);
+		 GameController(AppManager *pManager, class AsyncConnection *pConnection);
 		
 		virtual ~GameController();
 
@@ -26,13 +27,14 @@ public:
 		float turn() const { return m_currentTurn; }
 		int maxTurn() const { return m_nMaxTurn; }
 		void maxTurn(int val);
+		struct DownloadProgress downloadProgress() const;
 
 	protected:
 		void tick(float deltaTime) override;
 
 	private:
 		AppManager* m_pAppManager;
-		ConnectionManager* m_pConnection;
+		AsyncConnection* m_pConnection;
 		float m_currentTurn = 0.0f;
 		int m_nMaxTurn = 0;
 		std::unique_ptr<class PlayerDlg>m_dlg;
@@ -44,17 +46,40 @@ public:
 	void disconnect();
 	void finalize();
 	bool loadStaticSpace();
+	// Server traffic is recorded to a trace file or played back from one instead of the server.
+	// Both have to be set up before initialize().
+	bool recordTrace(const char* path);
+	bool replayTrace(const char* path);
+	// number of extra observer sessions fetching the whole game in background, 0 disables it
+	void downloadSessions(uint count) { m_downloadSessions = count; }
+	// latency table of all connections is written to the file on finalize()
+	void dumpStats(const char* path) { m_statsPath = path; }
+	void cacheBudget(size_t bytes);
+	// compiled static maps are kept there between runs, an empty path disables it
+	void mapCacheDir(const char* path);
 
 	virtual void tick(float deltaTime) override;
 
 
 
+private:
+	void downloadGame(uint gameIdx, int maxTurn);
+
 private:
 	std::unique_ptr<class WindowManager>	 m_windowManager;
 	std::unique_ptr<class RenderSystemDX9>   m_renderSystem;
 	std::unique_ptr<class ConnectionManager> m_connectionManager;
+	// every request of the observer session goes through its executor
+	std::unique_ptr<class AsyncConnection>	 m_connection;
 	std::unique_ptr<class SceneManager>		 m_sceneManager;
+	std::unique_ptr<class GameDownloader>	 m_downloader;
+	std::shared_ptr<class TraceWriter>		 m_trace;
+	std::shared_ptr<class NetworkStats>		 m_stats;
+	std::string								 m_statsPath;
 
+	std::string m_serverAddr;
+	uint16_t	m_port;
+	uint		m_downloadSessions;
 	bool m_connected;
 	GameController m_gameController;
 };
@@ -0,0 +1,257 @@
+#include "async_connection.h"
+#include "log_interface.h"
+
+
+AsyncConnection::AsyncConnection(ConnectionManager& connection)
+	: m_connection(connection)
+	, m_stop(false)
+	, m_reconnecting(false)
+	, m_lost(false)
+{
+	m_executor = std::thread([this] { run(); });
+}
+
+AsyncConnection::~AsyncConnection()
+{
+	stop();
+}
+
+ResponseFuture AsyncConnection::request(Action actionCode, std::string message, const RequestOptions& options)
+{
+	std::vector<AsyncRequest> requests(1);
+	requests[0].actionCode = actionCode;
+	requests[0].message = std::move(message);
+	return std::move(request(std::move(requests), options).front());
+}
+
+std::vector<ResponseFuture> AsyncConnection::request(std::vector<AsyncRequest> requests, const RequestOptions& options)
+{
+	Submission submission;
+	submission.requests = std::move(requests);
+	submission.promises.resize(submission.requests.size());
+	submission.options = options;
+	if (options.timeoutMs > 0)
+	{
+		submission.deadlineUs = NetworkStats::now() + uint64_t(options.timeoutMs) * 1000;
+	}
+
+	std::vector<ResponseFuture> futures;
+	futures.reserve(submission.promises.size());
+	for (auto& promise : submission.promises)
+	{
+		futures.push_back(promise.get_future());
+	}
+
+	if (submission.requests.size() > ConnectionManager::MAX_PENDING_REQUESTS)
+	{
+		LOG(MSG_ERROR, "Too many requests in one batch: %u", uint(submission.requests.size()));
+		fail(submission, Result::SOCKET_UNINITIALIZED);
+		return futures;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_stop)
+	{
+		fail(submission, Result::SOCKET_UNINITIALIZED);
+		return futures;
+	}
+
+	m_queue.push_back(std::move(submission));
+	m_wakeup.notify_one();
+	return futures;
+}
+
+std::future<bool> AsyncConnection::execute(Job job)
+{
+	Submission submission;
+	submission.job = std::move(job);
+	std::future<bool> done = submission.done.get_future();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_stop)
+	{
+		submission.done.set_value(false);
+		return done;
+	}
+
+	m_queue.push_back(std::move(submission));
+	m_wakeup.notify_one();
+	return done;
+}
+
+void AsyncConnection::setReconnect(Job reconnect, const ReconnectPolicy& policy)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_reconnect = reconnect;
+	m_policy = policy;
+}
+
+void AsyncConnection::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+		for (Submission& s : m_queue)
+		{
+			fail(s, Result::SOCKET_UNINITIALIZED);
+		}
+		m_queue.clear();
+		m_wakeup.notify_one();
+	}
+
+	if (m_executor.joinable())
+	{
+		m_executor.join();
+	}
+}
+
+void AsyncConnection::run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
+	{
+		// responses still on the wire fail fast, then the connection is established again
+		if (m_lost && m_inFlight.empty())
+		{
+			reconnect(lock);
+			continue;
+		}
+
+		if (m_queue.empty() && m_inFlight.empty())
+		{
+			if (m_stop)
+			{
+				break;
+			}
+			m_wakeup.wait(lock);
+			continue;
+		}
+
+		// keep the window full, a job waits until everything posted before it is answered
+		if (!m_queue.empty())
+		{
+			const Submission& next = m_queue.front();
+			bool fits = next.job ? m_inFlight.empty()
+								 : m_inFlight.size() + next.requests.size() <= ConnectionManager::MAX_PENDING_REQUESTS;
+			if (fits)
+			{
+				Submission submission = std::move(m_queue.front());
+				m_queue.pop_front();
+				lock.unlock();
+
+				if (submission.job)
+					submission.done.set_value(submission.job(m_connection));
+				else if (submission.options.cancel && *submission.options.cancel)
+					fail(submission, Result::REQUEST_CANCELLED);
+				else
+					post(submission);
+
+				lock.lock();
+				continue;
+			}
+		}
+
+		lock.unlock();
+		collect();
+		lock.lock();
+	}
+}
+
+void AsyncConnection::post(Submission& submission)
+{
+	size_t				 count = submission.requests.size();
+	std::vector<Request> requests(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		requests[i].actionCode = submission.requests[i].actionCode;
+		requests[i].message = &submission.requests[i].message;
+	}
+
+	std::vector<RequestTicket> tickets(count);
+	if (!m_connection.postRequests(requests.data(), count, tickets.data()))
+	{
+		fail(submission, Result::SOCKET_ERR);
+		m_lost = true;
+		return;
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		m_inFlight.push_back(InFlight{tickets[i], submission.deadlineUs, std::move(submission.promises[i])});
+	}
+}
+
+void AsyncConnection::collect()
+{
+	InFlight flight = std::move(m_inFlight.front());
+	m_inFlight.pop_front();
+
+	// no explicit deadline falls back to the receive timeout of the connection
+	Response response;
+	if (flight.deadlineUs == ConnectionManager::NO_DEADLINE)
+		response.result = m_connection.waitResponse(flight.ticket, response.body);
+	else
+		response.result = m_connection.waitResponse(flight.ticket, response.body, flight.deadlineUs);
+
+	if (ConnectionManager::isConnectionLost(response.result))
+	{
+		m_lost = true;
+	}
+	flight.promise.set_value(std::move(response));
+}
+
+void AsyncConnection::reconnect(std::unique_lock<std::mutex>& lock)
+{
+	m_lost = false;
+	if (!m_reconnect || m_stop)
+	{
+		return;
+	}
+
+	Job				job = m_reconnect;
+	ReconnectPolicy policy = m_policy;
+	uint			delayMs = policy.firstDelayMs;
+	m_reconnecting = true;
+
+	for (uint attempt = 1; !m_stop; ++attempt)
+	{
+		lock.unlock();
+		LOG(MSG_WARNING, "Connection lost, reconnecting (attempt %u)", attempt);
+		bool connected = job(m_connection);
+		lock.lock();
+
+		if (connected)
+		{
+			LOG(MSG_NORMAL, "Connection restored");
+			break;
+		}
+
+		if (policy.maxAttempts > 0 && attempt >= policy.maxAttempts)
+		{
+			LOG(MSG_ERROR, "Giving up reconnecting after %u attempts", attempt);
+			break;
+		}
+
+		m_wakeup.wait_for(lock, std::chrono::milliseconds(delayMs), [this] { return m_stop; });
+		delayMs = delayMs * 2 < policy.maxDelayMs ? delayMs * 2 : policy.maxDelayMs;
+	}
+
+	m_reconnecting = false;
+}
+
+void AsyncConnection::fail(Submission& submission, Result result)
+{
+	for (auto& promise : submission.promises)
+	{
+		Response response;
+		response.result = result;
+		promise.set_value(std::move(response));
+	}
+	submission.promises.clear();
+
+	if (submission.job)
+	{
+		submission.done.set_value(false);
+		submission.job = nullptr;
+	}
+}
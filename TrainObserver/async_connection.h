@@ -0,0 +1,114 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "connection_manager.h"
+
+struct AsyncRequest
+{
+	Action		actionCode;
+	std::string	message;
+};
+
+struct Response
+{
+	Result			result = Result::SOCKET_UNINITIALIZED;
+	MessageBuffer	body;
+};
+
+typedef std::future<Response> ResponseFuture;
+// Raised by the owner of requests which are not needed anymore.
+typedef std::shared_ptr<std::atomic<bool>> CancelFlag;
+
+struct RequestOptions
+{
+	// response deadline counted from submission, 0 uses the receive timeout of the connection
+	uint		timeoutMs = 0;
+	// requests which are not on the wire yet are dropped with REQUEST_CANCELLED once it is raised
+	CancelFlag	cancel;
+};
+
+struct ReconnectPolicy
+{
+	uint firstDelayMs = 250;
+	uint maxDelayMs = 8000;
+	// 0 keeps trying until stop()
+	uint maxAttempts = 0;
+};
+
+// Serializes all I/O of a connection on a dedicated executor thread. Any thread may submit
+// requests, they are pipelined in submission order and every request gets a future of its
+// response, so callers never touch the socket themselves.
+class AsyncConnection
+{
+public:
+	typedef std::function<bool(ConnectionManager&)> Job;
+
+	explicit AsyncConnection(ConnectionManager& connection);
+	~AsyncConnection();
+	AsyncConnection(const AsyncConnection&) = delete;
+	AsyncConnection& operator=(const AsyncConnection&) = delete;
+
+	ResponseFuture request(Action actionCode, std::string message = std::string(),
+		const RequestOptions& options = RequestOptions());
+	// Requests go out back to back, no request of another caller can get in between them.
+	std::vector<ResponseFuture> request(std::vector<AsyncRequest> requests, const RequestOptions& options = RequestOptions());
+	// Runs the job on the executor once every earlier request is answered, e.g. connect or reset.
+	std::future<bool> execute(Job job);
+
+	// After the connection is lost the job is retried with exponential backoff until it succeeds.
+	// Requests submitted meanwhile wait for it, the ones on the wire fail. nullptr disables reconnect.
+	void setReconnect(Job reconnect, const ReconnectPolicy& policy = ReconnectPolicy());
+	bool isReconnecting() const { return m_reconnecting; }
+
+	// Fails queued requests and joins the executor after in-flight responses arrive.
+	void stop();
+
+	ConnectionManager& connection() const { return m_connection; }
+
+private:
+	struct Submission
+	{
+		std::vector<AsyncRequest>			requests;
+		std::vector<std::promise<Response>>	promises;
+		RequestOptions						options;
+		uint64_t							deadlineUs = ConnectionManager::NO_DEADLINE;
+		Job									job;
+		std::promise<bool>					done;
+	};
+
+	struct InFlight
+	{
+		RequestTicket			ticket;
+		uint64_t				deadlineUs;
+		std::promise<Response>	promise;
+	};
+
+	void run();
+	void post(Submission& submission);
+	void collect();
+	void reconnect(std::unique_lock<std::mutex>& lock);
+	static void fail(Submission& submission, Result result);
+
+private:
+	ConnectionManager&		m_connection;
+	std::thread				m_executor;
+
+	std::mutex				m_mutex;
+	std::condition_variable	m_wakeup;
+	std::deque<Submission>	m_queue;
+	bool					m_stop;
+	Job						m_reconnect;
+	ReconnectPolicy			m_policy;
+	std::atomic<bool>		m_reconnecting;
+
+	// touched by the executor only
+	std::deque<InFlight>	m_inFlight;
+	bool					m_lost;
+};
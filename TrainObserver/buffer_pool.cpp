@@ -0,0 +1,184 @@
+#include "buffer_pool.h"
+
+#include <algorithm>
+#include <string.h>
+
+
+MessageBuffer::MessageBuffer()
+	: m_data(nullptr)
+	, m_size(0)
+	, m_capacity(0)
+{
+}
+
+MessageBuffer::MessageBuffer(MessageBuffer&& other)
+	: MessageBuffer()
+{
+	swap(other);
+}
+
+MessageBuffer& MessageBuffer::operator=(MessageBuffer&& other)
+{
+	if (this != &other)
+	{
+		release();
+		swap(other);
+	}
+	return *this;
+}
+
+MessageBuffer::~MessageBuffer()
+{
+	release();
+}
+
+void MessageBuffer::resize(size_t size)
+{
+	if (size > m_capacity)
+	{
+		// unattached buffers still grow through a private pool so the memory can be recycled later
+		if (!m_pool)
+		{
+			m_pool = std::make_shared<BufferPool>();
+		}
+
+		BufferPool::Block block = m_pool->allocate(std::max(size, m_capacity * 2));
+		if (m_size > 0)
+		{
+			::memcpy(block.data, m_data, m_size);
+		}
+
+		if (m_data)
+		{
+			m_pool->put(m_data, m_capacity);
+		}
+
+		m_data = block.data;
+		m_capacity = block.capacity;
+	}
+
+	m_size = size;
+	if (m_data)
+	{
+		m_data[m_size] = 0;
+	}
+}
+
+void MessageBuffer::assign(const char* data, size_t size)
+{
+	m_size = 0;
+	resize(size);
+	if (size > 0)
+	{
+		::memcpy(m_data, data, size);
+	}
+}
+
+void MessageBuffer::clear()
+{
+	resize(0);
+}
+
+void MessageBuffer::swap(MessageBuffer& other)
+{
+	std::swap(m_data, other.m_data);
+	std::swap(m_size, other.m_size);
+	std::swap(m_capacity, other.m_capacity);
+	std::swap(m_pool, other.m_pool);
+}
+
+void MessageBuffer::release()
+{
+	if (m_data)
+	{
+		m_pool->put(m_data, m_capacity);
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+	m_capacity = 0;
+	m_pool.reset();
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+BufferPool::BufferPool()
+	: m_allocations(0)
+{
+}
+
+BufferPool::~BufferPool()
+{
+	for (const Block& block : m_free)
+	{
+		delete[] block.data;
+	}
+}
+
+MessageBuffer BufferPool::acquire(size_t size)
+{
+	MessageBuffer buffer;
+	buffer.m_pool = shared_from_this();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		// the smallest block which fits, a miss allocates a new one
+		auto best = m_free.end();
+		for (auto it = m_free.begin(); it != m_free.end(); ++it)
+		{
+			if (it->capacity >= size && (best == m_free.end() || it->capacity < best->capacity))
+			{
+				best = it;
+			}
+		}
+
+		if (best != m_free.end())
+		{
+			buffer.m_data = best->data;
+			buffer.m_capacity = best->capacity;
+			*best = m_free.back();
+			m_free.pop_back();
+		}
+	}
+
+	buffer.resize(size);
+	return buffer;
+}
+
+size_t BufferPool::pooled() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_free.size();
+}
+
+BufferPool::Block BufferPool::allocate(size_t capacity)
+{
+	Block block;
+	block.capacity = capacity > MIN_CAPACITY ? capacity : MIN_CAPACITY;
+	block.data = new char[block.capacity + 1];
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	++m_allocations;
+	return block;
+}
+
+void BufferPool::put(char* data, size_t capacity)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_free.size() < MAX_POOLED_BUFFERS)
+	{
+		m_free.push_back(Block{data, capacity});
+		return;
+	}
+
+	// pool is full: keep the bigger block
+	auto smallest = std::min_element(
+		m_free.begin(), m_free.end(), [](const Block& a, const Block& b) { return a.capacity < b.capacity; });
+	if (smallest->capacity < capacity)
+	{
+		std::swap(smallest->data, data);
+		smallest->capacity = capacity;
+	}
+	delete[] data;
+}
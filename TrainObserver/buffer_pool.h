@@ -0,0 +1,75 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class BufferPool;
+
+// Growable byte buffer borrowed from a BufferPool. Storage goes back to the pool when the
+// buffer is destroyed or reassigned, so steady-state traffic reuses the same memory.
+// Content is always followed by a zero byte.
+class MessageBuffer
+{
+public:
+	MessageBuffer();
+	MessageBuffer(MessageBuffer&& other);
+	MessageBuffer& operator=(MessageBuffer&& other);
+	~MessageBuffer();
+	MessageBuffer(const MessageBuffer&) = delete;
+	MessageBuffer& operator=(const MessageBuffer&) = delete;
+
+	char*		data() { return m_data; }
+	const char* data() const { return m_data; }
+	const char* c_str() const { return m_data ? m_data : ""; }
+	const char* end() const { return m_data + m_size; }
+	size_t		size() const { return m_size; }
+	size_t		capacity() const { return m_capacity; }
+	bool		empty() const { return m_size == 0; }
+
+	// Keeps current content, grows storage only when needed.
+	void resize(size_t size);
+	void assign(const char* data, size_t size);
+	void clear();
+	void swap(MessageBuffer& other);
+	void release();
+
+private:
+	friend class BufferPool;
+
+	char*						m_data;
+	size_t						m_size;
+	size_t						m_capacity;
+	std::shared_ptr<BufferPool> m_pool;
+};
+
+class BufferPool : public std::enable_shared_from_this<BufferPool>
+{
+public:
+	static const size_t MAX_POOLED_BUFFERS = 32;
+	static const size_t MIN_CAPACITY = 64 * 1024;
+
+	BufferPool();
+	~BufferPool();
+
+	MessageBuffer acquire(size_t size = 0);
+
+	size_t allocations() const { return m_allocations; }
+	size_t pooled() const;
+
+private:
+	friend class MessageBuffer;
+
+	struct Block
+	{
+		char*  data;
+		size_t capacity;
+	};
+
+	void   put(char* data, size_t capacity);
+	Block  allocate(size_t capacity);
+
+private:
+	mutable std::mutex	m_mutex;
+	std::vector<Block>	m_free;
+	size_t				m_allocations;
+};
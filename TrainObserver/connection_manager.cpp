@@ -1,19 +1,29 @@
 #include "connection_manager.h"
 #include "log_interface.h"
+#include "trace.h"
 
-#include <winsock2.h>
-#include <Ws2tcpip.h>
+#include <algorithm>
+#include <string.h>
 
 
-const uint WSA_VERSION_LO = 2;
-const uint WSA_VERSION_HI = 2;
-const uint READ_BUFFER_SIZE = 1000;
-
-ConnectionManager::ConnectionManager():
-	m_initialized(false),
-	m_socket(INVALID_SOCKET)
+ConnectionManager::ConnectionManager()
+	: ConnectionManager(createSocketTransport())
 {
+}
 
+ConnectionManager::ConnectionManager(std::unique_ptr<ITransport> transport)
+	: m_transport(std::move(transport))
+	, m_pool(std::make_shared<BufferPool>())
+	, m_decoder(m_pool)
+	, m_initialized(false)
+	, m_receiveTimeoutMs(-1)
+	, m_traceSession(0)
+	, m_stats(std::make_shared<NetworkStats>())
+	, m_firstByteUs(0)
+	, m_oldestTicket(INVALID_TICKET + 1)
+	, m_nextRead(INVALID_TICKET + 1)
+	, m_nextTicket(INVALID_TICKET + 1)
+{
 }
 
 ConnectionManager::~ConnectionManager()
@@ -25,257 +35,605 @@ bool ConnectionManager::init()
 {
 	reset();
 
-	WSADATA wsaData;
+	m_initialized = m_transport->init();
+	return m_initialized;
+}
 
-	int err = WSAStartup(MAKEWORD(WSA_VERSION_LO, WSA_VERSION_HI), &wsaData);
-	if (err != 0) {
-		/* Tell the user that we could not find a usable */
-		/* Winsock DLL.                                  */
-		LOG(MSG_ERROR, "WSAStartup failed with error: %d", err);
-		return false;
+void ConnectionManager::reset()
+{
+	if (m_initialized)
+	{
+		m_transport->reset();
+		dropPending();
+		m_initialized = false;
 	}
+}
 
-	/* Confirm that the WinSock DLL supports 2.2.*/
-	/* Note that if the DLL supports versions greater    */
-	/* than 2.2 in addition to 2.2, it will still return */
-	/* 2.2 in wVersion since that is the version we      */
-	/* requested.                                        */
+void ConnectionManager::setTransport(std::unique_ptr<ITransport> transport)
+{
+	reset();
+	m_transport = std::move(transport);
+}
 
-	if (LOBYTE(wsaData.wVersion) != WSA_VERSION_LO || HIBYTE(wsaData.wVersion) != WSA_VERSION_HI) {
-		/* Tell the user that we could not find a usable */
-		/* WinSock DLL.                                  */
-		LOG(MSG_ERROR, "Could not find a usable version of Winsock.dll");
-		WSACleanup();
+void ConnectionManager::setTrace(std::shared_ptr<TraceWriter> trace)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_trace = trace;
+	m_traceSession = trace ? trace->newSession() : 0;
+}
+
+void ConnectionManager::setStats(std::shared_ptr<NetworkStats> stats)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats = stats ? stats : std::make_shared<NetworkStats>();
+}
+
+bool ConnectionManager::connect(const char* servername, uint16_t portNumber)
+{
+	if (!m_initialized)
+	{
+		LOG(MSG_ERROR, "Trying to connect with uninitialized transport");
 		return false;
 	}
-	else
-		LOG(MSG_NORMAL, "The Winsock %d.%d dll was found okay", WSA_VERSION_HI, WSA_VERSION_LO);
 
-	m_initialized = true;
+	dropPending();
 
-	if (!createSocket())
 	{
-		WSACleanup();
-		m_initialized = false;
-		return false;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_trace)
+		{
+			m_traceSession = m_trace->newSession();
+		}
 	}
 
-	return true;
+	return m_transport->connect(servername, portNumber);
 }
 
-void ConnectionManager::reset()
+bool ConnectionManager::sendMessage(Action actionCode, bool needResponce, const std::string* message) const
 {
-	if (m_initialized)
+	RequestTicket ticket = postRequest(actionCode, message);
+	if (ticket == INVALID_TICKET)
 	{
-		closeSocket();
-		WSACleanup();
-		m_initialized = false;
+		return false;
+	}
+
+	if (!needResponce)
+	{
+		MessageBuffer msg;
+		return waitResponse(ticket, msg) == Result::OKEY;
 	}
+
+	return true;
 }
 
-bool ConnectionManager::connect(const char* servername, uint16_t portNumber)
+Result ConnectionManager::receiveMessage(std::string& message) const
 {
-	if (!m_initialized)
+	MessageBuffer buffer;
+	Result		  result = receiveMessage(buffer);
+	message.assign(buffer.data(), buffer.size());
+	return result;
+}
+
+Result ConnectionManager::receiveMessage(MessageBuffer& message) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// the oldest response nobody has collected yet
+	if (m_oldestTicket == m_nextTicket)
 	{
-		LOG(MSG_ERROR, "Trying to connect with uninitialized WSA");
-		return false;
+		return readFrame(message, defaultDeadline());
 	}
 
-	if (!initAddr(servername, portNumber))
+	return collect(m_oldestTicket, message, defaultDeadline());
+}
+
+RequestTicket ConnectionManager::postRequest(Action actionCode, const std::string* message) const
+{
+	Request		  request = {actionCode, message};
+	RequestTicket ticket = INVALID_TICKET;
+	postRequests(&request, 1, &ticket);
+	return ticket;
+}
+
+bool ConnectionManager::postRequests(const Request* requests, size_t count, RequestTicket* tickets) const
+{
+	std::fill(tickets, tickets + count, INVALID_TICKET);
+
+	if (count > MAX_PENDING_REQUESTS)
 	{
+		LOG(MSG_ERROR, "Too many requests in one batch: %u", uint(count));
 		return false;
 	}
-	
-	/*---Connect to server---*/
-	int result = ::connect(m_socket, (sockaddr*)m_addr.get(), sizeof(sockaddr_in));
-	if (result == SOCKET_ERROR)
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// Reaching the window limit drains the oldest responses from the wire, so neither side
+	// can stall on a full socket buffer. Responses nobody collects cannot be drained though.
+	while (m_nextTicket - m_oldestTicket + count > MAX_PENDING_REQUESTS)
 	{
-		LOG(MSG_ERROR, "connect function failed with error: %ld", WSAGetLastError());
-		result = closesocket(m_socket);
-		if (result == SOCKET_ERROR)
+		if (m_nextRead == m_nextTicket)
 		{
-			LOG(MSG_ERROR, "closesocket function failed with error: %ld", WSAGetLastError());
+			LOG(MSG_ERROR, "Too many uncollected responses, request is rejected");
+			return false;
 		}
-		return false;
+		readResponse(defaultDeadline());
 	}
 
-	LOG(MSG_NORMAL, "Connected to server %s:%d.", servername, portNumber);
-	return true;
-}
+	// the whole batch goes out in one call
+	uchar	headers[MAX_PENDING_REQUESTS][MessageHeader::SIZE];
+	IoSlice slices[2 * MAX_PENDING_REQUESTS];
+	size_t	sliceCount = encodeRequests(requests, count, headers, slices);
 
-bool ConnectionManager::sendMessage(Action actionCode, bool needResponce, const std::string* message) const
-{
-	size_t msgLength = message ? message->length() : 0;
-	bool result = false;
-	if (msgLength > 0)
+	if (m_trace)
 	{
-		size_t fullLength = msgLength + sizeof(ActionMessageHeader);
-		auto* action = reinterpret_cast<ActionMessage *>(alloca(fullLength)); // stack allocation memory
-		action->header.actionCode = actionCode;
-		action->header.dataLength = msgLength;
-		::memcpy(action->buffer, message->c_str(), msgLength);
-		result = send(action, fullLength);
+		traceRequests(requests, count, m_nextTicket);
 	}
-	else
+
+	if (!send(slices, sliceCount))
 	{
-		ActionMessageHeader header = { actionCode, 0 };
-		result = send(&header, sizeof(header));
+		return false;
 	}
+	accountRequests(requests, count, m_nextTicket);
 
-	if (result && !needResponce)
+	for (size_t i = 0; i < count; ++i)
 	{
-		std::string msg;
-		return receiveMessage(msg) == Result::OKEY;
+		tickets[i] = m_nextTicket++;
+		slot(tickets[i]).ticket = tickets[i];
 	}
 
-	return result;
+	return true;
 }
 
-Result ConnectionManager::receiveMessage(std::string& message) const
+bool ConnectionManager::queueRequests(const Request* requests, size_t count, RequestTicket* tickets) const
 {
-	if (!m_initialized || m_socket == INVALID_SOCKET)
+	std::fill(tickets, tickets + count, INVALID_TICKET);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_nextTicket - m_oldestTicket + count > MAX_PENDING_REQUESTS)
 	{
-		LOG(MSG_ERROR, "Trying to receive message with uninitialized WSA");
-		return Result::SOCKET_UNINITIALIZED;
+		LOG(MSG_ERROR, "Request window is full, request is rejected");
+		return false;
+	}
+
+	if (!m_initialized || !m_transport->isConnected())
+	{
+		LOG(MSG_ERROR, "Trying to send message with uninitialized transport");
+		return false;
 	}
 
-	Result result = SOCKET_UNINITIALIZED;
-	if (!receive(result))
+	uchar	headers[MAX_PENDING_REQUESTS][MessageHeader::SIZE];
+	IoSlice slices[2 * MAX_PENDING_REQUESTS];
+	size_t	sliceCount = encodeRequests(requests, count, headers, slices);
+	for (size_t i = 0; i < sliceCount; ++i)
 	{
-		return Result::INCORRECT_RESPOND_FORMAT;
+		m_queued.append(slices[i].data, slices[i].size);
 	}
 
-	uint length = 0;
-	if (!receive(length))
+	if (m_trace)
 	{
-		return Result::INCORRECT_RESPOND_FORMAT;
+		traceRequests(requests, count, m_nextTicket);
 	}
+	accountRequests(requests, count, m_nextTicket);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		tickets[i] = m_nextTicket++;
+		slot(tickets[i]).ticket = tickets[i];
+	}
+
+	// a failed write fails the tickets just handed out, they are collected as usual
+	writeQueued();
+	return true;
+}
+
+bool ConnectionManager::flush() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return writeQueued();
+}
+
+bool ConnectionManager::hasQueued() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return !m_queued.empty();
+}
+
+bool ConnectionManager::receiveAvailable() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
 
-	if (length > 0)
+	uint reads = 0;
+	bool alive = true;
+	while (alive && m_nextRead < m_nextTicket)
 	{
-		message.resize(length);
+		size_t	 capacity = 0;
+		char*	 buf = m_decoder.prepare(capacity);
+		size_t	 received = 0;
+		IoStatus status = m_transport->read(buf, capacity, received);
+		++reads;
 
-		uint receivedBytes = 0;
-		char buf[READ_BUFFER_SIZE];
-		while (receivedBytes < length)
+		if (status == IoStatus::WOULD_BLOCK)
 		{
-			int bytesToReceive = min(READ_BUFFER_SIZE, length - receivedBytes);
-			int n = receive(buf, bytesToReceive);
+			break;
+		}
 
-			if (n < 0)
-			{
-				return Result::SOCKET_ERR;
-			}
+		Slot& s = slot(m_nextRead);
+		if (status != IoStatus::OK || !m_decoder.commit(received))
+		{
+			Result result = status != IoStatus::OK && !m_decoder.inHeader() ? Result::SOCKET_ERR
+																			  : Result::INCORRECT_RESPOND_FORMAT;
+			m_decoder.next();
+			s.body.clear();
+			finishResponse(result);
+			alive = false;
+			break;
+		}
 
-			memcpy_s((char*)(message.data() + receivedBytes), n, buf, n);
-			receivedBytes += n;
+		if (m_firstByteUs == 0 && received > 0)
+		{
+			m_firstByteUs = NetworkStats::now();
+		}
+
+		if (m_decoder.ready())
+		{
+			Result result = m_decoder.result();
+			s.body = std::move(m_decoder.body());
+			m_decoder.next();
+			finishResponse(result);
+			m_firstByteUs = 0;
 		}
 	}
-	else
+
+	m_stats->syscalls(reads, 0, 0);
+	return alive;
+}
+
+bool ConnectionManager::hasResponse(RequestTicket ticket) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return ticket >= m_oldestTicket && ticket < m_nextRead;
+}
+
+size_t ConnectionManager::encodeRequests(const Request* requests, size_t count, uchar (*headers)[MessageHeader::SIZE],
+	IoSlice* slices) const
+{
+	// every request is a header slice plus a payload slice
+	size_t sliceCount = 0;
+	for (size_t i = 0; i < count; ++i)
 	{
-		message = "";
+		const std::string* message = requests[i].message;
+		size_t			   length = message ? message->length() : 0;
+
+		MessageHeader{uint32_t(requests[i].actionCode), uint32_t(length)}.encode(headers[i]);
+		slices[sliceCount++] = IoSlice{(const char*)headers[i], MessageHeader::SIZE};
+		if (length > 0)
+		{
+			slices[sliceCount++] = IoSlice{message->data(), length};
+		}
 	}
+	return sliceCount;
+}
 
-	return result;	
+Result ConnectionManager::waitResponse(RequestTicket ticket, MessageBuffer& message) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return collect(ticket, message, defaultDeadline());
 }
 
-bool ConnectionManager::send(const void* buf, size_t nbytes) const
+Result ConnectionManager::waitResponse(RequestTicket ticket, MessageBuffer& message, uint64_t deadlineUs) const
 {
-	if (!m_initialized)
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return collect(ticket, message, deadlineUs);
+}
+
+Result ConnectionManager::waitResponse(RequestTicket ticket, std::string& message) const
+{
+	MessageBuffer buffer;
+	Result		  result = waitResponse(ticket, buffer);
+	message.assign(buffer.data(), buffer.size());
+	return result;
+}
+
+size_t ConnectionManager::pendingRequests() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return size_t(m_nextTicket - m_oldestTicket);
+}
+
+bool ConnectionManager::isConnectionLost(Result result)
+{
+	return result == Result::SOCKET_ERR || result == Result::SOCKET_UNINITIALIZED ||
+		   result == Result::RESPONSE_TIMEOUT || result == Result::INCORRECT_RESPOND_FORMAT;
+}
+
+Result ConnectionManager::collect(RequestTicket ticket, MessageBuffer& message, uint64_t deadlineUs) const
+{
+	if (ticket < m_oldestTicket || ticket >= m_nextTicket || slot(ticket).ticket != ticket)
 	{
-		LOG(MSG_ERROR, "Trying to send message with uninitialized WSA");
-		return false;
+		LOG(MSG_ERROR, "Waiting for response of unknown request %u", uint(ticket));
+		message.clear();
+		return Result::SOCKET_UNINITIALIZED;
 	}
 
-	if (!m_addr)
+	while (m_nextRead <= ticket)
 	{
-		LOG(MSG_ERROR, "Trying to send message to disconnected server");
-		return false;
+		readResponse(deadlineUs);
 	}
 
-	size_t bytesSent = 0;
-	do {
-		int result = ::send(m_socket, (const char*)buf, (nbytes - bytesSent), 0);
-		if (result == SOCKET_ERROR)
-		{
-			LOG(MSG_ERROR, "send of message failed!");
-			break;
-		}
-		bytesSent += result;
+	Slot& s = slot(ticket);
+	message = std::move(s.body);
+	s.ticket = INVALID_TICKET;
+
+	while (m_oldestTicket < m_nextRead && slot(m_oldestTicket).ticket == INVALID_TICKET)
+	{
+		++m_oldestTicket;
 	}
-	while (bytesSent < nbytes);
 
-	
+	return s.result;
+}
 
-	return bytesSent == nbytes;
+void ConnectionManager::readResponse(uint64_t deadlineUs) const
+{
+	Slot& s = slot(m_nextRead);
+	finishResponse(readFrame(s.body, deadlineUs));
 }
 
-int ConnectionManager::receive(char* buf, uint length) const
+void ConnectionManager::finishResponse(Result result) const
 {
-	if (!m_initialized || m_socket == INVALID_SOCKET)
+	Slot& s = slot(m_nextRead);
+	s.result = result;
+	++m_nextRead;
+
+	m_stats->response(s.category, s.result, s.body.size(), s.postedUs, m_firstByteUs, NetworkStats::now());
+
+	if (m_trace)
 	{
-		LOG(MSG_ERROR, "Trying to receive message with uninitialized WSA");
-		return -1;
+		m_trace->record(m_traceSession, s.action, s.request.data(), s.request.size(), s.result, s.body.data(),
+			s.body.size(), s.sentUs, m_trace->now());
 	}
 
-	int n = ::recv(m_socket, buf, length, 0);
-	if (n < 0)
+	if (isConnectionLost(s.result))
 	{
-		LOG(MSG_ERROR, "SOCKET_ERROR while receiving message");
-		//if (WSAGetLastError() != WSAEWOULDBLOCK)
-		//{
-		//	closeSocket();
-		//}
+		// the stream is out of sync, none of the outstanding responses will arrive
+		if (s.result == Result::RESPONSE_TIMEOUT)
+		{
+			LOG(MSG_ERROR, "Server did not respond in time, dropping the connection");
+			m_transport->reset();
+		}
+
+		failOutstanding(s.result);
 	}
+}
 
-	return n;
+void ConnectionManager::failOutstanding(Result result) const
+{
+	for (; m_nextRead < m_nextTicket; ++m_nextRead)
+	{
+		slot(m_nextRead).result = result;
+		slot(m_nextRead).body.clear();
+	}
+	m_queued.clear();
 }
 
-void ConnectionManager::closeSocket()
+void ConnectionManager::traceRequests(const Request* requests, size_t count, RequestTicket firstTicket) const
 {
-	if (m_socket != INVALID_SOCKET)
+	uint64_t now = m_trace->now();
+	for (size_t i = 0; i < count; ++i)
 	{
-		closesocket(m_socket);
-		m_socket = INVALID_SOCKET;
+		Slot& s = slot(firstTicket + i);
+		s.action = requests[i].actionCode;
+		s.sentUs = now;
+		if (requests[i].message)
+			s.request = *requests[i].message;
+		else
+			s.request.clear();
 	}
 }
 
-bool ConnectionManager::createSocket()
+void ConnectionManager::accountRequests(const Request* requests, size_t count, RequestTicket firstTicket) const
 {
-	if (!m_initialized)
+	uint64_t now = NetworkStats::now();
+	for (size_t i = 0; i < count; ++i)
 	{
-		LOG(MSG_ERROR, "Trying to create a socket with uninitialized WSA");
-		return false;
+		const std::string* message = requests[i].message;
+		size_t			   length = message ? message->length() : 0;
+
+		Slot& s = slot(firstTicket + i);
+		s.category = NetworkStats::category(requests[i].actionCode, message ? message->data() : nullptr, length);
+		s.postedUs = now;
+		m_stats->request(s.category, MessageHeader::SIZE + length);
 	}
+}
 
-	/*---Open socket for streaming---*/
-	if ((m_socket = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+void ConnectionManager::dropPending()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (Slot& s : m_slots)
 	{
-		LOG(MSG_ERROR, "socket function failed with error: %ld\n", WSAGetLastError());
-		return false;
+		s.ticket = INVALID_TICKET;
+		s.body.release();
 	}
+	m_oldestTicket = m_nextRead = m_nextTicket;
+	m_queued.clear();
+	m_decoder.next();
+}
 
-	return true;
+static int remainingMs(uint64_t deadlineUs)
+{
+	if (deadlineUs == ConnectionManager::NO_DEADLINE)
+	{
+		return -1;
+	}
+
+	uint64_t now = NetworkStats::now();
+	return deadlineUs > now ? int((deadlineUs - now + 999) / 1000) : 0;
 }
 
-bool ConnectionManager::initAddr(const char* servername, uint16_t portNumber)
+uint64_t ConnectionManager::defaultDeadline() const
 {
-	struct addrinfo *pAddrInfoLListItem = NULL;
+	return m_receiveTimeoutMs < 0 ? NO_DEADLINE : NetworkStats::now() + uint64_t(m_receiveTimeoutMs) * 1000;
+}
+
+Result ConnectionManager::readFrame(MessageBuffer& message, uint64_t deadlineUs) const
+{
+	if (!m_initialized || !m_transport->isConnected())
+	{
+		LOG(MSG_ERROR, "Trying to receive message with uninitialized transport");
+		message.clear();
+		return Result::SOCKET_UNINITIALIZED;
+	}
 
-	if (0 != ::getaddrinfo(servername, NULL, NULL, &pAddrInfoLListItem))
+	// bytes are read straight into the decoder: header first, then the whole body in place
+	uint reads = 0;
+	uint waits = 0;
+	m_firstByteUs = 0;
+	while (!m_decoder.ready())
 	{
-		LOG(MSG_ERROR, "Could not resolve server name: \"%s\"", servername);
+		size_t	 capacity = 0;
+		char*	 buf = m_decoder.prepare(capacity);
+		size_t	 received = 0;
+		IoStatus status = m_transport->read(buf, capacity, received);
+		++reads;
+
+		if (status == IoStatus::WOULD_BLOCK)
+		{
+			++waits;
+			if (m_transport->wait(IO_READ, remainingMs(deadlineUs)))
+			{
+				continue;
+			}
+
+			if (deadlineUs != NO_DEADLINE && NetworkStats::now() >= deadlineUs)
+			{
+				m_stats->syscalls(reads, 0, waits);
+				m_decoder.next();
+				message.clear();
+				return Result::RESPONSE_TIMEOUT;
+			}
+			status = IoStatus::FAILED;
+		}
+
+		if (status != IoStatus::OK)
+		{
+			m_stats->syscalls(reads, 0, waits);
+			bool header = m_decoder.inHeader();
+			m_decoder.next();
+			message.clear();
+			return header ? Result::INCORRECT_RESPOND_FORMAT : Result::SOCKET_ERR;
+		}
+
+		if (m_firstByteUs == 0 && received > 0)
+		{
+			m_firstByteUs = NetworkStats::now();
+		}
+
+		if (!m_decoder.commit(received))
+		{
+			m_stats->syscalls(reads, 0, waits);
+			m_decoder.next();
+			message.clear();
+			return Result::INCORRECT_RESPOND_FORMAT;
+		}
+	}
+
+	m_stats->syscalls(reads, 0, waits);
+
+	Result result = m_decoder.result();
+	message = std::move(m_decoder.body());
+	m_decoder.next();
+
+	return result;
+}
+
+bool ConnectionManager::send(IoSlice* slices, size_t count) const
+{
+	if (!m_initialized)
+	{
+		LOG(MSG_ERROR, "Trying to send message with uninitialized transport");
 		return false;
 	}
-	sockaddr_in *sockAddr = reinterpret_cast<sockaddr_in *>(pAddrInfoLListItem->ai_addr);
-	
-	m_addr.reset(new sockaddr_in());
-	::memcpy(m_addr.get(), sockAddr, sizeof(sockaddr_in));
 
-	::freeaddrinfo(pAddrInfoLListItem);
+	// a server which stops reading must not hang the caller, the receive timeout bounds sending as well
+	uint64_t deadlineUs = defaultDeadline();
+	uint	 writes = 0;
+	uint	 waits = 0;
+	while (count > 0)
+	{
+		size_t	 written = 0;
+		IoStatus status = m_transport->writev(slices, count, written);
+		++writes;
+
+		if (status == IoStatus::WOULD_BLOCK)
+		{
+			++waits;
+			if (m_transport->wait(IO_WRITE, remainingMs(deadlineUs)))
+			{
+				continue;
+			}
+
+			if (deadlineUs != NO_DEADLINE && NetworkStats::now() >= deadlineUs)
+			{
+				// part of the batch may be on the wire already, the stream is out of sync
+				m_stats->syscalls(0, writes, waits);
+				LOG(MSG_ERROR, "Server did not take the request in time, dropping the connection");
+				m_transport->reset();
+				return false;
+			}
+			status = IoStatus::FAILED;
+		}
+
+		if (status != IoStatus::OK)
+		{
+			m_stats->syscalls(0, writes, waits);
+			LOG(MSG_ERROR, "send of message failed!");
+			return false;
+		}
+
+		// skip what went out, a partially sent slice continues from its tail
+		while (count > 0 && written >= slices->size)
+		{
+			written -= slices->size;
+			++slices;
+			--count;
+		}
+
+		if (count > 0)
+		{
+			slices->data += written;
+			slices->size -= written;
+		}
+	}
 
- 	m_addr->sin_family = AF_INET;
- 	m_addr->sin_port = htons(portNumber); 	
+	m_stats->syscalls(0, writes, waits);
 	return true;
 }
 
+bool ConnectionManager::writeQueued() const
+{
+	uint writes = 0;
+	bool sent = true;
+	while (!m_queued.empty())
+	{
+		size_t	 written = 0;
+		IoStatus status = m_transport->write(m_queued.data(), m_queued.size(), written);
+		++writes;
+		m_queued.erase(0, written);
+
+		if (status == IoStatus::WOULD_BLOCK)
+		{
+			break;
+		}
+
+		if (status != IoStatus::OK)
+		{
+			// the requests on the wire and the queued ones will not be answered
+			LOG(MSG_ERROR, "send of message failed!");
+			failOutstanding(Result::SOCKET_ERR);
+			sent = false;
+			break;
+		}
+	}
+
+	m_stats->syscalls(0, writes, 0);
+	return sent;
+}
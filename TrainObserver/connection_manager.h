@@ -1,13 +1,52 @@
 #pragma once
 #include <memory>
+#include <mutex>
+#include "buffer_pool.h"
 #include "defs.hpp"
+#include "frame_decoder.h"
+#include "network_stats.h"
+#include "transport.h"
 #include <string>
 
+// Identifies a posted request. Responses come back in send order and are matched to tickets.
+typedef uint64_t RequestTicket;
+const RequestTicket INVALID_TICKET = 0;
+
+class TraceWriter;
+
+struct Request
+{
+	Action				actionCode;
+	const std::string*	message;
+};
 
 class ConnectionManager
 {
+public:
+	// Upper bound of requests without collected response.
+	static const size_t MAX_PENDING_REQUESTS = 64;
+	// deadlines are NetworkStats::now() microseconds
+	static const uint64_t NO_DEADLINE = UINT64_MAX;
+
+private:
+	struct Slot
+	{
+		RequestTicket	ticket = INVALID_TICKET;
+		Result			result = Result::SOCKET_UNINITIALIZED;
+		MessageBuffer	body;
+
+		// kept only while traffic is traced
+		Action			action = Action::LOGIN;
+		std::string		request;
+		uint64_t		sentUs = 0;
+
+		StatsCategory	category = StatsCategory::OTHER;
+		uint64_t		postedUs = 0;
+	};
+
 public:
 	ConnectionManager();
+	explicit ConnectionManager(std::unique_ptr<ITransport> transport);
 	virtual ~ConnectionManager();
 	ConnectionManager(const ConnectionManager&) = delete;
 	ConnectionManager(ConnectionManager&&) = delete;
@@ -15,27 +54,89 @@ public:
 
 	bool init();
 	void reset();
+	// Replaces the transport, e.g. by replay of a recorded trace. Resets the connection.
+	void setTransport(std::unique_ptr<ITransport> transport);
+	// Every request/response pair is recorded to the writer, nullptr stops recording.
+	void setTrace(std::shared_ptr<TraceWriter> trace);
+	// Latency and throughput counters, several connections may share one instance.
+	void setStats(std::shared_ptr<NetworkStats> stats);
+	NetworkStats& stats() const { return *m_stats; }
+	// Bounds waiting for a response without an explicit deadline and for room to send a request,
+	// negative waits forever. Missing the deadline breaks the connection, later bytes would be out of sync.
+	void setReceiveTimeout(int timeoutMs) { m_receiveTimeoutMs = timeoutMs; }
+	// the connection has to be established again after such result
+	static bool isConnectionLost(Result result);
 
 	bool connect(const char* servername, uint16_t portNumber);
 	bool sendMessage(Action actionCode, bool needResponce = false, const std::string* message = nullptr) const;
 	Result receiveMessage(std::string& message) const;
+	Result receiveMessage(MessageBuffer& message) const;
+
+	// pipelined interface: up to MAX_PENDING_REQUESTS requests may be outstanding on the connection
+	RequestTicket postRequest(Action actionCode, const std::string* message = nullptr) const;
+	// Sends requests back to back with a single gathered write, no other request can get in between them.
+	bool postRequests(const Request* requests, size_t count, RequestTicket* tickets) const;
+	// Blocks until response for ticket arrives. Responses of earlier tickets are kept until collected.
+	// The buffer version hands over the receive buffer itself, without copying.
+	Result waitResponse(RequestTicket ticket, MessageBuffer& message) const;
+	Result waitResponse(RequestTicket ticket, MessageBuffer& message, uint64_t deadlineUs) const;
+	Result waitResponse(RequestTicket ticket, std::string& message) const;
+	// slots taken in the request window, from the oldest uncollected ticket to the last posted one
+	size_t pendingRequests() const;
+
+	// Non-blocking interface for connections driven by an EventLoop, nothing here waits.
+	// Queues requests, the part the transport does not take right away goes out with flush().
+	// A full request window rejects the batch instead of draining responses.
+	bool queueRequests(const Request* requests, size_t count, RequestTicket* tickets) const;
+	// Writes queued requests as far as the transport takes them now.
+	bool flush() const;
+	bool hasQueued() const;
+	// Reads the responses which have arrived. When the connection breaks, every outstanding
+	// response fails and false is returned.
+	bool receiveAvailable() const;
+	// whether the response has arrived, waitResponse returns it without waiting then
+	bool hasResponse(RequestTicket ticket) const;
+
+	ITransport& transport() const { return *m_transport; }
+	BufferPool& bufferPool() const { return *m_pool; }
 
 private:
-	void closeSocket();
-	bool createSocket();
-	bool initAddr(const char* servername, uint16_t portNumber);
-	bool send(const void* buf, size_t nbytes) const;
-	int receive(char* buf, uint length) const;
-
-	template<class T>
-	bool receive(T& val) const
-	{
-		int n = receive((char*)&val, sizeof(val));
-		return n == sizeof(val);
-	}
+	bool send(IoSlice* slices, size_t count) const;
+	bool writeQueued() const;
+	Result readFrame(MessageBuffer& message, uint64_t deadlineUs) const;
+	void readResponse(uint64_t deadlineUs) const;
+	// stores the result of the next response on the wire, its body is in the slot already
+	void finishResponse(Result result) const;
+	// none of the responses on the wire will arrive
+	void failOutstanding(Result result) const;
+	size_t encodeRequests(const Request* requests, size_t count, uchar (*headers)[MessageHeader::SIZE],
+		IoSlice* slices) const;
+	Result collect(RequestTicket ticket, MessageBuffer& message, uint64_t deadlineUs) const;
+	uint64_t defaultDeadline() const;
+	Slot& slot(RequestTicket ticket) const { return m_slots[ticket % MAX_PENDING_REQUESTS]; }
+	void dropPending();
+	void traceRequests(const Request* requests, size_t count, RequestTicket firstTicket) const;
+	void accountRequests(const Request* requests, size_t count, RequestTicket firstTicket) const;
 
 private:
-	uint								m_socket;
-	std::unique_ptr<struct sockaddr_in>	m_addr;
-	bool								m_initialized;
-};
\ No newline at end of file
+	std::unique_ptr<ITransport>	m_transport;
+	std::shared_ptr<BufferPool>	m_pool;
+	mutable FrameDecoder		m_decoder;
+	bool						m_initialized;
+	int							m_receiveTimeoutMs;
+	std::shared_ptr<TraceWriter>	m_trace;
+	// records of every connection get their own session in the trace
+	uint32_t					m_traceSession;
+	std::shared_ptr<NetworkStats>	m_stats;
+	// arrival of the first byte of the last frame read
+	mutable uint64_t			m_firstByteUs;
+	// bytes of queued requests the transport has not taken yet
+	mutable std::string			m_queued;
+
+	// outstanding tickets are [m_oldestTicket, m_nextTicket), responses of [m_nextRead, m_nextTicket) are on the wire
+	mutable std::mutex		m_mutex;
+	mutable Slot			m_slots[MAX_PENDING_REQUESTS];
+	mutable RequestTicket	m_oldestTicket;
+	mutable RequestTicket	m_nextRead;
+	mutable RequestTicket	m_nextTicket;
+};
@@ -1,4 +1,5 @@
 #pragma once
+#include <stddef.h>
 #include <stdint.h>
 
 typedef unsigned int uint;
@@ -35,28 +36,38 @@ enum Result : uint
 
 	SOCKET_ERR				= 0xfe000001,
 	SOCKET_UNINITIALIZED	= 0xfe000002,
+	RESPONSE_TIMEOUT		= 0xfe000003,
+	REQUEST_CANCELLED		= 0xfe000004,
 
 	INCORRECT_RESPOND_FORMAT= 0xff000001
 };
 
-#pragma pack(push)
-struct ActionMessageHeader
+// Requests and responses start with the same fixed size header: a 32 bit code (Action for
+// requests, Result for responses) and a 32 bit payload length, both little-endian.
+struct MessageHeader
 {
-    Action actionCode;
-    size_t dataLength;
-};
+	static const size_t SIZE = 8;
 
-struct ActionMessage
-{
-	ActionMessageHeader header;
-	char buffer[1];
-};
+	uint32_t code;
+	uint32_t length;
 
-#pragma pack(pop)
-//
-//struct ResposeMessage
-//{
-//    Result result;
-//    size_t dataLength;
-//    char data[];
-//}
\ No newline at end of file
+	void encode(uchar* out) const
+	{
+		for (uint i = 0; i < 4; ++i)
+		{
+			out[i] = uchar(code >> (8 * i));
+			out[4 + i] = uchar(length >> (8 * i));
+		}
+	}
+
+	static MessageHeader decode(const uchar* in)
+	{
+		MessageHeader header = {0, 0};
+		for (uint i = 0; i < 4; ++i)
+		{
+			header.code |= uint32_t(in[i]) << (8 * i);
+			header.length |= uint32_t(in[4 + i]) << (8 * i);
+		}
+		return header;
+	}
+};
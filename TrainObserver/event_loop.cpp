@@ -0,0 +1,202 @@
+#include "event_loop.h"
+#include "log_interface.h"
+
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#endif
+
+namespace
+{
+#ifndef _WIN32
+const int MAX_EVENTS_PER_POLL = 64;
+
+uint32_t toEpoll(uint events)
+{
+	return ((events & IO_READ) ? uint32_t(EPOLLIN) : 0) | ((events & IO_WRITE) ? uint32_t(EPOLLOUT) : 0) | EPOLLRDHUP;
+}
+
+uint fromEpoll(uint32_t events)
+{
+	uint res = 0;
+	res |= (events & EPOLLIN) ? uint(IO_READ) : 0;
+	res |= (events & EPOLLOUT) ? uint(IO_WRITE) : 0;
+	res |= (events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) ? uint(IO_ERROR) : 0;
+	return res;
+}
+#endif
+} // namespace
+
+EventLoop::EventLoop()
+	: m_epoll(-1)
+{
+}
+
+EventLoop::~EventLoop()
+{
+	reset();
+}
+
+bool EventLoop::init()
+{
+	reset();
+
+#ifndef _WIN32
+	m_epoll = epoll_create1(EPOLL_CLOEXEC);
+	if (m_epoll < 0)
+	{
+		LOG(MSG_ERROR, "epoll_create1 failed with error: %d", errno);
+		return false;
+	}
+#endif
+
+	return true;
+}
+
+void EventLoop::reset()
+{
+	m_entries.clear();
+
+#ifndef _WIN32
+	if (m_epoll >= 0)
+	{
+		::close(m_epoll);
+		m_epoll = -1;
+	}
+#endif
+}
+
+bool EventLoop::add(NativeSocket handle, uint events, Handler handler)
+{
+	if (handle == INVALID_NATIVE_SOCKET || m_entries.count(handle))
+	{
+		return false;
+	}
+
+#ifndef _WIN32
+	epoll_event ev = {};
+	ev.events = toEpoll(events);
+	ev.data.fd = int(handle);
+	if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, int(handle), &ev) != 0)
+	{
+		LOG(MSG_ERROR, "epoll_ctl(ADD) failed with error: %d", errno);
+		return false;
+	}
+#endif
+
+	m_entries[handle] = Entry{events, handler};
+	return true;
+}
+
+bool EventLoop::modify(NativeSocket handle, uint events)
+{
+	auto it = m_entries.find(handle);
+	if (it == m_entries.end())
+	{
+		return false;
+	}
+
+#ifndef _WIN32
+	epoll_event ev = {};
+	ev.events = toEpoll(events);
+	ev.data.fd = int(handle);
+	if (epoll_ctl(m_epoll, EPOLL_CTL_MOD, int(handle), &ev) != 0)
+	{
+		LOG(MSG_ERROR, "epoll_ctl(MOD) failed with error: %d", errno);
+		return false;
+	}
+#endif
+
+	it->second.events = events;
+	return true;
+}
+
+void EventLoop::remove(NativeSocket handle)
+{
+	if (m_entries.erase(handle))
+	{
+#ifndef _WIN32
+		epoll_ctl(m_epoll, EPOLL_CTL_DEL, int(handle), nullptr);
+#endif
+	}
+}
+
+void EventLoop::dispatch(NativeSocket handle, uint events)
+{
+	// handlers may add or remove entries, so look the entry up right before the call
+	auto it = m_entries.find(handle);
+	if (it != m_entries.end())
+	{
+		Handler handler = it->second.handler;
+		handler(events);
+	}
+}
+
+int EventLoop::poll(int timeoutMs)
+{
+	if (m_entries.empty())
+	{
+		return 0;
+	}
+
+#ifdef _WIN32
+	std::vector<WSAPOLLFD> fds;
+	fds.reserve(m_entries.size());
+	for (const auto& e : m_entries)
+	{
+		WSAPOLLFD fd = {};
+		fd.fd = SOCKET(e.first);
+		fd.events = ((e.second.events & IO_READ) ? POLLRDNORM : 0) | ((e.second.events & IO_WRITE) ? POLLWRNORM : 0);
+		fds.push_back(fd);
+	}
+
+	int n = WSAPoll(fds.data(), ULONG(fds.size()), timeoutMs);
+	if (n < 0)
+	{
+		LOG(MSG_ERROR, "WSAPoll failed with error: %d", WSAGetLastError());
+		return -1;
+	}
+
+	int dispatched = 0;
+	for (const auto& fd : fds)
+	{
+		uint events = 0;
+		events |= (fd.revents & POLLRDNORM) ? IO_READ : 0;
+		events |= (fd.revents & POLLWRNORM) ? IO_WRITE : 0;
+		events |= (fd.revents & (POLLERR | POLLHUP | POLLNVAL)) ? IO_ERROR : 0;
+		if (events)
+		{
+			dispatch(NativeSocket(fd.fd), events);
+			++dispatched;
+		}
+	}
+
+	return dispatched;
+#else
+	epoll_event events[MAX_EVENTS_PER_POLL];
+
+	int n = epoll_wait(m_epoll, events, MAX_EVENTS_PER_POLL, timeoutMs);
+	if (n < 0)
+	{
+		if (errno == EINTR)
+		{
+			return 0;
+		}
+
+		LOG(MSG_ERROR, "epoll_wait failed with error: %d", errno);
+		return -1;
+	}
+
+	for (int i = 0; i < n; ++i)
+	{
+		dispatch(NativeSocket(events[i].data.fd), fromEpoll(events[i].events));
+	}
+
+	return n;
+#endif
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <functional>
+#include <unordered_map>
+#include "transport.h"
+
+// Readiness multiplexer that lets a single thread drive many transports.
+// Uses epoll on Linux and WSAPoll on Windows.
+// Drives the stand-in server and the download sessions of GameDownloader. Transports without a
+// handle cannot be waited for here, their owners service them on every pass.
+class EventLoop
+{
+public:
+	typedef std::function<void(uint events)> Handler;
+
+	EventLoop();
+	~EventLoop();
+	EventLoop(const EventLoop&) = delete;
+	EventLoop& operator=(const EventLoop&) = delete;
+
+	bool init();
+	void reset();
+
+	bool add(NativeSocket handle, uint events, Handler handler);
+	bool modify(NativeSocket handle, uint events);
+	void remove(NativeSocket handle);
+	bool empty() const { return m_entries.empty(); }
+
+	// Waits for readiness and dispatches handlers. Returns number of dispatched events or -1 on error.
+	int poll(int timeoutMs);
+
+private:
+	struct Entry
+	{
+		uint	events;
+		Handler handler;
+	};
+
+	void dispatch(NativeSocket handle, uint events);
+
+private:
+	std::unordered_map<NativeSocket, Entry> m_entries;
+	int										m_epoll;
+};
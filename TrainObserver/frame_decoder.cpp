@@ -0,0 +1,96 @@
+#include "frame_decoder.h"
+#include "log_interface.h"
+
+#include <string.h>
+
+
+FrameDecoder::FrameDecoder()
+	: FrameDecoder(std::make_shared<BufferPool>())
+{
+}
+
+FrameDecoder::FrameDecoder(std::shared_ptr<BufferPool> pool)
+	: m_pool(pool)
+{
+	next();
+}
+
+void FrameDecoder::next()
+{
+	m_headerBytes = 0;
+	m_bodyBytes = 0;
+	m_body.release();
+	m_result = Result::SOCKET_UNINITIALIZED;
+	m_ready = false;
+}
+
+char* FrameDecoder::prepare(size_t& capacity)
+{
+	if (m_ready)
+	{
+		capacity = 0;
+		return nullptr;
+	}
+
+	if (inHeader())
+	{
+		capacity = HEADER_SIZE - m_headerBytes;
+		return (char*)m_header + m_headerBytes;
+	}
+
+	capacity = m_body.size() - m_bodyBytes;
+	return m_body.data() + m_bodyBytes;
+}
+
+bool FrameDecoder::commit(size_t bytes)
+{
+	if (inHeader())
+	{
+		m_headerBytes += bytes;
+		if (inHeader())
+		{
+			return true;
+		}
+
+		MessageHeader header = MessageHeader::decode(m_header);
+		uint		  length = header.length;
+
+		if (length > MAX_BODY_LENGTH)
+		{
+			LOG(MSG_ERROR, "Incorrect response format: body length %u is too big", length);
+			return false;
+		}
+
+		m_result = Result(header.code);
+		m_body = m_pool->acquire(length);
+		m_ready = length == 0;
+		return true;
+	}
+
+	m_bodyBytes += bytes;
+	m_ready = m_bodyBytes == m_body.size();
+	return true;
+}
+
+size_t FrameDecoder::feed(const char* data, size_t size, bool& malformed)
+{
+	malformed = false;
+	size_t consumed = 0;
+	while (consumed < size && !m_ready)
+	{
+		size_t capacity = 0;
+		char*  dst = prepare(capacity);
+		size_t n = capacity < size - consumed ? capacity : size - consumed;
+
+		::memcpy(dst, data + consumed, n);
+		consumed += n;
+
+		if (!commit(n))
+		{
+			malformed = true;
+			break;
+		}
+	}
+
+	return consumed;
+}
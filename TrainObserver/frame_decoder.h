@@ -0,0 +1,42 @@
+#pragma once
+#include <memory>
+#include "buffer_pool.h"
+#include "defs.hpp"
+
+// Incremental decoder of server responses: Result code, body length and body.
+// Bytes can be pushed in any split, either by reading straight into prepare()
+// or by copying already received data with feed(). Bodies are read in place into
+// buffers borrowed from the pool.
+class FrameDecoder
+{
+public:
+	static const size_t HEADER_SIZE = MessageHeader::SIZE;
+	static const uint	MAX_BODY_LENGTH = 256 * 1024 * 1024;
+
+	FrameDecoder();
+	explicit FrameDecoder(std::shared_ptr<BufferPool> pool);
+
+	// Region the next read should fill. Never extends past the current frame.
+	char* prepare(size_t& capacity);
+	// Accounts bytes written into prepare() region. Returns false on malformed frame.
+	bool commit(size_t bytes);
+	// Copies as much of data as belongs to the current frame. Returns consumed byte count.
+	size_t feed(const char* data, size_t size, bool& malformed);
+
+	bool ready() const { return m_ready; }
+	bool inHeader() const { return m_headerBytes < HEADER_SIZE; }
+	Result result() const { return m_result; }
+	MessageBuffer& body() { return m_body; }
+
+	// Starts decoding of the next frame.
+	void next();
+
+private:
+	uchar						m_header[HEADER_SIZE];
+	size_t						m_headerBytes;
+	MessageBuffer				m_body;
+	size_t						m_bodyBytes;
+	Result						m_result;
+	bool						m_ready;
+	std::shared_ptr<BufferPool>	m_pool;
+};
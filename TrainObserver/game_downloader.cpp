@@ -0,0 +1,406 @@
+#include "game_downloader.h"
+#include "connection_manager.h"
+#include "event_loop.h"
+#include "json_query_builder.h"
+#include "log_interface.h"
+
+#include <algorithm>
+
+// TURN + MAP pair per turn, a claimed chunk fills the whole request window
+const size_t TURNS_PER_CHUNK = ConnectionManager::MAX_PENDING_REQUESTS / 2;
+// a stalled session gives its turns back to the others instead of hanging
+const int SESSION_RECEIVE_TIMEOUT_MS = 10000;
+// longest the loop sleeps, bounds how late a cancel or a stalled session is noticed
+const int POLL_INTERVAL_MS = 50;
+
+struct GameDownloader::Session
+{
+	uint								id = 0;
+	std::unique_ptr<ConnectionManager>	connection;
+	// INVALID_NATIVE_SOCKET for in-process transports, which are serviced on every pass
+	NativeSocket						handle = INVALID_NATIVE_SOCKET;
+	uint								events = 0;
+	bool								ready = false;
+
+	std::vector<int>					turns;
+	std::vector<std::string>			messages;
+	RequestTicket						tickets[ConnectionManager::MAX_PENDING_REQUESTS];
+	// turns of the chunk handed over so far
+	size_t								delivered = 0;
+	RequestTicket						logout = INVALID_TICKET;
+	// no response by then drops the session
+	uint64_t							deadlineUs = 0;
+};
+
+GameDownloader::GameDownloader()
+	: GameDownloader(createSocketTransport)
+{
+}
+
+GameDownloader::GameDownloader(TransportFactory factory)
+	: m_factory(factory)
+	, m_port(0)
+	, m_gameIdx(0)
+	, m_cancel(false)
+	, m_activeSessions(0)
+	, m_nextTurn(0)
+{
+}
+
+GameDownloader::~GameDownloader()
+{
+	cancel();
+}
+
+bool GameDownloader::start(const char* servername, uint16_t portNumber, uint gameIdx, int firstTurn, int lastTurn,
+	uint sessions, TurnHandler handler)
+{
+	cancel();
+
+	if (sessions == 0 || lastTurn < firstTurn || !handler)
+	{
+		return false;
+	}
+
+	m_servername = servername;
+	m_port = portNumber;
+	m_gameIdx = gameIdx;
+	m_handler = handler;
+	m_cancel = false;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_progress = DownloadProgress();
+		m_progress.firstTurn = firstTurn;
+		m_progress.lastTurn = lastTurn;
+		m_progress.total = uint(lastTurn - firstTurn + 1);
+		m_progress.loadedUntil = firstTurn - 1;
+		m_progress.sessions = sessions;
+		m_progress.finished = false;
+		m_nextTurn = firstTurn;
+		m_retry.clear();
+		m_loaded.assign(m_progress.total, 0);
+	}
+
+	LOG(MSG_NORMAL, "Downloading turns %d..%d of game %u over %u sessions", firstTurn, lastTurn, gameIdx, sessions);
+
+	m_activeSessions = sessions;
+	m_thread = std::thread(&GameDownloader::run, this, sessions);
+	return true;
+}
+
+void GameDownloader::cancel()
+{
+	m_cancel = true;
+	wait();
+}
+
+void GameDownloader::wait()
+{
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+bool GameDownloader::isRunning() const
+{
+	return m_activeSessions > 0;
+}
+
+bool GameDownloader::isLoaded(int turn) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	int							idx = turn - m_progress.firstTurn;
+	return idx >= 0 && idx < int(m_loaded.size()) && m_loaded[idx] != 0;
+}
+
+DownloadProgress GameDownloader::progress() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_progress;
+}
+
+void GameDownloader::run(uint sessions)
+{
+	EventLoop							  loop;
+	std::vector<std::unique_ptr<Session>> open;
+
+	// connecting and logging in are short handshakes and are done one session after another
+	bool looping = loop.init();
+	for (uint i = 0; looping && i < sessions && !m_cancel; ++i)
+	{
+		std::unique_ptr<Session> session = openSession(i);
+		Session*				 s = session.get();
+		if (!s || (s->handle != INVALID_NATIVE_SOCKET && !loop.add(s->handle, s->events, [s](uint) { s->ready = true; })))
+		{
+			if (s)
+			{
+				returnTurns(s->turns, 0);
+				s->connection->reset();
+			}
+			--m_activeSessions;
+			continue;
+		}
+		open.push_back(std::move(session));
+	}
+
+	while (!open.empty())
+	{
+		bool inProcess = std::any_of(open.begin(), open.end(),
+			[](const std::unique_ptr<Session>& s) { return s->handle == INVALID_NATIVE_SOCKET; });
+		if (loop.poll(inProcess ? 0 : POLL_INTERVAL_MS) < 0)
+		{
+			// nothing can be waited for any more, the turns go back and count as failed below
+			for (auto& s : open)
+			{
+				returnTurns(s->turns, s->delivered);
+				s->logout = INVALID_TICKET;
+				s->connection->reset();
+				closeSession(*s, loop);
+			}
+			break;
+		}
+
+		for (auto it = open.begin(); it != open.end();)
+		{
+			Session& s = **it;
+			bool	 active = !m_cancel;
+			if (active && (s.ready || s.handle == INVALID_NATIVE_SOCKET))
+			{
+				s.ready = false;
+				active = serviceSession(s);
+			}
+
+			if (active && NetworkStats::now() >= s.deadlineUs)
+			{
+				LOG(MSG_ERROR, "Download session %u got no response in time, dropping the connection", s.id);
+				returnTurns(s.turns, s.delivered);
+				s.logout = INVALID_TICKET;
+				s.connection->reset();
+				active = false;
+			}
+
+			if (!active)
+			{
+				closeSession(s, loop);
+				it = open.erase(it);
+				continue;
+			}
+
+			// write readiness is asked for only while requests wait for room in the socket
+			uint events = IO_READ | (s.connection->hasQueued() ? uint(IO_WRITE) : 0);
+			if (events != s.events && s.handle != INVALID_NATIVE_SOCKET)
+			{
+				loop.modify(s.handle, events);
+				s.events = events;
+			}
+			++it;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_activeSessions = 0;
+
+	// nobody is left to pick up what remains
+	if (!m_cancel)
+	{
+		m_progress.failed += uint(m_retry.size());
+		m_progress.failed += uint(std::max(m_progress.lastTurn - m_nextTurn + 1, 0));
+	}
+	m_retry.clear();
+	m_nextTurn = m_progress.lastTurn + 1;
+	m_progress.finished = true;
+
+	LOG(MSG_NORMAL, "Game download finished. Loaded: %u, failed: %u of %u turns", m_progress.loaded,
+		m_progress.failed, m_progress.total);
+}
+
+std::unique_ptr<GameDownloader::Session> GameDownloader::openSession(uint id)
+{
+	std::unique_ptr<Session> session(new Session());
+	session->id = id;
+	session->connection.reset(new ConnectionManager(m_factory()));
+
+	ConnectionManager& connection = *session->connection;
+	connection.setTrace(m_trace);
+	connection.setStats(m_stats);
+	connection.setReceiveTimeout(SESSION_RECEIVE_TIMEOUT_MS);
+	if (!connection.init() || !connection.connect(m_servername.c_str(), m_port) || !login(connection, m_gameIdx))
+	{
+		LOG(MSG_ERROR, "Download session %u failed to log in to %s:%d", id, m_servername.c_str(), m_port);
+		connection.reset();
+		return nullptr;
+	}
+
+	session->handle = connection.transport().handle();
+	if (!requestTurns(*session))
+	{
+		// every turn went to the sessions opened before
+		connection.sendMessage(Action::LOGOUT);
+		connection.reset();
+		return nullptr;
+	}
+
+	session->events = IO_READ | (connection.hasQueued() ? uint(IO_WRITE) : 0);
+	return session;
+}
+
+bool GameDownloader::requestTurns(Session& session)
+{
+	session.delivered = 0;
+	if (m_cancel || !claimTurns(session.turns))
+	{
+		return false;
+	}
+
+	Request requests[ConnectionManager::MAX_PENDING_REQUESTS];
+	session.messages.resize(2 * session.turns.size());
+	for (size_t i = 0; i < session.turns.size(); ++i)
+	{
+		JSONQueryWriter writer;
+		writer.add("idx", session.turns[i]);
+		session.messages[2 * i] = writer.str();
+		writer.add("layer", SpaceLayer::DYNAMIC);
+		session.messages[2 * i + 1] = writer.str();
+
+		requests[2 * i] = {Action::TURN, &session.messages[2 * i]};
+		requests[2 * i + 1] = {Action::MAP, &session.messages[2 * i + 1]};
+	}
+
+	// a write which fails right away fails the tickets, the turns go back when they are collected
+	if (!session.connection->queueRequests(requests, session.messages.size(), session.tickets))
+	{
+		returnTurns(session.turns, 0);
+		session.turns.clear();
+		return false;
+	}
+
+	session.deadlineUs = NetworkStats::now() + uint64_t(SESSION_RECEIVE_TIMEOUT_MS) * 1000;
+	return true;
+}
+
+bool GameDownloader::serviceSession(Session& session)
+{
+	ConnectionManager& connection = *session.connection;
+	connection.flush();
+	connection.receiveAvailable();
+
+	if (session.logout != INVALID_TICKET)
+	{
+		return !connection.hasResponse(session.logout);
+	}
+
+	MessageBuffer msg;
+	while (session.delivered < session.turns.size() && connection.hasResponse(session.tickets[2 * session.delivered + 1]))
+	{
+		size_t i = session.delivered++;
+		Result turnResult = connection.waitResponse(session.tickets[2 * i], msg);
+		Result mapResult = connection.waitResponse(session.tickets[2 * i + 1], msg);
+		session.deadlineUs = NetworkStats::now() + uint64_t(SESSION_RECEIVE_TIMEOUT_MS) * 1000;
+
+		if (ConnectionManager::isConnectionLost(turnResult) || ConnectionManager::isConnectionLost(mapResult))
+		{
+			// the rest of the chunk goes to other sessions
+			LOG(MSG_ERROR, "Download session %u lost connection", session.id);
+			returnTurns(session.turns, i);
+			connection.reset();
+			return false;
+		}
+
+		bool loaded = false;
+		if (turnResult == Result::OKEY && mapResult == Result::OKEY)
+		{
+			uint64_t parseStart = NetworkStats::now();
+			loaded = m_handler(session.turns[i], msg);
+			connection.stats().parse(StatsCategory::MAP_DYNAMIC, NetworkStats::now() - parseStart);
+		}
+		markTurn(session.turns[i], loaded);
+	}
+
+	if (session.delivered < session.turns.size() || requestTurns(session))
+	{
+		return true;
+	}
+
+	// nothing left to claim, the session says goodbye without waiting for the answer here
+	Request logout = {Action::LOGOUT, nullptr};
+	if (!connection.queueRequests(&logout, 1, &session.logout))
+	{
+		return false;
+	}
+	session.deadlineUs = NetworkStats::now() + uint64_t(SESSION_RECEIVE_TIMEOUT_MS) * 1000;
+	return !connection.hasResponse(session.logout);
+}
+
+void GameDownloader::closeSession(Session& session, EventLoop& loop)
+{
+	if (session.handle != INVALID_NATIVE_SOCKET)
+	{
+		loop.remove(session.handle);
+	}
+	session.connection->reset();
+	--m_activeSessions;
+}
+
+bool GameDownloader::login(const ConnectionManager& connection, uint gameIdx)
+{
+	std::string msg;
+	if (!connection.sendMessage(Action::OBSERVER, true) || connection.receiveMessage(msg) != Result::OKEY)
+	{
+		return false;
+	}
+
+	JSONQueryWriter writer;
+	writer.add("idx", gameIdx);
+	std::string request = writer.str();
+	return connection.sendMessage(Action::GAME, false, &request);
+}
+
+bool GameDownloader::claimTurns(std::vector<int>& turns)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	turns.clear();
+
+	// turns dropped by a broken session go first, they are the oldest
+	while (!m_retry.empty() && turns.size() < TURNS_PER_CHUNK)
+	{
+		turns.push_back(m_retry.back());
+		m_retry.pop_back();
+	}
+
+	while (m_nextTurn <= m_progress.lastTurn && turns.size() < TURNS_PER_CHUNK)
+	{
+		turns.push_back(m_nextTurn++);
+	}
+
+	return !turns.empty();
+}
+
+void GameDownloader::returnTurns(const std::vector<int>& turns, size_t from)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// kept in descending order so that back() is the earliest turn
+	m_retry.insert(m_retry.end(), turns.begin() + from, turns.end());
+	std::sort(m_retry.begin(), m_retry.end(), std::greater<int>());
+}
+
+void GameDownloader::markTurn(int turn, bool loaded)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!loaded)
+	{
+		++m_progress.failed;
+		return;
+	}
+
+	++m_progress.loaded;
+	m_loaded[turn - m_progress.firstTurn] = 1;
+	while (m_progress.loadedUntil < m_progress.lastTurn &&
+		   m_loaded[m_progress.loadedUntil + 1 - m_progress.firstTurn] != 0)
+	{
+		++m_progress.loadedUntil;
+	}
+}
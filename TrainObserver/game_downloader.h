@@ -0,0 +1,99 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "defs.hpp"
+#include "transport.h"
+
+class ConnectionManager;
+class EventLoop;
+class MessageBuffer;
+class NetworkStats;
+class TraceWriter;
+
+struct DownloadProgress
+{
+	int		firstTurn = 0;
+	int		lastTurn = -1;
+	uint	total = 0;
+	uint	loaded = 0;
+	uint	failed = 0;
+	// every turn in [firstTurn, loadedUntil] is loaded
+	int		loadedUntil = -1;
+	uint	sessions = 0;
+	bool	finished = true;
+};
+
+// Fetches DYNAMIC layers of a whole game over several independent observer sessions.
+// Each session logs in (OBSERVER + GAME) with its own connection and keeps claiming chunks of
+// the turn range until nothing is left, so throughput grows with the number of connections.
+// All sessions are driven by one EventLoop on a single thread, none of them blocks the others
+// once it is logged in.
+class GameDownloader
+{
+public:
+	// Called from the download thread with MAP body of the turn, returns false if body is unusable.
+	typedef std::function<bool(int turn, const MessageBuffer& body)>	TurnHandler;
+	typedef std::function<std::unique_ptr<ITransport>()>				TransportFactory;
+
+	GameDownloader();
+	explicit GameDownloader(TransportFactory factory);
+	~GameDownloader();
+	GameDownloader(const GameDownloader&) = delete;
+	GameDownloader& operator=(const GameDownloader&) = delete;
+
+	// sessions record their traffic to the trace as well
+	void setTrace(std::shared_ptr<TraceWriter> trace) { m_trace = trace; }
+	// sessions account their requests and the handler time to the stats
+	void setStats(std::shared_ptr<NetworkStats> stats) { m_stats = stats; }
+
+	bool start(const char* servername, uint16_t portNumber, uint gameIdx, int firstTurn, int lastTurn, uint sessions,
+		TurnHandler handler);
+	// Stops claiming new turns and waits for sessions to leave.
+	void cancel();
+	void wait();
+
+	bool isRunning() const;
+	bool isLoaded(int turn) const;
+	DownloadProgress progress() const;
+
+	// OBSERVER + GAME on a freshly connected session, the observer logs in again with it on reconnect
+	static bool login(const ConnectionManager& connection, uint gameIdx);
+
+private:
+	struct Session;
+
+	void run(uint sessions);
+	std::unique_ptr<Session> openSession(uint id);
+	// posts the next chunk, false if there is nothing left to claim
+	bool requestTurns(Session& session);
+	// sends, receives and hands over whatever is ready, false once the session is over
+	bool serviceSession(Session& session);
+	void closeSession(Session& session, EventLoop& loop);
+	bool claimTurns(std::vector<int>& turns);
+	void returnTurns(const std::vector<int>& turns, size_t from);
+	void markTurn(int turn, bool loaded);
+
+private:
+	TransportFactory			m_factory;
+	TurnHandler					m_handler;
+	std::shared_ptr<TraceWriter>	m_trace;
+	std::shared_ptr<NetworkStats>	m_stats;
+	std::string					m_servername;
+	uint16_t					m_port;
+	uint						m_gameIdx;
+
+	std::thread					m_thread;
+	std::atomic<bool>			m_cancel;
+	std::atomic<uint>			m_activeSessions;
+
+	mutable std::mutex	m_mutex;
+	DownloadProgress	m_progress;
+	int					m_nextTurn;
+	std::vector<int>	m_retry;
+	std::vector<char>	m_loaded;
+};
@@ -0,0 +1,540 @@
+#include "game_history.h"
+#include "space.h"
+
+#include <algorithm>
+
+
+namespace
+{
+enum TrainField : uint
+{
+	TRAIN_LINE = 1 << 0,
+	TRAIN_LEVEL = 1 << 1,
+	TRAIN_GOODS = 1 << 2,
+	TRAIN_GOODS_CAPACITY = 1 << 3,
+	TRAIN_PLAYER = 1 << 4,
+	TRAIN_POSITION = 1 << 5,
+	TRAIN_COOLDOWN = 1 << 6,
+	TRAIN_SPEED = 1 << 7,
+	TRAIN_REMOVED = 1 << 8
+};
+
+enum PostField : uint
+{
+	POST_ARMOR = 1 << 0,
+	POST_ARMOR_CAPACITY = 1 << 1,
+	POST_LEVEL = 1 << 2,
+	POST_POPULATION = 1 << 3,
+	POST_POPULATION_CAPACITY = 1 << 4,
+	POST_PRODUCT = 1 << 5,
+	POST_PRODUCT_CAPACITY = 1 << 6,
+	POST_TYPE = 1 << 7,
+	POST_NAME = 1 << 8,
+	POST_PLAYER = 1 << 9,
+	POST_REMOVED = 1 << 10
+};
+
+enum PlayerField : uint
+{
+	PLAYER_NAME = 1 << 0,
+	PLAYER_RATING = 1 << 1,
+	PLAYER_REMOVED = 1 << 2
+};
+
+void putVarint(std::vector<uchar>& out, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back(uchar(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(uchar(value));
+}
+
+bool getVarint(const uchar*& pos, const uchar* end, uint64_t& value)
+{
+	value = 0;
+	for (uint shift = 0; pos < end && shift < 64; shift += 7)
+	{
+		uchar byte = *pos++;
+		value |= uint64_t(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// speed is the only signed field, zigzag keeps small negative values short
+uint32_t zigzag(int value)
+{
+	return (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+}
+
+int unzigzag(uint64_t value)
+{
+	return int(uint32_t(value >> 1) ^ (0u - uint32_t(value & 1)));
+}
+
+// Entries of a section are only counted once all of them are written.
+void putSection(std::vector<uchar>& out, uint count, const std::vector<uchar>& section)
+{
+	putVarint(out, count);
+	out.insert(out.end(), section.begin(), section.end());
+}
+} // namespace
+
+GameHistory::GameHistory()
+	: m_turns(0)
+{
+}
+
+GameHistory::~GameHistory()
+{
+}
+
+void GameHistory::put(const DynamicLayer& layer)
+{
+	if (layer.turn < 0)
+	{
+		return;
+	}
+
+	SimpleMutexHolder holder(m_mutex);
+	int				  turn = layer.turn;
+	auto			  it = findBlock(turn);
+
+	if (it != m_blocks.end() && turn < it->first + int(it->second.offsets.size()))
+	{
+		return;
+	}
+
+	// a turn after a gap or ahead of its predecessor starts a keyframe of its own
+	if (it == m_blocks.end() || int(it->second.offsets.size()) == KEYFRAME_INTERVAL)
+	{
+		it = m_blocks.emplace(turn, Block()).first;
+	}
+
+	append(it->first, it->second, layer);
+	++m_turns;
+}
+
+bool GameHistory::get(int turn, DynamicLayer& layer) const
+{
+	if (turn < 0)
+	{
+		return false;
+	}
+
+	SimpleMutexHolder holder(m_mutex);
+	auto			  it = findBlock(turn);
+	if (it == m_blocks.end() || turn >= it->first + int(it->second.offsets.size()))
+	{
+		return false;
+	}
+
+	const Block& block = it->second;
+	int			 frame = turn - it->first;
+	if (block.tail && frame + 1 == int(block.offsets.size()))
+	{
+		layer = *block.tail;
+		return true;
+	}
+
+	if (!restore(block, frame, layer))
+	{
+		return false;
+	}
+
+	layer.turn = turn;
+	return true;
+}
+
+bool GameHistory::contains(int turn) const
+{
+	if (turn < 0)
+	{
+		return false;
+	}
+
+	SimpleMutexHolder holder(m_mutex);
+	auto			  it = findBlock(turn);
+	return it != m_blocks.end() && turn < it->first + int(it->second.offsets.size());
+}
+
+void GameHistory::clear()
+{
+	SimpleMutexHolder holder(m_mutex);
+	m_blocks.clear();
+	m_openBlocks.clear();
+	m_turns = 0;
+}
+
+size_t GameHistory::turns() const
+{
+	SimpleMutexHolder holder(m_mutex);
+	return m_turns;
+}
+
+size_t GameHistory::memoryUsage() const
+{
+	SimpleMutexHolder holder(m_mutex);
+	size_t			  bytes = sizeof(*this) + m_openBlocks.size() * sizeof(int);
+	for (const auto& b : m_blocks)
+	{
+		const Block& block = b.second;
+		bytes += sizeof(b) + block.data.capacity() + block.offsets.capacity() * sizeof(uint32_t);
+		if (block.tail)
+		{
+			bytes += block.tail->memoryUsage();
+		}
+	}
+
+	return bytes;
+}
+
+std::map<int, GameHistory::Block>::iterator GameHistory::findBlock(int turn)
+{
+	// the last block starting at or before the turn, it holds the turn or may be continued by it
+	auto it = m_blocks.upper_bound(turn);
+	if (it == m_blocks.begin())
+	{
+		return m_blocks.end();
+	}
+
+	--it;
+	return turn <= it->first + int(it->second.offsets.size()) ? it : m_blocks.end();
+}
+
+std::map<int, GameHistory::Block>::const_iterator GameHistory::findBlock(int turn) const
+{
+	return const_cast<GameHistory*>(this)->findBlock(turn);
+}
+
+void GameHistory::append(int first, Block& block, const DynamicLayer& layer)
+{
+	if (!block.tail)
+	{
+		block.tail.reset(new DynamicLayer());
+		if (!block.offsets.empty() && !restore(block, int(block.offsets.size()) - 1, *block.tail))
+		{
+			block.tail->trains.clear();
+			block.tail->posts.clear();
+			block.tail->players.clear();
+		}
+	}
+
+	block.offsets.push_back(uint32_t(block.data.size()));
+	encode(*block.tail, layer, block.data);
+
+	if (int(block.offsets.size()) == KEYFRAME_INTERVAL)
+	{
+		block.tail.reset();
+		block.data.shrink_to_fit();
+		block.offsets.shrink_to_fit();
+		return;
+	}
+
+	*block.tail = layer;
+
+	// only a few blocks are being filled at a time, the others rebuild their tail when continued
+	auto open = std::find(m_openBlocks.begin(), m_openBlocks.end(), first);
+	if (open != m_openBlocks.end())
+	{
+		m_openBlocks.erase(open);
+	}
+	m_openBlocks.push_back(first);
+
+	while (m_openBlocks.size() > MAX_OPEN_BLOCKS)
+	{
+		auto oldest = m_blocks.find(m_openBlocks.front());
+		if (oldest != m_blocks.end())
+		{
+			oldest->second.tail.reset();
+		}
+		m_openBlocks.pop_front();
+	}
+}
+
+bool GameHistory::restore(const Block& block, int frame, DynamicLayer& layer) const
+{
+	layer = DynamicLayer();
+	for (int i = 0; i <= frame; ++i)
+	{
+		const uchar* begin = block.data.data() + block.offsets[i];
+		const uchar* end = block.data.data() + (i + 1 < int(block.offsets.size()) ? block.offsets[i + 1] : block.data.size());
+		if (!decode(begin, end, layer))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void GameHistory::encode(const DynamicLayer& prev, const DynamicLayer& next, std::vector<uchar>& out)
+{
+	std::vector<uchar> section;
+	uint			   count = 0;
+
+	for (const auto& t : next.trains)
+	{
+		const Train& train = t.second;
+		auto		 old = prev.trains.find(t.first);
+		const Train* p = old != prev.trains.end() ? &old->second : nullptr;
+
+		uint mask = 0;
+		mask |= !p || p->line_idx != train.line_idx ? uint(TRAIN_LINE) : 0;
+		mask |= !p || p->level != train.level ? uint(TRAIN_LEVEL) : 0;
+		mask |= !p || p->goods != train.goods ? uint(TRAIN_GOODS) : 0;
+		mask |= !p || p->goods_capacity != train.goods_capacity ? uint(TRAIN_GOODS_CAPACITY) : 0;
+		mask |= !p || p->player_id != train.player_id ? uint(TRAIN_PLAYER) : 0;
+		mask |= !p || p->position != train.position ? uint(TRAIN_POSITION) : 0;
+		mask |= !p || p->cooldown != train.cooldown ? uint(TRAIN_COOLDOWN) : 0;
+		mask |= !p || p->speed != train.speed ? uint(TRAIN_SPEED) : 0;
+		if (mask == 0)
+		{
+			continue;
+		}
+
+		putVarint(section, t.first);
+		putVarint(section, mask);
+		if (mask & TRAIN_LINE)
+			putVarint(section, train.line_idx);
+		if (mask & TRAIN_LEVEL)
+			putVarint(section, train.level);
+		if (mask & TRAIN_GOODS)
+			putVarint(section, train.goods);
+		if (mask & TRAIN_GOODS_CAPACITY)
+			putVarint(section, train.goods_capacity);
+		if (mask & TRAIN_PLAYER)
+			putVarint(section, train.player_id);
+		if (mask & TRAIN_POSITION)
+			putVarint(section, train.position);
+		if (mask & TRAIN_COOLDOWN)
+			putVarint(section, train.cooldown);
+		if (mask & TRAIN_SPEED)
+			putVarint(section, zigzag(train.speed));
+		++count;
+	}
+
+	for (const auto& t : prev.trains)
+	{
+		if (next.trains.count(t.first) == 0)
+		{
+			putVarint(section, t.first);
+			putVarint(section, TRAIN_REMOVED);
+			++count;
+		}
+	}
+
+	putSection(out, count, section);
+	section.clear();
+	count = 0;
+
+	for (const auto& p : next.posts)
+	{
+		const Post& post = p.second;
+		auto		old = prev.posts.find(p.first);
+		const Post* o = old != prev.posts.end() ? &old->second : nullptr;
+
+		uint mask = 0;
+		mask |= !o || o->armor != post.armor ? uint(POST_ARMOR) : 0;
+		mask |= !o || o->armor_capacity != post.armor_capacity ? uint(POST_ARMOR_CAPACITY) : 0;
+		mask |= !o || o->level != post.level ? uint(POST_LEVEL) : 0;
+		mask |= !o || o->population != post.population ? uint(POST_POPULATION) : 0;
+		mask |= !o || o->population_capacity != post.population_capacity ? uint(POST_POPULATION_CAPACITY) : 0;
+		mask |= !o || o->product != post.product ? uint(POST_PRODUCT) : 0;
+		mask |= !o || o->product_capacity != post.product_capacity ? uint(POST_PRODUCT_CAPACITY) : 0;
+		mask |= !o || o->type != post.type ? uint(POST_TYPE) : 0;
+		mask |= !o || o->name != post.name ? uint(POST_NAME) : 0;
+		mask |= !o || o->player_id != post.player_id ? uint(POST_PLAYER) : 0;
+		if (mask == 0)
+		{
+			continue;
+		}
+
+		putVarint(section, p.first);
+		putVarint(section, mask);
+		if (mask & POST_ARMOR)
+			putVarint(section, post.armor);
+		if (mask & POST_ARMOR_CAPACITY)
+			putVarint(section, post.armor_capacity);
+		if (mask & POST_LEVEL)
+			putVarint(section, post.level);
+		if (mask & POST_POPULATION)
+			putVarint(section, post.population);
+		if (mask & POST_POPULATION_CAPACITY)
+			putVarint(section, post.population_capacity);
+		if (mask & POST_PRODUCT)
+			putVarint(section, post.product);
+		if (mask & POST_PRODUCT_CAPACITY)
+			putVarint(section, post.product_capacity);
+		if (mask & POST_TYPE)
+			putVarint(section, uint(post.type));
+		if (mask & POST_NAME)
+			putVarint(section, post.name);
+		if (mask & POST_PLAYER)
+			putVarint(section, post.player_id);
+		++count;
+	}
+
+	for (const auto& p : prev.posts)
+	{
+		if (next.posts.count(p.first) == 0)
+		{
+			putVarint(section, p.first);
+			putVarint(section, POST_REMOVED);
+			++count;
+		}
+	}
+
+	putSection(out, count, section);
+	section.clear();
+	count = 0;
+
+	for (const auto& p : next.players)
+	{
+		const Player& player = p.second;
+		auto		  old = prev.players.find(p.first);
+		const Player* o = old != prev.players.end() ? &old->second : nullptr;
+
+		uint mask = 0;
+		mask |= !o || o->name != player.name ? uint(PLAYER_NAME) : 0;
+		mask |= !o || o->rating != player.rating ? uint(PLAYER_RATING) : 0;
+		if (mask == 0)
+		{
+			continue;
+		}
+
+		putVarint(section, p.first);
+		putVarint(section, mask);
+		if (mask & PLAYER_NAME)
+			putVarint(section, player.name);
+		if (mask & PLAYER_RATING)
+			putVarint(section, player.rating);
+		++count;
+	}
+
+	for (const auto& p : prev.players)
+	{
+		if (next.players.count(p.first) == 0)
+		{
+			putVarint(section, p.first);
+			putVarint(section, PLAYER_REMOVED);
+			++count;
+		}
+	}
+
+	putSection(out, count, section);
+}
+
+bool GameHistory::decode(const uchar* pos, const uchar* end, DynamicLayer& layer) const
+{
+	uint64_t count = 0;
+	uint64_t idx = 0;
+	uint64_t mask = 0;
+	uint64_t v = 0;
+
+	// every field read goes through this, a short frame fails the whole decode
+#define READ(target, convert)              \
+	do                                     \
+	{                                      \
+		if (!getVarint(pos, end, v))       \
+			return false;                  \
+		target = convert;                  \
+	} while (0)
+
+	if (!getVarint(pos, end, count))
+		return false;
+	for (; count > 0; --count)
+	{
+		READ(idx, v);
+		READ(mask, v);
+		if (mask & TRAIN_REMOVED)
+		{
+			layer.trains.erase(uint(idx));
+			continue;
+		}
+
+		Train& train = layer.trains[uint(idx)];
+		train.idx = uint(idx);
+		if (mask & TRAIN_LINE)
+			READ(train.line_idx, uint(v));
+		if (mask & TRAIN_LEVEL)
+			READ(train.level, uint(v));
+		if (mask & TRAIN_GOODS)
+			READ(train.goods, uint(v));
+		if (mask & TRAIN_GOODS_CAPACITY)
+			READ(train.goods_capacity, uint(v));
+		if (mask & TRAIN_PLAYER)
+			READ(train.player_id, StringId(v));
+		if (mask & TRAIN_POSITION)
+			READ(train.position, uint(v));
+		if (mask & TRAIN_COOLDOWN)
+			READ(train.cooldown, uint(v));
+		if (mask & TRAIN_SPEED)
+			READ(train.speed, unzigzag(v));
+	}
+
+	if (!getVarint(pos, end, count))
+		return false;
+	for (; count > 0; --count)
+	{
+		READ(idx, v);
+		READ(mask, v);
+		if (mask & POST_REMOVED)
+		{
+			layer.posts.erase(uint(idx));
+			continue;
+		}
+
+		Post& post = layer.posts[uint(idx)];
+		post.idx = uint(idx);
+		if (mask & POST_ARMOR)
+			READ(post.armor, uint(v));
+		if (mask & POST_ARMOR_CAPACITY)
+			READ(post.armor_capacity, uint(v));
+		if (mask & POST_LEVEL)
+			READ(post.level, uint(v));
+		if (mask & POST_POPULATION)
+			READ(post.population, uint(v));
+		if (mask & POST_POPULATION_CAPACITY)
+			READ(post.population_capacity, uint(v));
+		if (mask & POST_PRODUCT)
+			READ(post.product, uint(v));
+		if (mask & POST_PRODUCT_CAPACITY)
+			READ(post.product_capacity, uint(v));
+		if (mask & POST_TYPE)
+			READ(post.type, EPostType(v));
+		if (mask & POST_NAME)
+			READ(post.name, StringId(v));
+		if (mask & POST_PLAYER)
+			READ(post.player_id, StringId(v));
+	}
+
+	if (!getVarint(pos, end, count))
+		return false;
+	for (; count > 0; --count)
+	{
+		READ(idx, v);
+		READ(mask, v);
+		StringId id = StringId(idx);
+		if (mask & PLAYER_REMOVED)
+		{
+			layer.players.erase(id);
+			continue;
+		}
+
+		Player& player = layer.players[id];
+		player.id = id;
+		if (mask & PLAYER_NAME)
+			READ(player.name, StringId(v));
+		if (mask & PLAYER_RATING)
+			READ(player.rating, uint(v));
+	}
+
+#undef READ
+	return pos == end;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+#include "defs.hpp"
+#include "mutex.h"
+
+struct DynamicLayer;
+
+// Compact store of every turn of a game. Turns are kept in blocks of up to KEYFRAME_INTERVAL
+// consecutive turns: a keyframe followed by deltas carrying only the train, post and player fields
+// which changed since the previous turn. A turn is restored by replaying its block up to it.
+// Turns may be put in any order, a turn which does not continue a block starts a new one. Thread safe.
+class GameHistory
+{
+public:
+	static const int KEYFRAME_INTERVAL = 32;
+	// blocks which keep the state after their last frame to append the next turn without replay
+	static const size_t MAX_OPEN_BLOCKS = 8;
+
+	GameHistory();
+	~GameHistory();
+	GameHistory(const GameHistory&) = delete;
+	GameHistory& operator=(const GameHistory&) = delete;
+
+	void put(const DynamicLayer& layer);
+	bool get(int turn, DynamicLayer& layer) const;
+	bool contains(int turn) const;
+	void clear();
+
+	size_t turns() const;
+	size_t memoryUsage() const;
+
+private:
+	struct Block
+	{
+		// keyframe followed by deltas of consecutive turns, frame i starts at offsets[i]
+		std::vector<uchar>				data;
+		std::vector<uint32_t>			offsets;
+		// state after the last frame, dropped once the block is complete or others were appended to since
+		std::unique_ptr<DynamicLayer>	tail;
+	};
+
+	// block holding the turn or the one it continues, m_blocks.end() if there is none
+	std::map<int, Block>::iterator findBlock(int turn);
+	std::map<int, Block>::const_iterator findBlock(int turn) const;
+	void append(int first, Block& block, const DynamicLayer& layer);
+	bool restore(const Block& block, int frame, DynamicLayer& layer) const;
+	void encode(const DynamicLayer& prev, const DynamicLayer& next, std::vector<uchar>& out);
+	bool decode(const uchar* pos, const uchar* end, DynamicLayer& layer) const;
+
+private:
+	mutable SimpleMutex							m_mutex;
+	// by the turn of the keyframe
+	std::map<int, Block>						m_blocks;
+	// first turns of the blocks with a tail, the oldest loses it when there are too many
+	std::deque<int>								m_openBlocks;
+	size_t										m_turns;
+};
@@ -22,70 +22,61 @@ std::string JSONQueryWriter::str()
 
 //////////////////////////////////////////////////////////////////////////
 
-JSONQueryReader::JSONQueryReader(const std::string& str)
+JSONQueryReader::JSONQueryReader()
+	: m_node(&Json::Value::nullSingleton())
 {
-	Json::CharReaderBuilder readerBuilder;
-	std::unique_ptr<Json::CharReader>	reader(readerBuilder.newCharReader());
-
-	std::string errs;
-	m_valid = reader->parse(str.c_str(), str.c_str() + str.length(), &m_root, &errs);
 }
 
-JSONQueryReader::JSONQueryReader(const Json::Value& value):
-	m_root(value)
+JSONQueryReader::JSONQueryReader(const Json::Value& node)
+	: m_node(&node)
 {
-	m_valid = true;
 }
 
-
 JSONQueryReader JSONQueryReader::getValue(const char* name) const
 {
-	return m_root[name];	
+	const Json::Value* member = m_node->isObject() ? m_node->find(name, name + strlen(name)) : nullptr;
+	return member ? JSONQueryReader(*member) : JSONQueryReader();
 }
 
-std::vector<JSONQueryReader> JSONQueryReader::asArray() const
+JSONQueryReader JSONQueryReader::getValue(const Json::Key& key) const
 {
-	std::vector<JSONQueryReader> res;
-	const Json::Value& val = m_root;
-	if (!val.isNull())
-	{
-		for (auto it = val.begin(); it != val.end(); ++it)
-		{
-			res.emplace_back(*it);
-		}
-	}
+	const Json::Value* member = m_node->find(key);
+	return member ? JSONQueryReader(*member) : JSONQueryReader();
+}
 
-	return res;
+JSONQueryReader::Array JSONQueryReader::asArray() const
+{
+	return Array(m_node->isArray() ? *m_node : Json::Value::nullSingleton());
 }
 
 template<>
 int JSONQueryReader::get<int>(const char* name) const
 {
-	return m_root[name].asInt();
+	return getValue(name).m_node->asInt();
 }
 
 template<>
 uint JSONQueryReader::get<uint>(const char* name) const
 {
-	return m_root[name].asUInt();
+	return getValue(name).m_node->asUInt();
 }
 
 template<>
 float JSONQueryReader::get<float>(const char* name) const
 {
-	return m_root[name].asFloat();
+	return getValue(name).m_node->asFloat();
 }
 
 template<>
 std::string JSONQueryReader::get<std::string>(const char* name) const
 {
-	return m_root[name].asString();
+	return getValue(name).m_node->asString();
 }
 
 template<>
 bool JSONQueryReader::get<bool>(const char* name) const
 {
-	return m_root[name].asBool();
+	return getValue(name).m_node->asBool();
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -93,29 +84,210 @@ bool JSONQueryReader::get<bool>(const char* name) const
 template<>
 int JSONQueryReader::get<int>() const
 {
-	return m_root.asInt();
+	return m_node->asInt();
 }
 
 template<>
 unsigned int JSONQueryReader::get<unsigned int>() const
 {
-	return m_root.asUInt();
+	return m_node->asUInt();
 }
 
 template<>
 float JSONQueryReader::get<float>() const
 {
-	return m_root.asFloat();
+	return m_node->asFloat();
 }
 
 template<>
 std::string JSONQueryReader::get<std::string>() const
 {
-	return m_root.asString();
+	return m_node->asString();
 }
 
 template<>
 bool JSONQueryReader::get<bool>() const
 {
-	return m_root.asBool();
-}
\ No newline at end of file
+	return m_node->asBool();
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+JSONDocument::JSONDocument()
+	: m_valid(false)
+{
+}
+
+bool JSONDocument::parse(const char* begin, const char* end)
+{
+	// the reader keeps no state between documents, only its setup is worth keeping
+	static thread_local std::unique_ptr<Json::CharReader> reader;
+	if (!reader)
+	{
+		Json::CharReaderBuilder readerBuilder;
+		// the whole document goes with it in one release
+		readerBuilder["useArena"] = true;
+		reader.reset(readerBuilder.newCharReader());
+	}
+
+	m_error.clear();
+	m_valid = reader->parse(begin, end, &m_root, &m_error);
+	return m_valid;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+JSONRecordReader::JSONRecordReader()
+	: m_array(nullptr)
+	, m_inArray(false)
+	, m_depth(0)
+{
+}
+
+void JSONRecordReader::bind(const char* name, JSONArrayBinding& binding)
+{
+	m_arrays.push_back(Array{name, &binding, false});
+}
+
+bool JSONRecordReader::parse(const char* begin, const char* end)
+{
+	for (Array& a : m_arrays)
+	{
+		a.found = false;
+	}
+	m_array = nullptr;
+	m_inArray = false;
+	m_depth = 0;
+	m_error.clear();
+
+	return Json::parseEvents(begin, end, *this, &m_error);
+}
+
+bool JSONRecordReader::found(const char* name) const
+{
+	for (const Array& a : m_arrays)
+	{
+		if (a.name == name)
+		{
+			return a.found;
+		}
+	}
+	return false;
+}
+
+bool JSONRecordReader::onScalar(const JSONScalar& value)
+{
+	if (m_depth == 3 && m_inArray)
+	{
+		m_array->binding->setField(m_key.data(), m_key.size(), value);
+	}
+	return true;
+}
+
+bool JSONRecordReader::onNull()
+{
+	return onScalar(JSONScalar());
+}
+
+bool JSONRecordReader::onBool(bool value)
+{
+	JSONScalar scalar;
+	scalar.type = JSONScalar::BOOLEAN;
+	scalar.integer = value ? 1 : 0;
+	scalar.real = double(scalar.integer);
+	return onScalar(scalar);
+}
+
+bool JSONRecordReader::onInt(Json::LargestInt value)
+{
+	JSONScalar scalar;
+	scalar.type = JSONScalar::NUMBER;
+	scalar.integer = value;
+	scalar.real = double(value);
+	return onScalar(scalar);
+}
+
+bool JSONRecordReader::onUInt(Json::LargestUInt value)
+{
+	JSONScalar scalar;
+	scalar.type = JSONScalar::NUMBER;
+	scalar.integer = Json::LargestInt(value);
+	scalar.real = double(value);
+	return onScalar(scalar);
+}
+
+bool JSONRecordReader::onDouble(double value)
+{
+	JSONScalar scalar;
+	scalar.type = JSONScalar::NUMBER;
+	scalar.integer = Json::LargestInt(value);
+	scalar.real = value;
+	return onScalar(scalar);
+}
+
+bool JSONRecordReader::onString(const char* begin, const char* end)
+{
+	JSONScalar scalar;
+	scalar.type = JSONScalar::STRING;
+	scalar.begin = begin;
+	scalar.end = end;
+	return onScalar(scalar);
+}
+
+bool JSONRecordReader::onKey(const char* begin, const char* end)
+{
+	if (m_depth == 1)
+	{
+		m_array = nullptr;
+		for (Array& a : m_arrays)
+		{
+			if (a.name.size() == size_t(end - begin) && memcmp(a.name.data(), begin, a.name.size()) == 0)
+			{
+				m_array = &a;
+				break;
+			}
+		}
+	}
+	else if (m_depth == 3)
+	{
+		m_key.assign(begin, end);
+	}
+	return true;
+}
+
+bool JSONRecordReader::onObjectBegin()
+{
+	if (++m_depth == 3 && m_inArray)
+	{
+		m_array->binding->beginRecord();
+	}
+	return true;
+}
+
+bool JSONRecordReader::onObjectEnd()
+{
+	if (m_depth-- == 3 && m_inArray)
+	{
+		m_array->binding->endRecord();
+	}
+	return true;
+}
+
+bool JSONRecordReader::onArrayBegin()
+{
+	if (++m_depth == 2 && m_array)
+	{
+		m_array->found = true;
+		m_inArray = true;
+	}
+	return true;
+}
+
+bool JSONRecordReader::onArrayEnd()
+{
+	if (m_depth-- == 2)
+	{
+		m_inArray = false;
+	}
+	return true;
+}
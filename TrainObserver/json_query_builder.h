@@ -1,7 +1,11 @@
 #pragma once
 
 #include "json/json.h"
+#include <functional>
 #include <memory>
+#include <string.h>
+#include <type_traits>
+#include <vector>
 
 namespace Json
 {
@@ -26,25 +30,263 @@ private:
 	std::unique_ptr<Json::StreamWriter> m_writer;
 };
 
+// View of a node of a JSONDocument, it is only a pointer and valid as long as the document.
+// Missing members and elements read as null, so navigating a payload never copies a subtree.
 class JSONQueryReader
 {
 public:
-	JSONQueryReader(const std::string& str);
-	JSONQueryReader(const Json::Value& value);
+	class Iterator
+	{
+	public:
+		explicit Iterator(Json::Value::const_iterator it)
+			: m_it(it)
+		{
+		}
+
+		JSONQueryReader operator*() const { return JSONQueryReader(*m_it); }
+		Iterator& operator++()
+		{
+			++m_it;
+			return *this;
+		}
+		bool operator==(const Iterator& other) const { return m_it == other.m_it; }
+		bool operator!=(const Iterator& other) const { return m_it != other.m_it; }
+
+	private:
+		Json::Value::const_iterator m_it;
+	};
+
+	// elements of an array node, empty for any other node
+	class Array
+	{
+	public:
+		explicit Array(const Json::Value& node)
+			: m_node(&node)
+		{
+		}
+
+		Iterator begin() const { return Iterator(m_node->begin()); }
+		Iterator end() const { return Iterator(m_node->end()); }
+		size_t size() const { return m_node->size(); }
+		bool empty() const { return size() == 0; }
+		JSONQueryReader operator[](size_t index) const { return JSONQueryReader((*m_node)[Json::ArrayIndex(index)]); }
+
+	private:
+		const Json::Value*	m_node;
+	};
+
+	// null node
+	JSONQueryReader();
+	explicit JSONQueryReader(const Json::Value& node);
 
 	template<typename T>
 	T get(const char* name) const;
 	template<typename T>
 	T get() const;
+	// the key is hashed once, for members read from every object of an array
+	template<typename T>
+	T get(const Json::Key& key) const
+	{
+		return getValue(key).get<T>();
+	}
 
 	JSONQueryReader getValue(const char* name) const;
-	std::vector<JSONQueryReader> asArray() const;
+	JSONQueryReader getValue(const Json::Key& key) const;
+	Array asArray() const;
+
+	bool isValid() const { return !m_node->isNull(); }
+private:
+	const Json::Value*	m_node;
+};
+
+// Parsed message, read through the views root() gives out.
+class JSONDocument
+{
+public:
+	JSONDocument();
+	JSONDocument(const JSONDocument&) = delete;
+	JSONDocument& operator=(const JSONDocument&) = delete;
+
+	// Replaces the document, views of the previous one are invalidated. The range is parsed in
+	// place by a reader kept for the calling thread.
+	bool parse(const char* begin, const char* end);
+	bool parse(const std::string& str) { return parse(str.data(), str.data() + str.size()); }
 
+	JSONQueryReader root() const { return JSONQueryReader(m_root); }
 	bool isValid() const { return m_valid; }
+	const std::string& error() const { return m_error; }
+
 private:
 	Json::Value	m_root;
+	std::string	m_error;
 	bool		m_valid;
 };
 
 
+// Scalar field of a record, strings are only valid during the call they are passed to.
+struct JSONScalar
+{
+	enum Type
+	{
+		NONE,
+		NUMBER,
+		STRING,
+		BOOLEAN
+	};
+
+	Type				type = NONE;
+	// numbers and booleans, in both forms
+	Json::LargestInt	integer = 0;
+	double				real = 0.0;
+	const char*			begin = nullptr;
+	const char*			end = nullptr;
+};
+
+// Objects of one array of a document, see JSONRecordReader.
+class JSONArrayBinding
+{
+public:
+	virtual ~JSONArrayBinding() {}
+
+	virtual void beginRecord() = 0;
+	virtual void setField(const char* name, size_t length, const JSONScalar& value) = 0;
+	virtual void endRecord() = 0;
+};
+
+// Fills a Record from the fields of every object and passes it to the sink once the object ends.
+// Fields missing in an object stay value-initialized, unbound ones and nested values are skipped.
+template <typename Record>
+class JSONRecordBinding : public JSONArrayBinding
+{
+public:
+	typedef std::function<void(const Record& record)> Sink;
+	typedef std::function<void(Record& record, const char* begin, const char* end)> StringSetter;
+
+	explicit JSONRecordBinding(Sink sink)
+		: m_sink(sink)
+		, m_next(0)
+	{
+	}
+
+	// numeric member, enums included
+	template <typename T>
+	JSONRecordBinding& field(const char* name, T Record::*member)
+	{
+		m_fields.push_back(Field{name, [member](Record& record, const JSONScalar& value) {
+									 if (value.type == JSONScalar::NUMBER || value.type == JSONScalar::BOOLEAN)
+									 {
+										 assign(record.*member, value, std::is_floating_point<T>());
+									 }
+								 }});
+		return *this;
+	}
+
+	JSONRecordBinding& field(const char* name, StringSetter setter)
+	{
+		m_fields.push_back(Field{name, [setter](Record& record, const JSONScalar& value) {
+									 if (value.type == JSONScalar::STRING)
+									 {
+										 setter(record, value.begin, value.end);
+									 }
+								 }});
+		return *this;
+	}
+
+	virtual void beginRecord() override
+	{
+		m_record = Record();
+		m_next = 0;
+	}
+
+	virtual void setField(const char* name, size_t length, const JSONScalar& value) override
+	{
+		// objects of an array usually list their fields in the same order, so the search starts
+		// right after the field matched last
+		for (size_t i = 0; i < m_fields.size(); ++i)
+		{
+			size_t		 f = (m_next + i) % m_fields.size();
+			const Field& field = m_fields[f];
+			if (field.name.size() == length && memcmp(field.name.data(), name, length) == 0)
+			{
+				field.set(m_record, value);
+				m_next = f + 1;
+				return;
+			}
+		}
+	}
+
+	virtual void endRecord() override { m_sink(m_record); }
+
+private:
+	struct Field
+	{
+		std::string												name;
+		std::function<void(Record& record, const JSONScalar& value)>	set;
+	};
+
+	template <typename T>
+	static void assign(T& target, const JSONScalar& value, std::true_type /*floating*/)
+	{
+		target = static_cast<T>(value.real);
+	}
+
+	template <typename T>
+	static void assign(T& target, const JSONScalar& value, std::false_type /*floating*/)
+	{
+		target = static_cast<T>(value.integer);
+	}
+
+private:
+	std::vector<Field>	m_fields;
+	Sink				m_sink;
+	Record				m_record;
+	size_t				m_next;
+};
+
+// Reads arrays of objects under the keys of the root object straight into records, see
+// Json::parseEvents. No Json::Value is built and the document is scanned once.
+class JSONRecordReader : private Json::EventHandler
+{
+public:
+	JSONRecordReader();
+
+	// the binding has to outlive parse()
+	void bind(const char* name, JSONArrayBinding& binding);
+	bool parse(const char* begin, const char* end);
+	// whether the last document parsed had the array
+	bool found(const char* name) const;
+	const std::string& error() const { return m_error; }
+
+private:
+	struct Array
+	{
+		std::string			name;
+		JSONArrayBinding*	binding;
+		bool				found;
+	};
+
+	bool onScalar(const JSONScalar& value);
+
+	virtual bool onNull() override;
+	virtual bool onBool(bool value) override;
+	virtual bool onInt(Json::LargestInt value) override;
+	virtual bool onUInt(Json::LargestUInt value) override;
+	virtual bool onDouble(double value) override;
+	virtual bool onString(const char* begin, const char* end) override;
+	virtual bool onKey(const char* begin, const char* end) override;
+	virtual bool onObjectBegin() override;
+	virtual bool onObjectEnd() override;
+	virtual bool onArrayBegin() override;
+	virtual bool onArrayEnd() override;
 
+private:
+	std::vector<Array>	m_arrays;
+	std::string			m_error;
+	// array selected by the last key of the root object, nullptr if it is not bound
+	Array*				m_array;
+	bool				m_inArray;
+	// the root object is at depth 1, its arrays at 2 and their records at 3
+	int					m_depth;
+	// last key of a record, copied as the parser reuses its buffer
+	std::string			m_key;
+};
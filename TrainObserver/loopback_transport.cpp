@@ -0,0 +1,183 @@
+#include "loopback_transport.h"
+#include "log_interface.h"
+
+#include <string.h>
+
+
+LoopbackServer::LoopbackServer()
+{
+}
+
+LoopbackServer::~LoopbackServer()
+{
+}
+
+void LoopbackServer::setHandler(Action action, Handler handler)
+{
+	m_handlers[action] = handler;
+}
+
+void LoopbackServer::setResponse(Action action, Result result, const std::string& response)
+{
+	m_handlers[action] = [result, response](const std::string&, std::string& out) {
+		out = response;
+		return result;
+	};
+}
+
+Result LoopbackServer::handle(Action action, const std::string& request, std::string& response)
+{
+	auto it = m_handlers.find(action);
+	if (it == m_handlers.end())
+	{
+		response.clear();
+		return Result::BAD_COMMAND;
+	}
+
+	return it->second(request, response);
+}
+
+bool LoopbackServer::process(const char* data, size_t size, std::string& output)
+{
+	m_pending.append(data, size);
+
+	size_t pos = 0;
+	while (m_pending.size() - pos >= MessageHeader::SIZE)
+	{
+		MessageHeader header = MessageHeader::decode((const uchar*)m_pending.data() + pos);
+
+		size_t frameLength = MessageHeader::SIZE + header.length;
+		if (m_pending.size() - pos < frameLength)
+		{
+			break;
+		}
+
+		std::string request(m_pending, pos + MessageHeader::SIZE, header.length);
+		std::string response;
+		Result		result = handle(Action(header.code), request, response);
+
+		uchar responseHeader[MessageHeader::SIZE];
+		MessageHeader{uint32_t(result), uint32_t(response.size())}.encode(responseHeader);
+		output.append((const char*)responseHeader, MessageHeader::SIZE);
+		output.append(response);
+
+		pos += frameLength;
+	}
+
+	m_pending.erase(0, pos);
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+LoopbackTransport::LoopbackTransport(std::shared_ptr<LoopbackServer> server)
+	: m_server(server)
+	, m_readPos(0)
+	, m_connected(false)
+{
+}
+
+bool LoopbackTransport::init()
+{
+	reset();
+	return m_server != nullptr;
+}
+
+void LoopbackTransport::reset()
+{
+	m_output.clear();
+	m_readPos = 0;
+	m_connected = false;
+}
+
+bool LoopbackTransport::connect(const char* servername, uint16_t portNumber)
+{
+	m_connected = m_server != nullptr;
+	if (m_connected)
+	{
+		LOG(MSG_NORMAL, "Connected to loopback server as %s:%d.", servername, portNumber);
+	}
+	return m_connected;
+}
+
+bool LoopbackTransport::isConnected() const
+{
+	return m_connected;
+}
+
+IoStatus LoopbackTransport::write(const char* buf, size_t nbytes, size_t& written)
+{
+	written = 0;
+	if (!m_connected)
+	{
+		return IoStatus::FAILED;
+	}
+
+	if (!m_server->process(buf, nbytes, m_output))
+	{
+		return IoStatus::FAILED;
+	}
+
+	written = nbytes;
+	return IoStatus::OK;
+}
+
+IoStatus LoopbackTransport::writev(const IoSlice* slices, size_t count, size_t& written)
+{
+	written = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		size_t n = 0;
+		IoStatus status = write(slices[i].data, slices[i].size, n);
+		if (status != IoStatus::OK)
+		{
+			return status;
+		}
+		written += n;
+	}
+
+	return IoStatus::OK;
+}
+
+IoStatus LoopbackTransport::read(char* buf, size_t nbytes, size_t& received)
+{
+	received = 0;
+	if (!m_connected)
+	{
+		return IoStatus::FAILED;
+	}
+
+	size_t available = m_output.size() - m_readPos;
+	if (available == 0)
+	{
+		return IoStatus::WOULD_BLOCK;
+	}
+
+	received = nbytes < available ? nbytes : available;
+	::memcpy(buf, m_output.data() + m_readPos, received);
+	m_readPos += received;
+
+	if (m_readPos == m_output.size())
+	{
+		m_output.clear();
+		m_readPos = 0;
+	}
+
+	return IoStatus::OK;
+}
+
+bool LoopbackTransport::wait(uint events, int /*timeoutMs*/)
+{
+	// the server answers synchronously inside write(), so an empty output means nothing will ever come
+	if (events & IO_WRITE)
+	{
+		return m_connected;
+	}
+
+	return m_connected && m_readPos < m_output.size();
+}
+
+NativeSocket LoopbackTransport::handle() const
+{
+	return INVALID_NATIVE_SOCKET;
+}
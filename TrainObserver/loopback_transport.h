@@ -0,0 +1,54 @@
+#pragma once
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include "transport.h"
+
+// In-process stand-in for the game server. Decodes action frames written by the
+// client and answers every complete one with the handler registered for its action.
+class LoopbackServer
+{
+public:
+	typedef std::function<Result(const std::string& request, std::string& response)> Handler;
+
+	LoopbackServer();
+	virtual ~LoopbackServer();
+
+	void setHandler(Action action, Handler handler);
+	void setResponse(Action action, Result result, const std::string& response = std::string());
+
+	// Consumes client bytes and appends encoded responses to output.
+	bool process(const char* data, size_t size, std::string& output);
+
+protected:
+	virtual Result handle(Action action, const std::string& request, std::string& response);
+
+private:
+	std::map<Action, Handler>	m_handlers;
+	std::string					m_pending;
+};
+
+class LoopbackTransport : public ITransport
+{
+public:
+	explicit LoopbackTransport(std::shared_ptr<LoopbackServer> server);
+
+	bool init() override;
+	void reset() override;
+	bool connect(const char* servername, uint16_t portNumber) override;
+	bool isConnected() const override;
+
+	IoStatus write(const char* buf, size_t nbytes, size_t& written) override;
+	IoStatus writev(const IoSlice* slices, size_t count, size_t& written) override;
+	IoStatus read(char* buf, size_t nbytes, size_t& received) override;
+	bool wait(uint events, int timeoutMs) override;
+
+	NativeSocket handle() const override;
+
+private:
+	std::shared_ptr<LoopbackServer> m_server;
+	std::string						m_output;
+	size_t							m_readPos;
+	bool							m_connected;
+};
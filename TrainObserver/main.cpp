@@ -8,6 +8,27 @@ const size_t MAXBUF = 1024;
 
 CAppModule _Module;
 
+// value following the option name, quotes allow spaces in it
+static std::string commandLineOption(const std::string& cmdLine, const std::string& name)
+{
+	size_t pos = cmdLine.find(name + " ");
+	if (pos == std::string::npos)
+	{
+		return std::string();
+	}
+
+	pos = cmdLine.find_first_not_of(' ', pos + name.size());
+	if (pos == std::string::npos)
+	{
+		return std::string();
+	}
+
+	char   separator = cmdLine[pos] == '"' ? '"' : ' ';
+	size_t begin = separator == '"' ? pos + 1 : pos;
+	size_t end = cmdLine.find(separator, begin);
+	return cmdLine.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+}
+
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
 {
 	HRESULT hRes = ::CoInitializeEx(NULL, COINIT_MULTITHREADED);
@@ -25,6 +46,37 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 	if (IDOK == dlg.DoModal())
 	{
 		AppManager app;
+
+		// -record <trace> keeps the server traffic, -replay <trace> plays it back without the server
+		std::string recordPath = commandLineOption(lpCmdLine, "-record");
+		std::string replayPath = commandLineOption(lpCmdLine, "-replay");
+		// -stats <file> writes per action latency histograms on exit
+		std::string statsPath = commandLineOption(lpCmdLine, "-stats");
+		if (!statsPath.empty())
+		{
+			app.dumpStats(statsPath.c_str());
+		}
+		// -cache <megabytes> bounds the memory of decoded turns kept for scrubbing
+		std::string cacheSize = commandLineOption(lpCmdLine, "-cache");
+		if (!cacheSize.empty())
+		{
+			app.cacheBudget(size_t(atoi(cacheSize.c_str())) * 1024 * 1024);
+		}
+		// -mapcache <dir> keeps compiled maps, "-mapcache off" compiles the map on every start
+		std::string mapCache = commandLineOption(lpCmdLine, "-mapcache");
+		if (!mapCache.empty())
+		{
+			app.mapCacheDir(mapCache == "off" ? "" : mapCache.c_str());
+		}
+		if (!replayPath.empty())
+		{
+			app.replayTrace(replayPath.c_str());
+		}
+		else if (!recordPath.empty())
+		{
+			app.recordTrace(recordPath.c_str());
+		}
+
 		if (app.initialize(hInstance, nCmdShow, 1600, 1100))
 		{
 			if (app.connect(dlg.serverAddr(), dlg.port()))
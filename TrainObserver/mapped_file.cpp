@@ -0,0 +1,162 @@
+#include "mapped_file.h"
+#include "log_interface.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile()
+	: m_data(nullptr)
+	, m_size(0)
+	, m_opened(false)
+	, m_file(-1)
+	, m_mapping(-1)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char* path)
+{
+	close();
+
+	HANDLE file = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		LOG(MSG_ERROR, "Cannot open file %s: %d", path, ::GetLastError());
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx(file, &size))
+	{
+		LOG(MSG_ERROR, "Cannot get size of file %s: %d", path, ::GetLastError());
+		::CloseHandle(file);
+		return false;
+	}
+
+	m_file = intptr_t(file);
+	m_size = size_t(size.QuadPart);
+	m_opened = true;
+
+	// empty files cannot be mapped
+	if (m_size == 0)
+	{
+		return true;
+	}
+
+	HANDLE mapping = ::CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+	{
+		LOG(MSG_ERROR, "Cannot map file %s: %d", path, ::GetLastError());
+		close();
+		return false;
+	}
+
+	m_mapping = intptr_t(mapping);
+	m_data = (const char*)::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (m_data == nullptr)
+	{
+		LOG(MSG_ERROR, "Cannot map view of file %s: %d", path, ::GetLastError());
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data)
+	{
+		::UnmapViewOfFile(m_data);
+	}
+	if (m_mapping != -1)
+	{
+		::CloseHandle(HANDLE(m_mapping));
+	}
+	if (m_file != -1)
+	{
+		::CloseHandle(HANDLE(m_file));
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+	m_opened = false;
+	m_file = -1;
+	m_mapping = -1;
+}
+
+#else
+
+bool MappedFile::open(const char* path)
+{
+	close();
+
+	int file = ::open(path, O_RDONLY);
+	if (file < 0)
+	{
+		LOG(MSG_ERROR, "Cannot open file %s", path);
+		return false;
+	}
+
+	struct stat st;
+	if (::fstat(file, &st) != 0)
+	{
+		LOG(MSG_ERROR, "Cannot get size of file %s", path);
+		::close(file);
+		return false;
+	}
+
+	m_file = file;
+	m_size = size_t(st.st_size);
+	m_opened = true;
+
+	// empty files cannot be mapped
+	if (m_size == 0)
+	{
+		return true;
+	}
+
+	void* data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+	if (data == MAP_FAILED)
+	{
+		LOG(MSG_ERROR, "Cannot map file %s", path);
+		close();
+		return false;
+	}
+
+	m_data = (const char*)data;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data)
+	{
+		::munmap((void*)m_data, m_size);
+	}
+	if (m_file != -1)
+	{
+		::close(int(m_file));
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+	m_opened = false;
+	m_file = -1;
+	m_mapping = -1;
+}
+
+#endif
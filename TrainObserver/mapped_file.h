@@ -0,0 +1,28 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Read-only view of a whole file mapped into memory.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const char* path);
+	void close();
+
+	bool		isOpen() const { return m_opened; }
+	const char* data() const { return m_data; }
+	const char* end() const { return m_data + m_size; }
+	size_t		size() const { return m_size; }
+
+private:
+	const char* m_data;
+	size_t		m_size;
+	bool		m_opened;
+	intptr_t	m_file;
+	intptr_t	m_mapping;
+};
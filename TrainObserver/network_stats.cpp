@@ -0,0 +1,276 @@
+#include "network_stats.h"
+#include "log_interface.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+
+LatencyHistogram::LatencyHistogram()
+{
+	clear();
+}
+
+void LatencyHistogram::record(uint64_t us)
+{
+	++m_buckets[bucket(us)];
+	++m_count;
+	m_sum += us;
+	m_min = us < m_min ? us : m_min;
+	m_max = us > m_max ? us : m_max;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+	for (uint i = 0; i < BUCKETS; ++i)
+	{
+		m_buckets[i] += other.m_buckets[i];
+	}
+	m_count += other.m_count;
+	m_sum += other.m_sum;
+	m_min = other.m_min < m_min ? other.m_min : m_min;
+	m_max = other.m_max > m_max ? other.m_max : m_max;
+}
+
+void LatencyHistogram::clear()
+{
+	memset(m_buckets, 0, sizeof(m_buckets));
+	m_count = 0;
+	m_sum = 0;
+	m_min = UINT64_MAX;
+	m_max = 0;
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const
+{
+	if (m_count == 0)
+	{
+		return 0;
+	}
+
+	uint64_t rank = uint64_t(fraction * double(m_count - 1)) + 1;
+	uint64_t seen = 0;
+	for (uint i = 0; i < BUCKETS; ++i)
+	{
+		seen += m_buckets[i];
+		if (seen >= rank)
+		{
+			uint64_t bound = upperBound(i);
+			return bound < m_max ? bound : m_max;
+		}
+	}
+
+	return m_max;
+}
+
+uint LatencyHistogram::bucket(uint64_t us)
+{
+	if (us < 2)
+	{
+		return 0;
+	}
+
+	// octave is the highest set bit, the next two bits select the bucket inside it
+	uint octave = 63;
+	while ((us >> octave) == 0)
+	{
+		--octave;
+	}
+
+	uint sub = octave >= 2 ? uint(us >> (octave - 2)) & 3 : uint(us << (2 - octave)) & 3;
+	uint idx = octave * BUCKETS_PER_OCTAVE + sub;
+	return idx < BUCKETS ? idx : BUCKETS - 1;
+}
+
+uint64_t LatencyHistogram::upperBound(uint bucket)
+{
+	uint octave = bucket / BUCKETS_PER_OCTAVE;
+	uint sub = bucket % BUCKETS_PER_OCTAVE;
+	return ((uint64_t(5 + sub) << octave) >> 2) - (octave >= 2 ? 1 : 0);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+NetworkStats::NetworkStats()
+{
+}
+
+uint64_t NetworkStats::now()
+{
+	using namespace std::chrono;
+	return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+StatsCategory NetworkStats::category(Action action, const char* request, size_t requestLength)
+{
+	switch (action)
+	{
+	case Action::LOGIN:
+		return StatsCategory::LOGIN;
+	case Action::LOGOUT:
+		return StatsCategory::LOGOUT;
+	case Action::MOVE:
+		return StatsCategory::MOVE;
+	case Action::TURN:
+		return StatsCategory::TURN;
+	case Action::OBSERVER:
+		return StatsCategory::OBSERVER;
+	case Action::GAME:
+		return StatsCategory::GAME;
+	case Action::MAP:
+		break;
+	default:
+		return StatsCategory::OTHER;
+	}
+
+	// MAP requests are tiny, looking the layer up in the text is cheaper than parsing them
+	const char* end = request + requestLength;
+	const char* pos = request;
+	const char	key[] = "\"layer\"";
+	while (pos && size_t(end - pos) >= sizeof(key) - 1 && memcmp(pos, key, sizeof(key) - 1) != 0)
+	{
+		pos = (const char*)memchr(pos + 1, '"', end - pos - 1);
+	}
+
+	uint layer = 0;
+	if (pos && size_t(end - pos) >= sizeof(key) - 1)
+	{
+		for (pos += sizeof(key) - 1; pos < end && (*pos == ' ' || *pos == ':'); ++pos)
+		{
+		}
+		for (; pos < end && *pos >= '0' && *pos <= '9'; ++pos)
+		{
+			layer = layer * 10 + uint(*pos - '0');
+		}
+	}
+
+	switch (layer)
+	{
+	case SpaceLayer::DYNAMIC:
+		return StatsCategory::MAP_DYNAMIC;
+	case SpaceLayer::COORDINATES:
+		return StatsCategory::MAP_COORDINATES;
+	default:
+		return StatsCategory::MAP_STATIC;
+	}
+}
+
+const char* NetworkStats::name(StatsCategory category)
+{
+	static const char* names[] = {"LOGIN", "LOGOUT", "MOVE", "TURN", "MAP STATIC", "MAP DYNAMIC", "MAP COORDINATES",
+		"OBSERVER", "GAME", "OTHER"};
+	return category < StatsCategory::COUNT ? names[uint(category)] : "";
+}
+
+void NetworkStats::request(StatsCategory category, size_t bytesOut)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	ActionStats&				stats = m_stats.actions[uint(category)];
+	++stats.requests;
+	stats.bytesOut += bytesOut;
+}
+
+void NetworkStats::response(StatsCategory category, Result result, size_t bytesIn, uint64_t sentUs,
+	uint64_t firstByteUs, uint64_t receivedUs)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	ActionStats&				stats = m_stats.actions[uint(category)];
+
+	stats.bytesIn += bytesIn;
+	if (result != Result::OKEY)
+	{
+		++stats.errors;
+	}
+
+	// with pipelining the first byte may already wait in the socket before the request is accounted
+	firstByteUs = firstByteUs > sentUs ? firstByteUs : sentUs;
+	stats.roundTrip.record(receivedUs - sentUs);
+	stats.firstByte.record(firstByteUs - sentUs);
+	stats.transfer.record(receivedUs - firstByteUs);
+}
+
+void NetworkStats::parse(StatsCategory category, uint64_t us)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.actions[uint(category)].parse.record(us);
+}
+
+void NetworkStats::syscalls(uint reads, uint writes, uint waits)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.reads += reads;
+	m_stats.writes += writes;
+	m_stats.waits += waits;
+}
+
+NetworkStatsSnapshot NetworkStats::snapshot() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void NetworkStats::reset()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats = NetworkStatsSnapshot();
+}
+
+std::string NetworkStats::format() const
+{
+	NetworkStatsSnapshot stats = snapshot();
+	std::string			 out;
+	char				 line[512];
+
+	snprintf(line, sizeof(line), "%-16s %8s %6s %12s %12s | %27s | %20s | %20s | %20s\n", "action", "requests",
+		"errors", "bytes out", "bytes in", "round trip us p50/p90/p99", "first byte p50/p99", "transfer p50/p99",
+		"parse p50/p99");
+	out += line;
+
+	for (uint i = 0; i < uint(StatsCategory::COUNT); ++i)
+	{
+		const ActionStats& s = stats.actions[i];
+		if (s.requests == 0 && s.parse.count() == 0)
+		{
+			continue;
+		}
+
+		snprintf(line, sizeof(line), "%-16s %8llu %6llu %12llu %12llu | %8llu %8llu %9llu | %9llu %10llu | %9llu %10llu | %9llu %10llu\n",
+			name(StatsCategory(i)), (unsigned long long)s.requests, (unsigned long long)s.errors,
+			(unsigned long long)s.bytesOut, (unsigned long long)s.bytesIn,
+			(unsigned long long)s.roundTrip.percentile(0.5), (unsigned long long)s.roundTrip.percentile(0.9),
+			(unsigned long long)s.roundTrip.percentile(0.99), (unsigned long long)s.firstByte.percentile(0.5),
+			(unsigned long long)s.firstByte.percentile(0.99), (unsigned long long)s.transfer.percentile(0.5),
+			(unsigned long long)s.transfer.percentile(0.99), (unsigned long long)s.parse.percentile(0.5),
+			(unsigned long long)s.parse.percentile(0.99));
+		out += line;
+	}
+
+	snprintf(line, sizeof(line), "syscalls: %llu reads, %llu writes, %llu waits\n", (unsigned long long)stats.reads,
+		(unsigned long long)stats.writes, (unsigned long long)stats.waits);
+	out += line;
+
+	return out;
+}
+
+bool NetworkStats::dump(const char* path) const
+{
+	FILE* file = nullptr;
+#ifdef _WIN32
+	if (fopen_s(&file, path, "w") != 0)
+	{
+		file = nullptr;
+	}
+#else
+	file = fopen(path, "w");
+#endif
+	if (!file)
+	{
+		LOG(MSG_ERROR, "Cannot write network statistics to %s", path);
+		return false;
+	}
+
+	std::string text = format();
+	fwrite(text.data(), 1, text.size(), file);
+	fclose(file);
+	return true;
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include "defs.hpp"
+
+// Log-scale histogram of durations in microseconds, four buckets per power of two.
+class LatencyHistogram
+{
+public:
+	static const uint BUCKETS_PER_OCTAVE = 4;
+	static const uint BUCKETS = 40 * BUCKETS_PER_OCTAVE;
+
+	LatencyHistogram();
+
+	void record(uint64_t us);
+	void merge(const LatencyHistogram& other);
+	void clear();
+
+	uint64_t count() const { return m_count; }
+	uint64_t lowest() const { return m_count ? m_min : 0; }
+	uint64_t highest() const { return m_max; }
+	uint64_t mean() const { return m_count ? m_sum / m_count : 0; }
+	// upper bound of the bucket holding the given fraction (0..1) of samples
+	uint64_t percentile(double fraction) const;
+
+private:
+	static uint		bucket(uint64_t us);
+	static uint64_t upperBound(uint bucket);
+
+private:
+	uint64_t m_buckets[BUCKETS];
+	uint64_t m_count;
+	uint64_t m_sum;
+	uint64_t m_min;
+	uint64_t m_max;
+};
+
+// Requests are accounted per action, MAP requests per layer.
+enum class StatsCategory : uint
+{
+	LOGIN,
+	LOGOUT,
+	MOVE,
+	TURN,
+	MAP_STATIC,
+	MAP_DYNAMIC,
+	MAP_COORDINATES,
+	OBSERVER,
+	GAME,
+	OTHER,
+	COUNT
+};
+
+struct ActionStats
+{
+	uint64_t requests = 0;
+	uint64_t errors = 0;
+	uint64_t bytesOut = 0;
+	uint64_t bytesIn = 0;
+	// send to the whole response received
+	LatencyHistogram roundTrip;
+	// send to the first byte of the response, then the rest of the body
+	LatencyHistogram firstByte;
+	LatencyHistogram transfer;
+	// client side decoding of the body
+	LatencyHistogram parse;
+};
+
+struct NetworkStatsSnapshot
+{
+	ActionStats actions[uint(StatsCategory::COUNT)];
+	uint64_t	reads = 0;
+	uint64_t	writes = 0;
+	uint64_t	waits = 0;
+
+	const ActionStats& operator[](StatsCategory category) const { return actions[uint(category)]; }
+};
+
+// Instrumentation of the network layer, shared by any number of connections.
+class NetworkStats
+{
+public:
+	NetworkStats();
+
+	static uint64_t		 now();
+	static StatsCategory category(Action action, const char* request, size_t requestLength);
+	static const char*	 name(StatsCategory category);
+
+	void request(StatsCategory category, size_t bytesOut);
+	void response(StatsCategory category, Result result, size_t bytesIn, uint64_t sentUs, uint64_t firstByteUs,
+		uint64_t receivedUs);
+	void parse(StatsCategory category, uint64_t us);
+	void syscalls(uint reads, uint writes, uint waits);
+
+	NetworkStatsSnapshot snapshot() const;
+	void				 reset();
+
+	// human readable table of all categories
+	std::string format() const;
+	bool		dump(const char* path) const;
+
+private:
+	mutable std::mutex	 m_mutex;
+	NetworkStatsSnapshot m_stats;
+};
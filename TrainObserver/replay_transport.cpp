@@ -0,0 +1,49 @@
+#include "replay_transport.h"
+#include "log_interface.h"
+#include "trace.h"
+
+#include <string.h>
+
+
+ReplayServer::ReplayServer(std::shared_ptr<const TraceReader> trace)
+	: m_trace(trace)
+	, m_cursor(0)
+	, m_hasTurn(false)
+{
+}
+
+Result ReplayServer::handle(Action action, const std::string& request, std::string& response)
+{
+	const char* turn = m_hasTurn ? m_turn.data() : nullptr;
+	size_t		idx = m_cursor;
+	if (idx >= m_trace->size() || m_trace->record(idx).action != action ||
+		m_trace->record(idx).requestLength != request.size() ||
+		memcmp(m_trace->record(idx).request, request.data(), request.size()) != 0 ||
+		!TraceReader::isAfterTurn(m_trace->record(idx), turn, m_turn.size()))
+	{
+		idx = m_trace->find(action, request.data(), request.size(), turn, m_turn.size(), m_cursor);
+	}
+
+	if (action == Action::TURN)
+	{
+		m_turn = request;
+		m_hasTurn = true;
+	}
+
+	if (idx == TraceReader::NOT_FOUND)
+	{
+		LOG(MSG_WARNING, "Request %u is not in the trace: %s", uint(action), request.c_str());
+		response.clear();
+		return Result::BAD_COMMAND;
+	}
+
+	const TraceRecord& record = m_trace->record(idx);
+	response.assign(record.response, record.responseLength);
+	m_cursor = idx + 1;
+	return record.result;
+}
+
+std::unique_ptr<ITransport> createReplayTransport(std::shared_ptr<const TraceReader> trace)
+{
+	return std::unique_ptr<ITransport>(new LoopbackTransport(std::make_shared<ReplayServer>(trace)));
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <memory>
+#include <string>
+#include "loopback_transport.h"
+
+class TraceReader;
+
+// Answers requests from a recorded trace instead of the game server. Requests are expected in
+// recorded order, anything else (seek, other session of the trace) is looked up by its payload
+// and the TURN request sent before it on this connection.
+class ReplayServer : public LoopbackServer
+{
+public:
+	explicit ReplayServer(std::shared_ptr<const TraceReader> trace);
+
+protected:
+	Result handle(Action action, const std::string& request, std::string& response) override;
+
+private:
+	std::shared_ptr<const TraceReader>	m_trace;
+	size_t								m_cursor;
+	std::string							m_turn;
+	bool								m_hasTurn;
+};
+
+// Transport which plays back a trace, several transports may share one reader.
+std::unique_ptr<ITransport> createReplayTransport(std::shared_ptr<const TraceReader> trace);
@@ -2,10 +2,16 @@
 #include "skybox.h"
 #include "space.h"
 #include "space_renderer.h"
+#include "log_interface.h"
+#include "render_dx9.h"
+
+// how far from the cursor a click still selects an object
+const int PICK_RADIUS_PIXELS = 8;
 
 
 SceneManager::SceneManager():
-	m_renderer(new SpaceRenderer())
+	m_renderer(new SpaceRenderer()),
+	m_hasSelection(false)
 {
 }
 
@@ -46,7 +52,7 @@ void SceneManager::draw(RendererDX9& renderer)
 }
 
 
-bool SceneManager::initStaticScene(ConnectionManager& connection)
+bool SceneManager::initStaticScene(AsyncConnection& connection)
 {
 	if (m_space->initStaticLayer(connection))
 	{
@@ -57,7 +63,7 @@ bool SceneManager::initStaticScene(ConnectionManager& connection)
 	return false;
 }
 
-bool SceneManager::updateDynamicScene(class ConnectionManager& connection, float turn)
+bool SceneManager::updateDynamicScene(AsyncConnection& connection, float turn)
 {
 	if (m_space->updateDynamicLayer(connection, turn))
 	{
@@ -70,5 +76,38 @@ bool SceneManager::updateDynamicScene(class ConnectionManager& connection, float
 
 void SceneManager::onLMouseUp(int x, int y)
 {
-	
+	const Camera& camera = RenderSystemDX9::instance().renderer().camera();
+
+	Vector3 origin, dir;
+	camera.screenPosToRay(x, y, origin, dir);
+	if (dir.y > -1e-6f)
+	{
+		return;
+	}
+
+	// the pick radius is the ground distance a few pixels away from the cursor
+	Vector3 edgeOrigin, edgeDir;
+	camera.screenPosToRay(x + PICK_RADIUS_PIXELS, y, edgeOrigin, edgeDir);
+	Vector3 ground = origin + dir * (-origin.y / dir.y);
+	Vector3 edge = edgeDir.y < -1e-6f ? edgeOrigin + edgeDir * (-edgeOrigin.y / edgeDir.y) : ground;
+	float	radius = (edge - ground).length();
+
+	float rayOrigin[3] = {origin.x, origin.y, origin.z};
+	float rayDir[3] = {dir.x, dir.y, dir.z};
+
+	// trains are over posts, posts are over rails
+	SpatialHit hit;
+	m_hasSelection = m_space->spatial().pickRay(rayOrigin, rayDir, radius, SPATIAL_TRAIN, hit) ||
+					 m_space->spatial().pickRay(rayOrigin, rayDir, radius, SPATIAL_POST, hit);
+	if (m_hasSelection)
+	{
+		m_selection = hit;
+		LOG(MSG_NORMAL, "Selected %s %u", hit.kind == SPATIAL_TRAIN ? "train" : "post", hit.idx);
+	}
+}
+
+bool SceneManager::selection(SpatialHit& hit) const
+{
+	hit = m_selection;
+	return m_hasSelection;
 }
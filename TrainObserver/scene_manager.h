@@ -2,6 +2,7 @@
 #include <memory>
 #include "render_interface.h"
 #include "message_interface.h"
+#include "spatial_index.h"
 
 
 
@@ -16,15 +17,20 @@ public:
 
 	virtual void draw(RendererDX9& renderer) override;
 
-	bool initStaticScene(class ConnectionManager& connection);
-	bool updateDynamicScene(class ConnectionManager& connection, float turn);
+	bool initStaticScene(class AsyncConnection& connection);
+	bool updateDynamicScene(class AsyncConnection& connection, float turn);
 
 
 	virtual void onLMouseUp(int x, int y) override;
 
+	// train or post clicked last
+	bool selection(SpatialHit& hit) const;
+
 private:
 	std::unique_ptr<class SkyBox>			m_skybox;
 	std::unique_ptr<Space>					m_space;
 	std::unique_ptr<class SpaceRenderer>	m_renderer;
+	SpatialHit								m_selection;
+	bool									m_hasSelection;
 };
 
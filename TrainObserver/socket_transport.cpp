@@ -0,0 +1,466 @@
+#include "socket_transport.h"
+#include "log_interface.h"
+
+#include <mutex>
+#include <string.h>
+
+#ifdef _WIN32
+
+#include <winsock2.h>
+#include <Ws2tcpip.h>
+
+#define SOCKET_LAST_ERROR WSAGetLastError()
+#define SOCKET_WOULD_BLOCK(err) ((err) == WSAEWOULDBLOCK)
+#define SOCKET_IN_PROGRESS(err) ((err) == WSAEWOULDBLOCK || (err) == WSAEINPROGRESS)
+#define SEND_FLAGS 0
+
+typedef WSAPOLLFD pollfd_t;
+typedef WSABUF	  iovec_t;
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#define SOCKET_LAST_ERROR errno
+#define SOCKET_WOULD_BLOCK(err) ((err) == EAGAIN || (err) == EWOULDBLOCK)
+#define SOCKET_IN_PROGRESS(err) ((err) == EINPROGRESS)
+#define SEND_FLAGS MSG_NOSIGNAL
+#define SOCKET_ERROR (-1)
+
+typedef struct pollfd pollfd_t;
+typedef struct iovec  iovec_t;
+
+#endif
+
+namespace
+{
+const int CONNECT_TIMEOUT_MS = 10000;
+// MAP layers are megabytes long, a big kernel buffer lets a single recv drain more of them
+const int RECEIVE_BUFFER_SIZE = 1024 * 1024;
+// slices passed to one gathered send, bigger batches go out in several calls
+const size_t MAX_SEND_SLICES = 256;
+
+#ifdef _WIN32
+const uint WSA_VERSION_LO = 2;
+const uint WSA_VERSION_HI = 2;
+
+// WSAStartup is reference counted so several sessions can live side by side.
+std::mutex	g_wsaMutex;
+uint		g_wsaUsers = 0;
+
+bool startupSockets()
+{
+	std::lock_guard<std::mutex> lock(g_wsaMutex);
+	if (g_wsaUsers > 0)
+	{
+		++g_wsaUsers;
+		return true;
+	}
+
+	WSADATA wsaData;
+
+	int err = WSAStartup(MAKEWORD(WSA_VERSION_LO, WSA_VERSION_HI), &wsaData);
+	if (err != 0)
+	{
+		LOG(MSG_ERROR, "WSAStartup failed with error: %d", err);
+		return false;
+	}
+
+	/* Note that if the DLL supports versions greater    */
+	/* than 2.2 in addition to 2.2, it will still return */
+	/* 2.2 in wVersion since that is the version we      */
+	/* requested.                                        */
+	if (LOBYTE(wsaData.wVersion) != WSA_VERSION_LO || HIBYTE(wsaData.wVersion) != WSA_VERSION_HI)
+	{
+		LOG(MSG_ERROR, "Could not find a usable version of Winsock.dll");
+		WSACleanup();
+		return false;
+	}
+
+	LOG(MSG_NORMAL, "The Winsock %d.%d dll was found okay", WSA_VERSION_HI, WSA_VERSION_LO);
+	++g_wsaUsers;
+	return true;
+}
+
+void cleanupSockets()
+{
+	std::lock_guard<std::mutex> lock(g_wsaMutex);
+	if (g_wsaUsers > 0 && --g_wsaUsers == 0)
+	{
+		WSACleanup();
+	}
+}
+
+int pollSockets(pollfd_t* fds, size_t count, int timeoutMs)
+{
+	return WSAPoll(fds, ULONG(count), timeoutMs);
+}
+
+void closeNative(NativeSocket s)
+{
+	closesocket(SOCKET(s));
+}
+
+bool setNonBlocking(NativeSocket s)
+{
+	u_long mode = 1;
+	return ioctlsocket(SOCKET(s), FIONBIO, &mode) == 0;
+}
+
+void setSlice(iovec_t& vec, const IoSlice& slice)
+{
+	vec.buf = const_cast<CHAR*>(slice.data);
+	vec.len = ULONG(slice.size);
+}
+
+int sendSlices(NativeSocket s, iovec_t* vecs, size_t count)
+{
+	DWORD sent = 0;
+	if (WSASend(SOCKET(s), vecs, DWORD(count), &sent, 0, NULL, NULL) == SOCKET_ERROR)
+	{
+		return SOCKET_ERROR;
+	}
+	return int(sent);
+}
+#else
+bool startupSockets()
+{
+	return true;
+}
+
+void cleanupSockets()
+{
+}
+
+int pollSockets(pollfd_t* fds, size_t count, int timeoutMs)
+{
+	int n;
+	do
+	{
+		n = ::poll(fds, nfds_t(count), timeoutMs);
+	} while (n < 0 && errno == EINTR);
+	return n;
+}
+
+void closeNative(NativeSocket s)
+{
+	::close(int(s));
+}
+
+bool setNonBlocking(NativeSocket s)
+{
+	int flags = fcntl(int(s), F_GETFL, 0);
+	return flags >= 0 && fcntl(int(s), F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+void setSlice(iovec_t& vec, const IoSlice& slice)
+{
+	vec.iov_base = const_cast<char*>(slice.data);
+	vec.iov_len = slice.size;
+}
+
+int sendSlices(NativeSocket s, iovec_t* vecs, size_t count)
+{
+	msghdr msg = {};
+	msg.msg_iov = vecs;
+	msg.msg_iovlen = count;
+	return int(::sendmsg(int(s), &msg, SEND_FLAGS));
+}
+#endif
+} // namespace
+
+std::unique_ptr<ITransport> createSocketTransport()
+{
+	return std::unique_ptr<ITransport>(new SocketTransport());
+}
+
+SocketTransport::SocketTransport()
+	: m_socket(INVALID_NATIVE_SOCKET)
+	, m_initialized(false)
+	, m_connected(false)
+{
+}
+
+SocketTransport::~SocketTransport()
+{
+	reset();
+}
+
+bool SocketTransport::init()
+{
+	reset();
+
+	if (!startupSockets())
+	{
+		return false;
+	}
+
+	m_initialized = true;
+
+	if (!createSocket())
+	{
+		cleanupSockets();
+		m_initialized = false;
+		return false;
+	}
+
+	return true;
+}
+
+void SocketTransport::reset()
+{
+	if (m_initialized)
+	{
+		closeSocket();
+		cleanupSockets();
+		m_initialized = false;
+	}
+}
+
+bool SocketTransport::connect(const char* servername, uint16_t portNumber)
+{
+	if (!m_initialized)
+	{
+		LOG(MSG_ERROR, "Trying to connect with uninitialized socket layer");
+		return false;
+	}
+
+	if (m_socket == INVALID_NATIVE_SOCKET && !createSocket())
+	{
+		return false;
+	}
+
+	sockaddr_in addr;
+	if (!initAddr(servername, portNumber, addr))
+	{
+		return false;
+	}
+
+	/*---Connect to server---*/
+	int result = ::connect(m_socket, (sockaddr*)&addr, sizeof(addr));
+	if (result == SOCKET_ERROR)
+	{
+		int err = SOCKET_LAST_ERROR;
+		if (!SOCKET_IN_PROGRESS(err))
+		{
+			LOG(MSG_ERROR, "connect function failed with error: %d", err);
+			closeSocket();
+			return false;
+		}
+
+		if (!wait(IO_WRITE, CONNECT_TIMEOUT_MS))
+		{
+			LOG(MSG_ERROR, "Connection to server %s:%d timed out", servername, portNumber);
+			closeSocket();
+			return false;
+		}
+
+		int		  soError = 0;
+		socklen_t len = sizeof(soError);
+		getsockopt(m_socket, SOL_SOCKET, SO_ERROR, (char*)&soError, &len);
+		if (soError != 0)
+		{
+			LOG(MSG_ERROR, "connect function failed with error: %d", soError);
+			closeSocket();
+			return false;
+		}
+	}
+
+	// requests are small and latency bound
+	int noDelay = 1;
+	setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+
+	m_connected = true;
+	LOG(MSG_NORMAL, "Connected to server %s:%d.", servername, portNumber);
+	return true;
+}
+
+bool SocketTransport::isConnected() const
+{
+	return m_connected;
+}
+
+IoStatus SocketTransport::write(const char* buf, size_t nbytes, size_t& written)
+{
+	written = 0;
+	if (!m_connected)
+	{
+		LOG(MSG_ERROR, "Trying to send message to disconnected server");
+		return IoStatus::FAILED;
+	}
+
+	int result = ::send(m_socket, buf, int(nbytes), SEND_FLAGS);
+	if (result == SOCKET_ERROR)
+	{
+		int err = SOCKET_LAST_ERROR;
+		if (SOCKET_WOULD_BLOCK(err))
+		{
+			return IoStatus::WOULD_BLOCK;
+		}
+
+		LOG(MSG_ERROR, "send of message failed with error: %d", err);
+		return IoStatus::FAILED;
+	}
+
+	written = size_t(result);
+	return IoStatus::OK;
+}
+
+IoStatus SocketTransport::writev(const IoSlice* slices, size_t count, size_t& written)
+{
+	written = 0;
+	if (!m_connected)
+	{
+		LOG(MSG_ERROR, "Trying to send message to disconnected server");
+		return IoStatus::FAILED;
+	}
+
+	iovec_t vecs[MAX_SEND_SLICES];
+	count = count < MAX_SEND_SLICES ? count : MAX_SEND_SLICES;
+	for (size_t i = 0; i < count; ++i)
+	{
+		setSlice(vecs[i], slices[i]);
+	}
+
+	int result = sendSlices(m_socket, vecs, count);
+	if (result == SOCKET_ERROR)
+	{
+		int err = SOCKET_LAST_ERROR;
+		if (SOCKET_WOULD_BLOCK(err))
+		{
+			return IoStatus::WOULD_BLOCK;
+		}
+
+		LOG(MSG_ERROR, "send of message failed with error: %d", err);
+		return IoStatus::FAILED;
+	}
+
+	written = size_t(result);
+	return IoStatus::OK;
+}
+
+IoStatus SocketTransport::read(char* buf, size_t nbytes, size_t& received)
+{
+	received = 0;
+	if (!m_connected)
+	{
+		LOG(MSG_ERROR, "Trying to receive message from disconnected server");
+		return IoStatus::FAILED;
+	}
+
+	int n = ::recv(m_socket, buf, int(nbytes), 0);
+	if (n == 0)
+	{
+		return IoStatus::CLOSED;
+	}
+
+	if (n < 0)
+	{
+		int err = SOCKET_LAST_ERROR;
+		if (SOCKET_WOULD_BLOCK(err))
+		{
+			return IoStatus::WOULD_BLOCK;
+		}
+
+		LOG(MSG_ERROR, "SOCKET_ERROR while receiving message: %d", err);
+		return IoStatus::FAILED;
+	}
+
+	received = size_t(n);
+	return IoStatus::OK;
+}
+
+bool SocketTransport::wait(uint events, int timeoutMs)
+{
+	if (m_socket == INVALID_NATIVE_SOCKET)
+	{
+		return false;
+	}
+
+	pollfd_t fd = {};
+	fd.fd = decltype(fd.fd)(m_socket);
+	fd.events = ((events & IO_READ) ? POLLIN : 0) | ((events & IO_WRITE) ? POLLOUT : 0);
+
+	int n = pollSockets(&fd, 1, timeoutMs);
+	if (n <= 0)
+	{
+		return false;
+	}
+
+	// error and hang up states are reported to the caller by the next read/write
+	return true;
+}
+
+NativeSocket SocketTransport::handle() const
+{
+	return m_socket;
+}
+
+void SocketTransport::closeSocket()
+{
+	if (m_socket != INVALID_NATIVE_SOCKET)
+	{
+		closeNative(m_socket);
+		m_socket = INVALID_NATIVE_SOCKET;
+	}
+	m_connected = false;
+}
+
+bool SocketTransport::createSocket()
+{
+	if (!m_initialized)
+	{
+		LOG(MSG_ERROR, "Trying to create a socket with uninitialized socket layer");
+		return false;
+	}
+
+	/*---Open socket for streaming---*/
+	NativeSocket s = NativeSocket(socket(AF_INET, SOCK_STREAM, 0));
+	if (s == INVALID_NATIVE_SOCKET)
+	{
+		LOG(MSG_ERROR, "socket function failed with error: %d", SOCKET_LAST_ERROR);
+		return false;
+	}
+
+	if (!setNonBlocking(s))
+	{
+		LOG(MSG_ERROR, "Cannot switch socket to non-blocking mode: %d", SOCKET_LAST_ERROR);
+		closeNative(s);
+		return false;
+	}
+
+	setsockopt(s, SOL_SOCKET, SO_RCVBUF, (const char*)&RECEIVE_BUFFER_SIZE, sizeof(RECEIVE_BUFFER_SIZE));
+
+	m_socket = s;
+	return true;
+}
+
+bool SocketTransport::initAddr(const char* servername, uint16_t portNumber, sockaddr_in& addr) const
+{
+	struct addrinfo hints = {};
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+
+	struct addrinfo* pAddrInfoLListItem = NULL;
+	if (0 != ::getaddrinfo(servername, NULL, &hints, &pAddrInfoLListItem))
+	{
+		LOG(MSG_ERROR, "Could not resolve server name: \"%s\"", servername);
+		return false;
+	}
+
+	::memcpy(&addr, pAddrInfoLListItem->ai_addr, sizeof(sockaddr_in));
+	::freeaddrinfo(pAddrInfoLListItem);
+
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(portNumber);
+	return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "transport.h"
+
+
+class SocketTransport : public ITransport
+{
+public:
+	SocketTransport();
+	virtual ~SocketTransport();
+	SocketTransport(const SocketTransport&) = delete;
+	SocketTransport& operator=(const SocketTransport&) = delete;
+
+	bool init() override;
+	void reset() override;
+	bool connect(const char* servername, uint16_t portNumber) override;
+	bool isConnected() const override;
+
+	IoStatus write(const char* buf, size_t nbytes, size_t& written) override;
+	IoStatus writev(const IoSlice* slices, size_t count, size_t& written) override;
+	IoStatus read(char* buf, size_t nbytes, size_t& received) override;
+	bool wait(uint events, int timeoutMs) override;
+
+	NativeSocket handle() const override;
+
+private:
+	void closeSocket();
+	bool createSocket();
+	bool initAddr(const char* servername, uint16_t portNumber, struct sockaddr_in& addr) const;
+
+private:
+	NativeSocket	m_socket;
+	bool			m_initialized;
+	bool			m_connected;
+};
@@ -1,19 +1,50 @@
 #include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <future>
+#include <thread>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 #include "space.h"
 #include "json_query_builder.h"
-#include "connection_manager.h"
 #include "log_interface.h"
 #include "space_renderer.h"
 #include "math\vector3.h"
 #include "space_ui.h"
-#include <thread>
 
 
 using Vector3 = Vector3;
 
+const uint DEFAULT_PREFETCH_DEPTH = 8;
+const char* DEFAULT_MAP_CACHE_DIR = "map_cache";
+// items of a map array decoded by one thread at least
+const size_t MIN_PARALLEL_CHUNK = 4096;
+// members read from every item of the map arrays
+const Json::Key IDX_KEY("idx");
+const Json::Key LENGTH_KEY("length");
+const Json::Key POINTS_KEY("points");
+const Json::Key POST_IDX_KEY("post_idx");
+const Json::Key X_KEY("x");
+const Json::Key Y_KEY("y");
+
 Space::Space()
 	: m_staticLayerLoaded(false)
+	, m_mapCacheDir(DEFAULT_MAP_CACHE_DIR)
+	, m_prefetchDepth(DEFAULT_PREFETCH_DEPTH)
+	, m_maxTurn(-1)
+	, m_accountedTurn(-1)
+	, m_loader(
+		  [this](AsyncConnection& connection, int turn, PendingTurn& pending) {
+			  requestDynamicLayer(connection, turn, pending);
+		  },
+		  [this](AsyncConnection& connection, PendingTurn& pending) { completeDynamicLayer(connection, pending); })
 {
+	auto empty = std::make_shared<const DynamicLayer>();
+	m_displayed = std::make_shared<const DisplayedTurns>(DisplayedTurns{empty, empty});
+	m_loader.setMaxInFlight(m_prefetchDepth);
 }
 
 
@@ -21,456 +52,686 @@ Space::~Space()
 {
 }
 
-std::shared_ptr<JSONQueryReader> getLayer(const ConnectionManager& connect, SpaceLayer layerId)
+ResponseFuture requestLayer(AsyncConnection& connection, SpaceLayer layerId)
 {
 	JSONQueryWriter writer;
-	writer.add("layer", layerId); // STATIC layer
+	writer.add("layer", layerId);
+	return connection.request(Action::MAP, writer.str());
+}
 
-	if (!connect.sendMessage(Action::MAP, true, &writer.str()))
+bool receiveLayer(ResponseFuture& future, Response& response)
+{
+	response = future.get();
+	if (response.result != Result::OKEY)
 	{
-		LOG(MSG_ERROR, "Failed to create space. Reason: send MAP message failed");
-		return nullptr;
+		LOG(MSG_ERROR, "Failed to create space. Reason: receive MAP message failed: %s", response.body.c_str());
+		return false;
 	}
+	return true;
+}
+
+bool parseLayer(AsyncConnection& connection, const Response& response, SpaceLayer layerId, JSONDocument& document)
+{
+	uint64_t parseStart = NetworkStats::now();
+	bool	 parsed = document.parse(response.body.data(), response.body.end());
+	connection.connection().stats().parse(
+		layerId == SpaceLayer::COORDINATES ? StatsCategory::MAP_COORDINATES : StatsCategory::MAP_STATIC,
+		NetworkStats::now() - parseStart);
+	return parsed;
+}
 
-	std::string msg;
-	if (connect.receiveMessage(msg) != Result::OKEY)
+// Runs f(first, last) over chunks of [0, count) on a few threads, false if any chunk failed.
+// Small arrays are done in place, threads do not pay off on them.
+template <typename F>
+bool parallelChunks(size_t count, F f)
+{
+	size_t threads = std::thread::hardware_concurrency();
+	size_t chunks = (count + MIN_PARALLEL_CHUNK - 1) / MIN_PARALLEL_CHUNK;
+	chunks = chunks < threads ? chunks : threads;
+	if (chunks <= 1)
 	{
-		LOG(MSG_ERROR, "Failed to create space. Reason: receive MAP message failed: %s", msg.c_str());
-		return nullptr;
+		return f(size_t(0), count);
 	}
 
-	return std::make_shared<JSONQueryReader>(msg);
+	size_t						   step = (count + chunks - 1) / chunks;
+	std::vector<std::future<bool>> parts;
+	for (size_t first = step; first < count; first += step)
+	{
+		parts.push_back(std::async(std::launch::async, f, first, first + step < count ? first + step : count));
+	}
+
+	bool result = f(size_t(0), step);
+	for (auto& part : parts)
+	{
+		result = part.get() && result;
+	}
+	return result;
+}
+
+bool makeDirectory(const std::string& path)
+{
+#ifdef _WIN32
+	return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+#else
+	return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
 }
 
-bool Space::initStaticLayer(const ConnectionManager& manager)
+bool Space::initStaticLayer(AsyncConnection& connection)
 {
 	if (m_staticLayerLoaded)
 		return true;
 
-	auto reader = getLayer(manager, SpaceLayer::STATIC);
+	// both layers are on the wire while the first one is decoded
+	ResponseFuture staticLayer = requestLayer(connection, SpaceLayer::STATIC);
+	ResponseFuture coordinatesLayer = requestLayer(connection, SpaceLayer::COORDINATES);
 
-	if (reader && reader->isValid())
+	Response staticResponse;
+	if (!receiveLayer(staticLayer, staticResponse))
+		return false;
+
+	// a map compiled from the same layers before is mapped instead of being parsed and compiled
+	uint64_t	staticHash = StaticMap::hash(staticResponse.body.data(), staticResponse.body.end());
+	std::string cachePath = mapCachePath(staticHash);
+	bool		cached = !cachePath.empty() && m_map.load(cachePath.c_str()) && m_map.staticHash() == staticHash;
+
+	// coordinates are received and decoded on their own thread while the static layer is decoded here,
+	// the two decoders fill separate sources which are merged once both are done
+	Response		coordinatesResponse;
+	StaticMapSource geometry;
+	uint64_t		coordinatesHash = 0;
+	auto			coordinates = std::async(std::launch::async, [&] {
+		   if (!receiveLayer(coordinatesLayer, coordinatesResponse))
+			   return false;
+
+		   coordinatesHash = StaticMap::hash(coordinatesResponse.body.data(), coordinatesResponse.body.end());
+		   bool needed = !cached || m_map.coordinatesHash() != coordinatesHash;
+		   return !needed || parseCoordinatesLayer(connection, coordinatesResponse, geometry);
+	   });
+
+	StaticMapSource source;
+	bool			staticParsed = cached || parseStaticLayer(connection, staticResponse, source);
+	if (!coordinates.get() || !staticParsed)
+		return false;
+
+	if (cached && m_map.coordinatesHash() != coordinatesHash)
 	{
-		m_idx = reader->get<uint>("idx");
-		m_name = reader->get<std::string>("name");
+		LOG(MSG_NORMAL, "Map cache %s is outdated", cachePath.c_str());
+		cached = false;
+		if (!parseStaticLayer(connection, staticResponse, source))
+			return false;
+	}
 
-		if (!loadLines(*reader))
+	if (!cached)
+	{
+		// the layers come in separate messages, a map changed between them cannot be combined
+		if (geometry.idx != source.idx || geometry.coordinates.size() != source.points.size())
 		{
-			LOG(MSG_ERROR, "Failed to create static layer on space. Reason: cannot load lines.");
+			LOG(MSG_ERROR, "Failed to create static layer on space. Reason: coordinates do not match the map.");
 			return false;
 		}
-
-		if (!loadPoints(*reader))
+		source.coordinates = std::move(geometry.coordinates);
+		source.width = geometry.width;
+		source.height = geometry.height;
+		source.staticHash = staticHash;
+		source.coordinatesHash = coordinatesHash;
+		if (!m_map.compile(source))
 		{
-			LOG(MSG_ERROR, "Failed to create static layer on space. Reason: cannot load points.");
+			LOG(MSG_ERROR, "Failed to create static layer on space. Reason: inconsistent map.");
 			return false;
 		}
+
+		// the map is usable without the cache, a failed save only costs the next start
+		if (!cachePath.empty() && makeDirectory(m_mapCacheDir))
+		{
+			m_map.save(cachePath.c_str());
+		}
 	}
-	else
+
+	m_spatial.build(m_map);
+
+	m_staticLayerLoaded = true;
+	LOG(MSG_NORMAL, "Static space layer created%s. Points: %d. Lines: %d", cached ? " from cache" : "",
+		m_map.points().size(), m_map.lines().size());
+	return true;
+}
+
+bool Space::parseStaticLayer(AsyncConnection& connection, const Response& response, StaticMapSource& source) const
+{
+	JSONDocument document;
+	if (!parseLayer(connection, response, SpaceLayer::STATIC, document))
 	{
 		LOG(MSG_ERROR, "Failed to create static layer on space. Reason: parcing MAP message failed");
 		return false;
 	}
 
-	// read geometry coordinates of points
-	reader = getLayer(manager, SpaceLayer::COORDINATES);
+	JSONQueryReader reader = document.root();
+	source.idx = reader.get<uint>("idx");
+	source.name = reader.get<std::string>("name");
 
-	if (reader && reader->isValid())
+	if (!loadLines(reader, source))
 	{
-		assert(m_idx == reader->get<uint>("idx"));
+		LOG(MSG_ERROR, "Failed to create static layer on space. Reason: cannot load lines.");
+		return false;
+	}
 
-		if (!loadCoordinates(*reader))
-		{
-			LOG(MSG_ERROR, "Failed to create static layer on space. Reason: cannot load coordinates.");
-			return false;
-		}
+	if (!loadPoints(reader, source))
+	{
+		LOG(MSG_ERROR, "Failed to create static layer on space. Reason: cannot load points.");
+		return false;
 	}
-	else
+	return true;
+}
+
+bool Space::parseCoordinatesLayer(AsyncConnection& connection, const Response& response, StaticMapSource& source) const
+{
+	// read geometry coordinates of points
+	JSONDocument document;
+	if (!parseLayer(connection, response, SpaceLayer::COORDINATES, document))
 	{
 		LOG(MSG_ERROR, "Failed to create static layer on space. Reason: parcing MAP message with coordinates failed");
 		return false;
 	}
 
-	postCreateStaticLayer();
+	JSONQueryReader reader = document.root();
+	source.idx = reader.get<uint>("idx");
 
-	m_staticLayerLoaded = true;
-	LOG(MSG_NORMAL, "Static space layer created. Points: %d. Lines: %d", m_points.size(), m_lines.size());
+	if (!loadCoordinates(reader, source))
+	{
+		LOG(MSG_ERROR, "Failed to create static layer on space. Reason: cannot load coordinates.");
+		return false;
+	}
 	return true;
 }
 
-bool Space::loadDynamicLayer(const ConnectionManager& manager, int turn, DynamicLayer& layer) const
+std::string Space::mapCachePath(uint64_t staticHash) const
 {
-	SimpleMutexHolder holder(m_dynamicMutex);
-	JSONQueryWriter   writer;
-	writer.add("idx", turn);
-	if (!manager.sendMessage(Action::TURN, false, &writer.str()))
+	if (m_mapCacheDir.empty())
 	{
-		return false;
+		return std::string();
 	}
 
-	auto reader = getLayer(manager, SpaceLayer::DYNAMIC);
+	char name[32];
+	snprintf(name, sizeof(name), "map_%016llx.bin", (unsigned long long)staticHash);
+	return m_mapCacheDir + "/" + name;
+}
+
+void Space::setPrefetchDepth(uint depth)
+{
+	m_prefetchDepth = depth;
+	// the whole prefetch window may be on the wire, as far as the connection window allows
+	m_loader.setMaxInFlight(depth);
+}
+
+void Space::setMaxTurn(int turn)
+{
+	m_maxTurn = turn;
+}
+
+void Space::requestDynamicLayer(AsyncConnection& connection, int turn, PendingTurn& pending) const
+{
+	JSONQueryWriter writer;
+	writer.add("idx", turn);
+	std::string turnMsg = writer.str();
+	writer.add("layer", SpaceLayer::DYNAMIC);
+	std::string mapMsg = writer.str();
+
+	RequestOptions options;
+	options.cancel = std::make_shared<std::atomic<bool>>(false);
+
+	std::vector<AsyncRequest> requests = {{Action::TURN, turnMsg}, {Action::MAP, mapMsg}};
+	std::vector<ResponseFuture> responses = connection.request(std::move(requests), options);
+
+	pending.turn = turn;
+	pending.turnResponse = std::move(responses[0]);
+	pending.mapResponse = std::move(responses[1]);
+	pending.cancel = options.cancel;
+}
+
+bool Space::receiveDynamicLayer(AsyncConnection& connection, PendingTurn& pending, DynamicLayer& layer) const
+{
+	// the MAP body stays in the pooled receive buffer and is parsed right there
+	Result	 turnResult = pending.turnResponse.get().result;
+	Response map = pending.mapResponse.get();
 
 	layer.trains.clear();
 	layer.posts.clear();
+	layer.players.clear();
+	layer.turn = pending.turn;
 
-	if (reader && reader->isValid())
+	// a broken connection is repaired by the reconnect policy, the turn is asked for again
+	if (ConnectionManager::isConnectionLost(turnResult) || ConnectionManager::isConnectionLost(map.result) ||
+		map.result == Result::REQUEST_CANCELLED)
 	{
-		if (!loadTrains(*reader, layer))
-		{
-			LOG(MSG_ERROR, "Failed to create dynamic layer on space. Reason: cannot load trains.");
-			return false;
-		}
+		return false;
+	}
 
-		if (!loadPosts(*reader, layer))
-		{
-			LOG(MSG_ERROR, "Failed to create dynamic layer on space. Reason: cannot load posts.");
-			return false;
-		}
+	// a refused turn is not stored, in a live game the server may have it by the next request
+	if (turnResult != Result::OKEY)
+	{
+		LOG(MSG_ERROR, "Failed to create dynamic layer on space. Reason: TURN %d failed", pending.turn);
+		return false;
+	}
 
-		if (!loadPlayers(*reader, layer))
-		{
-			LOG(MSG_ERROR, "Failed to create dynamic layer on space. Reason: cannot load players.");
-			return false;
-		}
+	if (map.result != Result::OKEY)
+	{
+		LOG(MSG_ERROR, "Failed to create dynamic layer on space. Reason: receive MAP message failed: %s", map.body.c_str());
+		return false;
 	}
-	else
+
+	uint64_t parseStart = NetworkStats::now();
+	bool	 parsed = parseDynamicLayer(map.body.data(), map.body.end(), layer);
+	connection.connection().stats().parse(StatsCategory::MAP_DYNAMIC, NetworkStats::now() - parseStart);
+
+	// records are filled while the body is scanned, a broken body leaves the layer half filled
+	// and must not get into the history
+	return parsed;
+}
+
+bool Space::parseDynamicLayer(const char* begin, const char* end, DynamicLayer& layer) const
+{
+	// records are filled while the message is scanned, no document tree is built
+	auto intern = [this](StringId& id, const char* first, const char* last) { id = m_strings.intern(first, last); };
+
+	JSONRecordBinding<Train> trains([&layer](const Train& train) { layer.trains.insert(std::make_pair(train.idx, train)); });
+	trains.field("idx", &Train::idx)
+		.field("line_idx", &Train::line_idx)
+		.field("position", &Train::position)
+		.field("cooldown", &Train::cooldown)
+		.field("goods", &Train::goods)
+		.field("goods_capacity", &Train::goods_capacity)
+		.field("speed", &Train::speed)
+		.field("level", &Train::level)
+		.field("player_idx", [&](Train& train, const char* first, const char* last) { intern(train.player_id, first, last); });
+
+	JSONRecordBinding<Post> posts([&layer](const Post& post) { layer.posts.insert(std::make_pair(post.idx, post)); });
+	posts.field("idx", &Post::idx)
+		.field("armor", &Post::armor)
+		.field("armor_capacity", &Post::armor_capacity)
+		.field("level", &Post::level)
+		.field("population", &Post::population)
+		.field("population_capacity", &Post::population_capacity)
+		.field("product", &Post::product)
+		.field("product_capacity", &Post::product_capacity)
+		.field("type", &Post::type)
+		.field("name", [&](Post& post, const char* first, const char* last) { intern(post.name, first, last); })
+		.field("player_idx", [&](Post& post, const char* first, const char* last) { intern(post.player_id, first, last); });
+
+	JSONRecordBinding<Player> players(
+		[&layer](const Player& player) { layer.players.emplace(std::make_pair(player.id, player)); });
+	players.field("idx", [&](Player& player, const char* first, const char* last) { intern(player.id, first, last); })
+		.field("name", [&](Player& player, const char* first, const char* last) { intern(player.name, first, last); })
+		.field("rating", &Player::rating);
+
+	JSONRecordReader reader;
+	reader.bind("trains", trains);
+	reader.bind("posts", posts);
+	reader.bind("ratings", players);
+
+	layer.players.clear();
+	if (!reader.parse(begin, end))
 	{
-		LOG(MSG_ERROR, "Failed to create dynamic layer on  space. Reason: parcing MAP message failed");
+		LOG(MSG_ERROR, "Failed to create dynamic layer on  space. Reason: parcing MAP message failed: %s", reader.error().c_str());
+		return false;
+	}
+
+	if (layer.posts.empty())
+	{
+		LOG(MSG_ERROR, "Failed to create dynamic layer on space. Reason: cannot load posts.");
 		return false;
 	}
 
 	return true;
 }
 
-const SpacePoint* Space::findPoint(uint idx) const
+size_t DynamicLayer::memoryUsage() const
 {
-	for (const auto& p : m_points)
+	// every hash or tree node carries a few pointers besides the value
+	const size_t NODE_OVERHEAD = 3 * sizeof(void*);
+
+	size_t bytes = sizeof(*this) + (trains.bucket_count() + posts.bucket_count()) * sizeof(void*);
+	// strings are shared through the pool of the space
+	bytes += (trains.size() + posts.size() + players.size()) * NODE_OVERHEAD;
+	bytes += trains.size() * sizeof(*trains.begin()) + posts.size() * sizeof(*posts.begin()) +
+			 players.size() * sizeof(*players.begin());
+	return bytes;
+}
+
+bool Space::storeDynamicLayer(int turn, const char* begin, const char* end)
+{
+	DynamicLayer layer;
+	if (!parseDynamicLayer(begin, end, layer))
 	{
-		if (p.second.post_id == idx)
-		{
-			return &p.second;
-		}
+		return false;
 	}
+	layer.turn = turn;
 
-	return nullptr;
+	m_history.put(layer);
+	return true;
 }
 
-
-bool Space::updateDynamicLayer(const ConnectionManager& manager, float turn)
+void Space::clearStoredLayers()
 {
-	int curTurn = (int)ceilf(turn);
-	int prevTurn = (int)floorf(turn);
+	m_history.clear();
+	m_cache.clear();
+}
 
-	if (m_curDynamicLayer.turn == curTurn && m_prevDynamicLayer.turn == prevTurn)
+TurnCache::LayerPtr Space::findLayer(int turn, bool countAccess)
+{
+	if (m_displayed->cur->turn == turn)
 	{
-		return true;
+		return m_displayed->cur;
 	}
 
-	bool success = true;
-	if (m_curDynamicLayer.turn == prevTurn)
+	if (m_displayed->prev->turn == turn)
 	{
-		m_prevDynamicLayer = m_curDynamicLayer;
+		return m_displayed->prev;
 	}
-	else
+
+	TurnCache::LayerPtr cached = countAccess ? m_cache.get(turn) : m_cache.peek(turn);
+	if (cached)
 	{
-		// this should not happen during play
-		success &= loadDynamicLayer(manager, prevTurn, m_prevDynamicLayer);
+		return cached;
 	}
 
-	while (!m_nextDynamicLayer.ready)
+	// restoring a turn from the history replays its keyframe block, the result is worth caching
+	auto layer = std::make_shared<DynamicLayer>();
+	if (!m_history.get(turn, *layer))
 	{
-		Sleep(1);
+		return nullptr;
 	}
 
-	if (curTurn == m_nextDynamicLayer.turn)
+	m_cache.put(turn, layer);
+	return layer;
+}
+
+void Space::completeDynamicLayer(AsyncConnection& connection, PendingTurn& pending)
+{
+	// a turn which failed is asked for again by the next schedulePrefetch
+	auto layer = std::make_shared<DynamicLayer>();
+	if (receiveDynamicLayer(connection, pending, *layer))
 	{
-		SimpleMutexHolder holder(m_dynamicMutex);
-		m_curDynamicLayer = m_nextDynamicLayer;
+		m_history.put(*layer);
+		m_cache.put(pending.turn, layer);
 	}
-	else
+}
+
+void Space::schedulePrefetch(AsyncConnection& connection, int prevTurn, int curTurn)
+{
+	// turns past the end of the game would only be refused
+	int lastTurn = curTurn + int(m_prefetchDepth);
+	if (m_maxTurn >= 0 && lastTurn > m_maxTurn)
 	{
-		// this should not happen during play
-		success &= loadDynamicLayer(manager, curTurn, m_curDynamicLayer);
+		lastTurn = m_maxTurn < curTurn ? curTurn : m_maxTurn;
 	}
 
-	//queue load of next turn
-	if (curTurn + 1 != m_nextDynamicLayer.turn)
+	// a seek cancels the turns which left the window
+	m_loader.retain(prevTurn, lastTurn);
+
+	for (int t = prevTurn; t <= lastTurn; ++t)
 	{
-		m_nextDynamicLayer.ready = false;
-		std::thread([this, curTurn, &manager] 
+		if (m_displayed->cur->turn != t && m_displayed->prev->turn != t && !m_cache.contains(t) &&
+			!m_history.contains(t))
 		{
-			loadDynamicLayer(manager, curTurn + 1, m_nextDynamicLayer);
-			{
-				SimpleMutexHolder holder(m_dynamicMutex);
-				m_nextDynamicLayer.turn = curTurn + 1;
-				m_nextDynamicLayer.ready = true;
-			}
-		}).detach();
+			bool shown = t == prevTurn || t == curTurn;
+			m_loader.load(connection, t, shown ? TurnLoader::DISPLAY : TurnLoader::PREFETCH);
+		}
 	}
-
-	m_prevDynamicLayer.turn = prevTurn;
-	m_curDynamicLayer.turn = curTurn;
-
-	return success;
 }
 
-Vector3 coordToVector3(const Coords& c)
+bool Space::updateDynamicLayer(AsyncConnection& connection, float turn)
 {
-	return Vector3(float(c.x), 0.0f, float(c.y));
+	int curTurn = (int)ceilf(turn);
+	int prevTurn = (int)floorf(turn);
+
+	if (m_displayed->cur->turn == curTurn && m_displayed->prev->turn == prevTurn)
+	{
+		return true;
+	}
+
+	// cache hits and misses are accounted once per displayed turn, not for every frame waiting for it
+	bool countAccess = m_accountedTurn != curTurn;
+	m_accountedTurn = curTurn;
+
+	TurnCache::LayerPtr curLayer = findLayer(curTurn, countAccess);
+	TurnCache::LayerPtr prevLayer = curLayer ? findLayer(prevTurn, countAccess) : nullptr;
+	schedulePrefetch(connection, prevTurn, curTurn);
+
+	if (curLayer && prevLayer)
+	{
+		std::atomic_store(&m_displayed, std::make_shared<const DisplayedTurns>(DisplayedTurns{prevLayer, curLayer}));
+		buildTrainFrame();
+	}
+
+	return true;
 }
 
 void Space::addStaticSceneToRender(SpaceRenderer& renderer)
 {
-	renderer.setupStaticScene(m_size.x, m_size.y);
+	renderer.setupStaticScene(m_map.width(), m_map.height());
 
-	for (const auto& p : m_lines)
+	for (const auto& line : m_map.lines())
 	{
-		const Line& line = p.second;
+		renderer.createRailModel(Vector3(line.x1, 0.0f, line.z1), Vector3(line.x2, 0.0f, line.z2));
+	}
+}
 
-		renderer.createRailModel(coordToVector3(line.pt_1->pos), coordToVector3(line.pt_2->pos));
+bool Space::getWorldTrainCoords(const Train& t, Vector3& position, Vector3& dir) const
+{
+	const StaticMap::Line* line = m_map.findLine(t.line_idx);
+	if (!line)
+	{
+		return false;
 	}
+
+	float x, z;
+	StaticMap::position(*line, t.position, x, z);
+	position = Vector3(x, 0.0f, z);
+
+	float sign = t.speed < 0 ? -1.0f : 1.0f;
+	dir = Vector3(line->dirX * sign, 0.0f, line->dirZ * sign);
+	return true;
 }
 
-void Space::getWorldTrainCoords(const Train& t, Vector3& position, Vector3& dir)
+void TrainFrame::clear()
 {
-	const Line& line = m_lines.at(t.line_idx);
-	float		deltaPos = float(t.position) / float(line.length);
+	resize(0);
+}
 
-	Vector3 p1(float(line.pt_1->pos.x), 0.0f, float(line.pt_1->pos.y));
-	Vector3 p2(float(line.pt_2->pos.x), 0.0f, float(line.pt_2->pos.y));
+void TrainFrame::resize(size_t count)
+{
+	trains.resize(count);
+	owners.resize(count);
+	prevX.resize(count);
+	prevZ.resize(count);
+	curX.resize(count);
+	curZ.resize(count);
+	dirX.resize(count);
+	dirZ.resize(count);
+	x.resize(count);
+	z.resize(count);
+}
 
-	dir = p2 - p1;
-	position = p1 + dir * deltaPos;
-	dir.Normalize();
-	if (t.speed < 0)
+void TrainFrame::interpolate(float interpolator)
+{
+	// plain loops over contiguous floats, the compiler vectorizes them
+	size_t		 count = size();
+	const float* px = prevX.data();
+	const float* pz = prevZ.data();
+	const float* cx = curX.data();
+	const float* cz = curZ.data();
+	float*		 ox = x.data();
+	float*		 oz = z.data();
+
+	for (size_t i = 0; i < count; ++i)
 	{
-		dir *= -1.0f;
+		ox[i] = px[i] + (cx[i] - px[i]) * interpolator;
+	}
+	for (size_t i = 0; i < count; ++i)
+	{
+		oz[i] = pz[i] + (cz[i] - pz[i]) * interpolator;
 	}
 }
 
-void Space::addDynamicSceneToRender(SpaceRenderer& renderer, float interpolator)
+void Space::buildTrainFrame()
 {
-	renderer.clearDynamics();
+	const DynamicLayer& curLayer = *m_displayed->cur;
+	const DynamicLayer& prevLayer = *m_displayed->prev;
+	m_trainFrame.resize(curLayer.trains.size());
 
-	for (const auto& train : m_curDynamicLayer.trains)
+	size_t i = 0;
+	for (const auto& train : curLayer.trains)
 	{
 		const Train& t = train.second;
 		Vector3		 pos, dir;
-		getWorldTrainCoords(t, pos, dir);
-
-		auto it = m_prevDynamicLayer.trains.find(t.idx);
-		if (it != m_prevDynamicLayer.trains.end())
+		if (!getWorldTrainCoords(t, pos, dir))
 		{
-			Vector3 pos2, dir2;
-			getWorldTrainCoords(it->second, pos2, dir2);
+			LOG(MSG_ERROR, "Train %u stands on unknown line %u", t.idx, t.line_idx);
+			continue;
+		}
 
-			if (!pos2.almostEqual(pos))
+		// a train without the previous turn stands at its current position
+		Vector3 prevPos = pos;
+		Vector3 prevDir;
+		auto	it = prevLayer.trains.find(t.idx);
+		if (it != prevLayer.trains.end() && getWorldTrainCoords(it->second, prevPos, prevDir))
+		{
+			if (!prevPos.almostEqual(pos))
 			{
-				dir = pos - pos2;
+				dir = pos - prevPos;
 				dir.Normalize();
 			}
-
-			pos = pos * interpolator + pos2 * (1.0f - interpolator);
 		}
 
-		auto itp = m_curDynamicLayer.players.find(train.second.player_id);
-		SpaceUI::createTrainUI(pos, train.second, itp != m_curDynamicLayer.players.end() ? &itp->second.name : nullptr);
-		renderer.setTrain(pos, dir, t.idx);
+		auto itp = curLayer.players.find(t.player_id);
+		m_trainFrame.trains[i] = &t;
+		m_trainFrame.owners[i] = itp != curLayer.players.end() ? &m_strings.str(itp->second.name) : nullptr;
+		m_trainFrame.prevX[i] = prevPos.x;
+		m_trainFrame.prevZ[i] = prevPos.z;
+		m_trainFrame.curX[i] = pos.x;
+		m_trainFrame.curZ[i] = pos.z;
+		m_trainFrame.dirX[i] = dir.x;
+		m_trainFrame.dirZ[i] = dir.z;
+		++i;
+	}
+	m_trainFrame.resize(i);
+	m_spatial.setTrains(m_trainFrame);
+}
+
+void Space::addDynamicSceneToRender(SpaceRenderer& renderer, float interpolator)
+{
+	renderer.clearDynamics();
+
+	m_trainFrame.interpolate(interpolator);
+	for (size_t i = 0; i < m_trainFrame.size(); ++i)
+	{
+		Vector3 pos(m_trainFrame.x[i], 0.0f, m_trainFrame.z[i]);
+		Vector3 dir(m_trainFrame.dirX[i], 0.0f, m_trainFrame.dirZ[i]);
+
+		SpaceUI::createTrainUI(pos, *m_trainFrame.trains[i], m_trainFrame.owners[i]);
+		renderer.setTrain(pos, dir, m_trainFrame.trains[i]->idx);
 	}
 
-	for (const auto& p : m_curDynamicLayer.posts)
+	const DynamicLayer& curLayer = *m_displayed->cur;
+	for (const auto& p : curLayer.posts)
 	{
 		auto			  idx = p.second.idx;
-		const SpacePoint* point = findPoint(idx);
+		const StaticMap::Point* point = m_map.findPostPoint(idx);
 
 		if (point)
 		{
-			Vector3 worldPos(coordToVector3(point->pos));
-			auto	it = m_curDynamicLayer.players.find(p.second.player_id);
-			SpaceUI::createPostUI(
-				worldPos, p.second, it != m_curDynamicLayer.players.end() ? &it->second.name : nullptr);
+			Vector3 worldPos(point->x, 0.0f, point->z);
+			auto	it = curLayer.players.find(p.second.player_id);
+			SpaceUI::createPostUI(worldPos,
+				p.second,
+				m_strings.str(p.second.name),
+				it != curLayer.players.end() ? &m_strings.str(it->second.name) : nullptr);
 			renderer.createCityPoint(worldPos, p.second.type);
 		}
 	}
 
-	SpaceUI::createPlayerUI(m_curDynamicLayer.players);
+	SpaceUI::createPlayerUI(curLayer.players, m_strings);
 }
 
-bool Space::loadLines(const JSONQueryReader& reader)
+bool Space::loadLines(const JSONQueryReader& reader, StaticMapSource& source) const
 {
 	auto values = reader.getValue("lines").asArray();
 	if (values.size() > 0)
 	{
-		m_lines.reserve(values.size());
-		for (const auto& value : values)
-		{
-			uint idx = value.get<uint>("idx");
-			uint length = value.get<uint>("length");
-			auto points = value.getValue("points").asArray();
-			uint pid_1, pid_2;
-
-			if (points.size() == 2)
-			{
-				pid_1 = points[0].get<uint>();
-				pid_2 = points[1].get<uint>();
-			}
-			else
+		source.lines.resize(values.size());
+		return parallelChunks(values.size(), [&](size_t first, size_t last) {
+			for (size_t i = first; i < last; ++i)
 			{
-				LOG(MSG_ERROR, "Incorrect format of line!\n");
-				return false;
+				JSONQueryReader value = values[i];
+				uint		idx = value.get<uint>(IDX_KEY);
+				uint		length = value.get<uint>(LENGTH_KEY);
+				auto		points = value.getValue(POINTS_KEY).asArray();
+				uint		pid_1, pid_2;
+
+				if (points.size() == 2)
+				{
+					pid_1 = points[0].get<uint>();
+					pid_2 = points[1].get<uint>();
+				}
+				else
+				{
+					LOG(MSG_ERROR, "Incorrect format of line!\n");
+					return false;
+				}
+
+				source.lines[i] = StaticMapSource::Line{idx, length, pid_1, pid_2};
 			}
-
-			m_lines.insert(std::make_pair(idx, Line(idx, length, pid_1, pid_2)));
-		}
-		return true;
+			return true;
+		});
 	}
 
 	return false;
 }
 
-bool Space::loadPoints(const JSONQueryReader& reader)
+bool Space::loadPoints(const JSONQueryReader& reader, StaticMapSource& source) const
 {
 	auto values = reader.getValue("points").asArray();
 	if (values.size() > 0)
 	{
-		m_points.reserve(values.size());
-		for (const auto& value : values)
-		{
-			uint idx = value.get<uint>("idx");
-			uint post_id = value.get<uint>("post_idx");
-			m_points.insert(std::make_pair(idx, SpacePoint(idx, post_id)));
-		}
-		return true;
-	}
-
-	return false;
-}
-
-bool Space::loadPlayers(const JSONQueryReader& reader, DynamicLayer& layer) const
-{
-	layer.players.clear();
-	auto values = reader.getValue("ratings").asArray();
-	if (values.size() > 0)
-	{
-		// layer.players.reserve(values.size());
-		for (const auto& value : values)
-		{
-			std::string id = value.get<std::string>("idx");
-			std::string name = value.get<std::string>("name");
-			uint		rating = value.get<uint>("rating");
-			layer.players.emplace(std::make_pair(id, Player(id, name, rating)));
-		}
-		return true;
-	}
-
-	return true;
-}
-
-bool Space::loadTrains(const JSONQueryReader& reader, DynamicLayer& layer) const
-{
-	auto values = reader.getValue("trains").asArray();
-	if (values.size() > 0)
-	{
-		layer.trains.reserve(values.size());
-		for (const auto& value : values)
-		{
-			Train train;
-			train.idx = value.get<uint>("idx");
-			train.line_idx = value.get<uint>("line_idx");
-			train.position = value.get<uint>("position");
-			train.cooldown = value.get<uint>("cooldown");
-			train.goods = value.get<uint>("goods");
-			train.goods_capacity = value.get<uint>("goods_capacity");
-			train.speed = value.get<int>("speed");
-			train.level = value.get<int>("level");
-			train.player_id = value.get<std::string>("player_idx");
-			layer.trains.insert(std::make_pair(train.idx, train));
-		}
-		return true;
-	}
-
-	return true;
-}
-
-bool Space::loadPosts(const JSONQueryReader& reader, DynamicLayer& layer) const
-{
-	auto values = reader.getValue("posts").asArray();
-	if (values.size() > 0)
-	{
-		layer.posts.reserve(values.size());
-		for (const auto& value : values)
-		{
-			Post post;
-			post.idx = value.get<uint>("idx");
-			post.armor = value.get<uint>("armor");
-			post.armor_capacity = value.get<uint>("armor_capacity");
-			post.level = value.get<uint>("level");
-			post.population = value.get<uint>("population");
-			post.population_capacity = value.get<uint>("population_capacity");
-			post.product = value.get<uint>("product");
-			post.product_capacity = value.get<uint>("product_capacity");
-			post.type = static_cast<EPostType>(value.get<uint>("type"));
-			post.name = value.get<std::string>("name");
-			post.player_id = value.get<std::string>("player_idx");
-			layer.posts.insert(std::make_pair(post.idx, post));
-		}
+		source.points.resize(values.size());
+		parallelChunks(values.size(), [&](size_t first, size_t last) {
+			for (size_t i = first; i < last; ++i)
+			{
+				source.points[i] = StaticMapSource::Point{values[i].get<uint>(IDX_KEY), values[i].get<uint>(POST_IDX_KEY)};
+			}
+			return true;
+		});
 		return true;
 	}
 
 	return false;
 }
 
-bool Space::loadCoordinates(const JSONQueryReader& reader)
+bool Space::loadCoordinates(const JSONQueryReader& reader, StaticMapSource& source) const
 {
 	auto values = reader.getValue("coordinates").asArray();
 	if (values.size() > 0)
 	{
-		assert(values.size() == m_points.size());
-		for (const auto& value : values)
-		{
-			Coords pos;
-			pos.x = value.get<uint>("x");
-			pos.y = value.get<uint>("y");
-			uint idx = value.get<uint>("idx");
-			auto res = m_points.find(idx);
-			if (res == m_points.end())
+		source.coordinates.resize(values.size());
+		parallelChunks(values.size(), [&](size_t first, size_t last) {
+			for (size_t i = first; i < last; ++i)
 			{
-				LOG(MSG_ERROR, "Inconsistent coordinates. Cannot find post with id = %d!", idx);
-				return false;
+				StaticMapSource::Coordinates& coords = source.coordinates[i];
+				JSONQueryReader value = values[i];
+				coords.idx = value.get<uint>(IDX_KEY);
+				coords.x = value.get<uint>(X_KEY);
+				coords.y = value.get<uint>(Y_KEY);
 			}
-
-			res->second.pos = pos;
-		}
+			return true;
+		});
 
 		auto size = reader.getValue("size").asArray();
 		assert(size.size() == 2);
-		m_size.x = size[0].get<uint>();
-		m_size.y = size[1].get<uint>();
+		source.width = size[0].get<uint>();
+		source.height = size[1].get<uint>();
 
 		return true;
 	}
 
 	return false;
 }
-
-void Space::postCreateStaticLayer()
-{
-	for (auto& p : m_lines)
-	{
-		Line& line = p.second;
-		auto  it1 = m_points.find(line.pid_1);
-		auto  it2 = m_points.find(line.pid_2);
-
-		if (it1 == m_points.end() || it2 == m_points.end())
-		{
-			LOG(MSG_ERROR, "Incorrect lines vs points connection!");
-			return;
-		}
-
-		line.pt_1 = &it1->second;
-		line.pt_1->lines.emplace_back(&line);
-
-		line.pt_2 = &it2->second;
-		line.pt_2->lines.emplace_back(&line);
-	}
-}
@@ -1,54 +1,21 @@
 #pragma once
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
 #include <map>
 #include "defs.hpp"
 #include "mutex.h"
+#include "async_connection.h"
+#include "game_history.h"
+#include "spatial_index.h"
+#include "string_pool.h"
+#include "static_map.h"
+#include "turn_cache.h"
+#include "turn_loader.h"
 
-struct Line;
-class ConnectionManager;
 class JSONQueryReader;
 
-struct Coords
-{
-	uint x = 0;
-	uint y = 0;
-};
-
-struct SpacePoint
-{
-	uint	idx;
-	uint	post_id;
-	Coords	pos;
-
-	std::vector<const Line*> lines;
-
-	SpacePoint(uint idx_, uint post_id_) :
-		idx(idx_),
-		post_id(post_id_)
-	{}
-
-};
-
-struct Line
-{
-	uint idx;
-	uint length;
-	uint pid_1;
-	uint pid_2;
-
-	SpacePoint*		pt_1;
-	SpacePoint*		pt_2;
-
-	Line(uint idx_, uint length_, uint pid1, uint pid2):
-		idx(idx_),
-		length(length_),
-		pid_1(pid1),
-		pid_2(pid2)
-	{}
-};
-
 struct Train
 {
 	uint idx;
@@ -56,7 +23,7 @@ struct Train
 	uint level;
 	uint goods;
 	uint goods_capacity;
-	std::string player_id;
+	StringId player_id;
 	uint position;
 	uint cooldown;
 	int speed;
@@ -81,17 +48,17 @@ struct Post
 	uint product;
 	uint product_capacity;
 	EPostType type;
-	std::string name;
-	std::string player_id;
+	StringId name;
+	StringId player_id;
 };
 
 struct Player
 {
-	std::string id;
-	std::string name;
+	StringId id = StringPool::EMPTY;
+	StringId name = StringPool::EMPTY;
 	uint rating = 0;
 
-	Player(const std::string& _id, const std::string& _name, uint _rating):
+	Player(StringId _id, StringId _name, uint _rating):
 		id(_id),
 		name(_name),
 		rating(_rating)
@@ -101,51 +68,122 @@ struct Player
 	{}
 };
 
+struct DynamicLayer
+{
+	std::unordered_map<uint, Train> trains;
+	std::unordered_map<uint, Post>	posts;
+	// in order of first appearance of the ids
+	std::map<StringId, Player>		players;
+	int								turn = -1;
+
+	// estimate of the heap taken by the layer, containers included
+	size_t memoryUsage() const;
+};
+
+// Trains of the displayed pair of turns as parallel arrays, slot i is the same train in all of
+// them. Line, position and speed of both turns are resolved to world coordinates once the pair
+// changes, so a frame only blends two positions per train.
+struct TrainFrame
+{
+	std::vector<const Train*>		trains;
+	std::vector<const std::string*>	owners;
+	std::vector<float>				prevX, prevZ;
+	std::vector<float>				curX, curZ;
+	std::vector<float>				dirX, dirZ;
+	// output of interpolate()
+	std::vector<float>				x, z;
+
+	size_t size() const { return trains.size(); }
+	void clear();
+	void resize(size_t count);
+	void interpolate(float interpolator);
+};
+
+// Pair of turns on display. Layers are immutable and shared with the cache, so advancing a turn
+// publishes a new pair with a single pointer swap.
+struct DisplayedTurns
+{
+	TurnCache::LayerPtr prev;
+	TurnCache::LayerPtr cur;
+};
+
 
 class Space
 {
-	struct DynamicLayer
-	{
-		std::unordered_map<uint, Train> trains;
-		std::unordered_map<uint, Post>	posts;
-		std::map<std::string, Player>	players;
-		int								turn = -1;
-		bool							ready = true;
-	};
 public:
 	Space();
 	~Space();
 
-	bool initStaticLayer(const ConnectionManager& manager);
-	bool updateDynamicLayer(const ConnectionManager& manager, float turn);
+	// number of upcoming turns kept requested ahead of the displayed one
+	void setPrefetchDepth(uint depth);
+	// last turn of the game, nothing past it is prefetched; -1 if unknown
+	void setMaxTurn(int turn);
+
+	// Keeps a turn downloaded outside of the space (see GameDownloader), safe to call from any thread.
+	bool storeDynamicLayer(int turn, const char* begin, const char* end);
+	void clearStoredLayers();
+
+	// memory taken by decoded turns kept for revisiting
+	void setCacheBudget(size_t bytes) { m_cache.setBudget(bytes); }
+	// compiled maps are saved there and mapped on the next start, empty disables the cache
+	void setMapCacheDir(const std::string& dir) { m_mapCacheDir = dir; }
+	TurnCacheStats cacheStats() const { return m_cache.stats(); }
+	const GameHistory& history() const { return m_history; }
+	const StaticMap& map() const { return m_map; }
+	// rails and posts of the map, trains of the displayed turns
+	const SpatialIndex& spatial() const { return m_spatial; }
+	// resolves the string handles of the layers
+	const StringPool& strings() const { return m_strings; }
+	// safe to call from any thread, the snapshot stays valid while it is held
+	std::shared_ptr<const DisplayedTurns> displayedTurns() const { return std::atomic_load(&m_displayed); }
+
+	bool initStaticLayer(AsyncConnection& connection);
+	// Never waits for the network: until both turns around the given point have arrived, the
+	// last complete pair stays on display.
+	bool updateDynamicLayer(AsyncConnection& connection, float turn);
 
 	void addStaticSceneToRender(class SpaceRenderer& renderer);
 	void addDynamicSceneToRender(SpaceRenderer& renderer, float interpolator);
 
 private:
-	bool loadLines(const JSONQueryReader& reader);
-	bool loadPoints(const JSONQueryReader& reader);
-	bool loadPlayers(const JSONQueryReader& reader, DynamicLayer& layer) const;
-	bool loadTrains(const JSONQueryReader& reader, DynamicLayer& layer) const;
-	bool loadPosts(const JSONQueryReader& reader, DynamicLayer& layer) const;
-	bool loadCoordinates(const JSONQueryReader& reader);
-	void postCreateStaticLayer();
-	void getWorldTrainCoords(const Train& train, struct Vector3& pos, Vector3& dir);
-	bool loadDynamicLayer(const ConnectionManager& manager, int turn, DynamicLayer& layer) const;
-	const SpacePoint* findPoint(uint idx) const;
+	bool loadLines(const JSONQueryReader& reader, StaticMapSource& source) const;
+	bool loadPoints(const JSONQueryReader& reader, StaticMapSource& source) const;
+	bool loadCoordinates(const JSONQueryReader& reader, StaticMapSource& source) const;
+	bool parseStaticLayer(AsyncConnection& connection, const Response& response, StaticMapSource& source) const;
+	bool parseCoordinatesLayer(AsyncConnection& connection, const Response& response, StaticMapSource& source) const;
+	std::string mapCachePath(uint64_t staticHash) const;
+	// false if the train stands on an unknown line
+	bool getWorldTrainCoords(const Train& train, struct Vector3& pos, Vector3& dir) const;
+	void buildTrainFrame();
+	void requestDynamicLayer(AsyncConnection& connection, int turn, PendingTurn& pending) const;
+	// false if the turn has to be requested again
+	bool receiveDynamicLayer(AsyncConnection& connection, PendingTurn& pending, DynamicLayer& layer) const;
+	bool parseDynamicLayer(const char* begin, const char* end, DynamicLayer& layer) const;
+	// runs on the loader
+	void completeDynamicLayer(AsyncConnection& connection, PendingTurn& pending);
+	TurnCache::LayerPtr findLayer(int turn, bool countAccess);
+	void schedulePrefetch(AsyncConnection& connection, int prevTurn, int curTurn);
 
 private:
-	uint			m_idx;
-	std::string		m_name;
-	Coords			m_size;
 	bool			m_staticLayerLoaded;
-
-	std::unordered_map<uint, SpacePoint>	m_points;
-	std::unordered_map<uint, Line>	m_lines;
-
-	DynamicLayer	m_nextDynamicLayer;
-	DynamicLayer	m_curDynamicLayer;
-	DynamicLayer	m_prevDynamicLayer;
-	mutable SimpleMutex		m_dynamicMutex;
+	StaticMap		m_map;
+	std::string		m_mapCacheDir;
+	SpatialIndex	m_spatial;
+
+	// replaced by the render thread only, other threads read it with atomic_load
+	std::shared_ptr<const DisplayedTurns>	m_displayed;
+	TrainFrame		m_trainFrame;
+	// interned while decoding, which happens in const methods
+	mutable StringPool	m_strings;
+
+	// every turn received is kept compactly in the history, recently shown ones decoded in the cache
+	GameHistory					m_history;
+	TurnCache					m_cache;
+	uint						m_prefetchDepth;
+	int							m_maxTurn;
+	// displayed turn the cache accesses were accounted for
+	int							m_accountedTurn;
+	// fills the history and the cache, declared last to stop before them
+	TurnLoader					m_loader;
 };
 
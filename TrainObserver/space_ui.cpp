@@ -39,7 +39,7 @@ uint generateUIIndex(UIObjectType objType, uint objIdx, uint uiElementIdx)
 	return ((uint)objType << 24) | (objIdx << 16) | uiElementIdx;
 }
 
-void createPostUI(const Vector3& pos, const Post& post, const std::string* playerName)
+void createPostUI(const Vector3& pos, const Post& post, const std::string& name, const std::string* playerName)
 {
 	auto& rs = RenderSystemDX9::instance();
 	auto& view = rs.uiManager().view();
@@ -65,7 +65,7 @@ void createPostUI(const Vector3& pos, const Post& post, const std::string* playe
 				sprintf_s(
 					buf,
 					"%s\nplayer: %s\npopulation: %d / %d\nproduct: %d / %d\narmor: %d / %d",
-					post.name.c_str(),
+					name.c_str(),
 					playerName ? playerName->c_str() : "",
 					post.population,
 					post.population_capacity,
@@ -77,12 +77,12 @@ void createPostUI(const Vector3& pos, const Post& post, const std::string* playe
 				controlSize.y = 70;
 				break;
 			case EPostType::MARKET:
-				sprintf_s(buf, "%s\nproduct: %d / %d", post.name.c_str(), post.product, post.product_capacity);
+				sprintf_s(buf, "%s\nproduct: %d / %d", name.c_str(), post.product, post.product_capacity);
 				controlSize.x = 90;
 				controlSize.y = 40;
 				break;
 			case EPostType::MILITARY_STORAGE:
-				sprintf_s(buf, "%s\narmor: %d / %d", post.name.c_str(), post.armor, post.armor_capacity);
+				sprintf_s(buf, "%s\narmor: %d / %d", name.c_str(), post.armor, post.armor_capacity);
 				controlSize.x = 80;
 				controlSize.y = 40;
 				break;
@@ -116,7 +116,7 @@ void createTrainUI(const Vector3& pos, const Train& train, const std::string* pl
 
 	if (isInScreen)
 	{
-		static std::unordered_map<std::string, DWORD> player_color;
+		static std::unordered_map<StringId, DWORD> player_color;
 		static int									  color_num = 0;
 
 		DWORD color = 0;
@@ -149,7 +149,7 @@ void createTrainUI(const Vector3& pos, const Train& train, const std::string* pl
 	}
 }
 
-void createPlayerUI(const std::map<std::string, Player>& players)
+void createPlayerUI(const std::map<StringId, Player>& players, const StringPool& strings)
 {
 	auto& rs = RenderSystemDX9::instance();
 	auto& view = rs.uiManager().view();
@@ -157,8 +157,7 @@ void createPlayerUI(const std::map<std::string, Player>& players)
 	int yOffset = 0;
 	for (const auto& p : players)
 	{
-		std::hash<std::string> hash_fn;
-		auto uiIdx = hash_fn(p.first);
+		auto uiIdx = generateUIIndex(UIObjectType::PLAYER, p.first, 0);
 
 		view.RemoveControl(uiIdx); // remove previous frame control
 
@@ -183,7 +182,7 @@ void createPlayerUI(const std::map<std::string, Player>& players)
 			sprintf_s(
 				buf,
 				"%s : %d",
-				p.second.name.c_str(),
+				strings.str(p.second.name).c_str(),
 				p.second.rating);
 			controlSize.x = 80;
 			controlSize.y = 60;
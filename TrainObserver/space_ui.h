@@ -2,6 +2,7 @@
 #include "math/vector3.h"
 #include <string>
 #include <map>
+#include "string_pool.h"
 
 struct Post;
 struct Train;
@@ -9,7 +10,7 @@ struct Player;
 
 namespace SpaceUI
 {
-void createPostUI(const Vector3& pos, const Post& post, const std::string* playerName);
+void createPostUI(const Vector3& pos, const Post& post, const std::string& name, const std::string* playerName);
 void createTrainUI(const Vector3& pos, const Train& train, const std::string* playerName);
-void createPlayerUI(const std::map<std::string, Player>& players);
+void createPlayerUI(const std::map<StringId, Player>& players, const StringPool& strings);
 } // namespace SpaceUI
@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <math.h>
+#include "spatial_index.h"
+#include "space.h"
+
+// a few items per cell, limited to keep the cell table small on huge maps
+const float ITEMS_PER_CELL = 2.0f;
+const uint	MAX_GRID_SIDE = 1024;
+
+
+namespace
+{
+float distanceToSegment(float x, float z, float x1, float z1, float x2, float z2)
+{
+	float dx = x2 - x1;
+	float dz = z2 - z1;
+	float lengthSq = dx * dx + dz * dz;
+	float t = lengthSq > 0.0f ? ((x - x1) * dx + (z - z1) * dz) / lengthSq : 0.0f;
+	t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+
+	float px = x1 + dx * t - x;
+	float pz = z1 + dz * t - z;
+	return sqrtf(px * px + pz * pz);
+}
+
+bool overlaps(float minX, float minZ, float maxX, float maxZ, float x1, float z1, float x2, float z2)
+{
+	return (x1 < x2 ? x1 : x2) <= maxX && (x1 > x2 ? x1 : x2) >= minX && (z1 < z2 ? z1 : z2) <= maxZ &&
+		   (z1 > z2 ? z1 : z2) >= minZ;
+}
+
+// false if the box is entirely behind one of the planes
+bool boxInside(const SpatialPlane* planes, size_t count, const float minP[3], const float maxP[3])
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		const SpatialPlane& p = planes[i];
+		// corner of the box furthest along the plane normal
+		float x = p.a >= 0.0f ? maxP[0] : minP[0];
+		float y = p.b >= 0.0f ? maxP[1] : minP[1];
+		float z = p.c >= 0.0f ? maxP[2] : minP[2];
+		if (p.a * x + p.b * y + p.c * z + p.d < 0.0f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+} // namespace
+
+SpatialIndex::SpatialIndex()
+	: m_query(0)
+{
+	clear();
+}
+
+void SpatialIndex::clear()
+{
+	m_static = Grid();
+	m_trains = Grid();
+	m_originX = 0.0f;
+	m_originZ = 0.0f;
+	m_cellSize = 1.0f;
+	m_columns = 0;
+	m_rows = 0;
+	m_seen.clear();
+}
+
+void SpatialIndex::build(const StaticMap& map)
+{
+	clear();
+
+	Grid grid;
+	grid.items.reserve(map.lines().size() + map.points().size());
+	for (const auto& line : map.lines())
+	{
+		grid.items.push_back(Item{SPATIAL_LINE, line.idx, line.x1, line.z1, line.x2, line.z2});
+	}
+	// points without a post have post_idx 0
+	for (const auto& point : map.points())
+	{
+		if (point.postIdx != 0)
+		{
+			grid.items.push_back(Item{SPATIAL_POST, point.postIdx, point.x, point.z, point.x, point.z});
+		}
+	}
+
+	if (map.points().empty())
+	{
+		return;
+	}
+
+	float minX = map.points().front().x, maxX = minX;
+	float minZ = map.points().front().z, maxZ = minZ;
+	for (const auto& point : map.points())
+	{
+		minX = point.x < minX ? point.x : minX;
+		maxX = point.x > maxX ? point.x : maxX;
+		minZ = point.z < minZ ? point.z : minZ;
+		maxZ = point.z > maxZ ? point.z : maxZ;
+	}
+
+	float width = maxX - minX + 1.0f;
+	float height = maxZ - minZ + 1.0f;
+	float cells = float(grid.items.size()) / ITEMS_PER_CELL;
+	m_cellSize = sqrtf(width * height / (cells > 1.0f ? cells : 1.0f));
+
+	float side = width > height ? width : height;
+	if (side / m_cellSize > float(MAX_GRID_SIDE))
+	{
+		m_cellSize = side / float(MAX_GRID_SIDE);
+	}
+
+	m_originX = minX;
+	m_originZ = minZ;
+	m_columns = uint(width / m_cellSize) + 1;
+	m_rows = uint(height / m_cellSize) + 1;
+
+	bin(grid);
+	m_static = std::move(grid);
+	m_trains.cells.assign(m_columns * m_rows + 1, 0);
+	m_seen.assign(m_static.items.size(), 0);
+}
+
+void SpatialIndex::setTrains(const TrainFrame& frame)
+{
+	m_trains.items.clear();
+	for (size_t i = 0; i < frame.size(); ++i)
+	{
+		m_trains.items.push_back(
+			Item{SPATIAL_TRAIN, frame.trains[i]->idx, frame.prevX[i], frame.prevZ[i], frame.curX[i], frame.curZ[i]});
+	}
+
+	bin(m_trains);
+	m_seen.resize(m_static.items.size() + m_trains.items.size(), 0);
+}
+
+void SpatialIndex::bin(Grid& grid) const
+{
+	// counting pass, then every cell gets its slice
+	grid.cells.assign(m_columns * m_rows + 1, 0);
+	grid.binned.clear();
+	if (m_columns == 0)
+	{
+		return;
+	}
+
+	for (const Item& item : grid.items)
+	{
+		uint x0, z0, x1, z1;
+		cellRange(item.x1, item.z1, item.x2, item.z2, x0, z0, x1, z1);
+		for (uint z = z0; z <= z1; ++z)
+		{
+			for (uint x = x0; x <= x1; ++x)
+			{
+				++grid.cells[z * m_columns + x + 1];
+			}
+		}
+	}
+
+	for (size_t c = 1; c < grid.cells.size(); ++c)
+	{
+		grid.cells[c] += grid.cells[c - 1];
+	}
+
+	grid.binned.resize(grid.cells.back());
+	std::vector<uint> fill(grid.cells.begin(), grid.cells.end() - 1);
+	for (uint i = 0; i < grid.items.size(); ++i)
+	{
+		const Item& item = grid.items[i];
+		uint		x0, z0, x1, z1;
+		cellRange(item.x1, item.z1, item.x2, item.z2, x0, z0, x1, z1);
+		for (uint z = z0; z <= z1; ++z)
+		{
+			for (uint x = x0; x <= x1; ++x)
+			{
+				grid.binned[fill[z * m_columns + x]++] = i;
+			}
+		}
+	}
+}
+
+void SpatialIndex::cellRange(float minX, float minZ, float maxX, float maxZ, uint& x0, uint& z0, uint& x1, uint& z1) const
+{
+	if (minX > maxX)
+		std::swap(minX, maxX);
+	if (minZ > maxZ)
+		std::swap(minZ, maxZ);
+
+	auto cell = [this](float v, float origin, uint count) {
+		float c = (v - origin) / m_cellSize;
+		return c <= 0.0f ? 0 : (c >= float(count - 1) ? count - 1 : uint(c));
+	};
+
+	x0 = cell(minX, m_originX, m_columns);
+	x1 = cell(maxX, m_originX, m_columns);
+	z0 = cell(minZ, m_originZ, m_rows);
+	z1 = cell(maxZ, m_originZ, m_rows);
+}
+
+void SpatialIndex::beginQuery() const
+{
+	if (++m_query == 0)
+	{
+		std::fill(m_seen.begin(), m_seen.end(), 0);
+		m_query = 1;
+	}
+}
+
+template <typename Visitor>
+void SpatialIndex::visit(uint x0, uint z0, uint x1, uint z1, uint kinds, Visitor visitor) const
+{
+	const Grid* grids[] = {&m_static, &m_trains};
+	uint		base = 0;
+	for (const Grid* grid : grids)
+	{
+		for (uint z = z0; z <= z1; ++z)
+		{
+			const uint* cells = grid->cells.data() + z * m_columns;
+			for (uint b = cells[x0]; b < cells[x1 + 1]; ++b)
+			{
+				uint		i = grid->binned[b];
+				const Item& item = grid->items[i];
+				if ((item.kind & kinds) && m_seen[base + i] != m_query)
+				{
+					m_seen[base + i] = m_query;
+					visitor(item);
+				}
+			}
+		}
+		base += uint(grid->items.size());
+	}
+}
+
+void SpatialIndex::queryRect(float minX, float minZ, float maxX, float maxZ, uint kinds, std::vector<SpatialHit>& hits) const
+{
+	if (m_columns == 0)
+	{
+		return;
+	}
+
+	uint x0, z0, x1, z1;
+	cellRange(minX, minZ, maxX, maxZ, x0, z0, x1, z1);
+	beginQuery();
+	visit(x0, z0, x1, z1, kinds, [&](const Item& item) {
+		if (overlaps(minX, minZ, maxX, maxZ, item.x1, item.z1, item.x2, item.z2))
+		{
+			hits.push_back(SpatialHit{item.kind, item.idx, 0.0f});
+		}
+	});
+}
+
+void SpatialIndex::queryFrustum(const SpatialPlane* planes, size_t count, float height, uint kinds, std::vector<SpatialHit>& hits) const
+{
+	beginQuery();
+	for (uint z = 0; z < m_rows; ++z)
+	{
+		for (uint x = 0; x < m_columns; ++x)
+		{
+			float cellMin[3] = {m_originX + x * m_cellSize, 0.0f, m_originZ + z * m_cellSize};
+			float cellMax[3] = {cellMin[0] + m_cellSize, height, cellMin[2] + m_cellSize};
+			if (!boxInside(planes, count, cellMin, cellMax))
+			{
+				continue;
+			}
+
+			visit(x, z, x, z, kinds, [&](const Item& item) {
+				float itemMin[3] = {item.x1 < item.x2 ? item.x1 : item.x2, 0.0f, item.z1 < item.z2 ? item.z1 : item.z2};
+				float itemMax[3] = {item.x1 > item.x2 ? item.x1 : item.x2, height, item.z1 > item.z2 ? item.z1 : item.z2};
+				if (boxInside(planes, count, itemMin, itemMax))
+				{
+					hits.push_back(SpatialHit{item.kind, item.idx, 0.0f});
+				}
+			});
+		}
+	}
+}
+
+bool SpatialIndex::pick(float x, float z, float radius, uint kinds, SpatialHit& hit) const
+{
+	if (m_columns == 0)
+	{
+		return false;
+	}
+
+	bool found = false;
+	uint x0, z0, x1, z1;
+	cellRange(x - radius, z - radius, x + radius, z + radius, x0, z0, x1, z1);
+	beginQuery();
+	visit(x0, z0, x1, z1, kinds, [&](const Item& item) {
+		float distance = distanceToSegment(x, z, item.x1, item.z1, item.x2, item.z2);
+		if (distance <= radius && (!found || distance < hit.distance))
+		{
+			hit = SpatialHit{item.kind, item.idx, distance};
+			found = true;
+		}
+	});
+	return found;
+}
+
+bool SpatialIndex::pickRay(const float origin[3], const float dir[3], float radius, uint kinds, SpatialHit& hit) const
+{
+	// the ray has to go down to the ground
+	if (dir[1] > -1e-6f && dir[1] < 1e-6f)
+	{
+		return false;
+	}
+
+	float t = -origin[1] / dir[1];
+	if (t < 0.0f)
+	{
+		return false;
+	}
+
+	return pick(origin[0] + dir[0] * t, origin[2] + dir[2] * t, radius, kinds, hit);
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <vector>
+#include "defs.hpp"
+
+class StaticMap;
+struct TrainFrame;
+
+enum SpatialKind
+{
+	SPATIAL_LINE = 1 << 0,
+	SPATIAL_POST = 1 << 1,
+	SPATIAL_TRAIN = 1 << 2,
+	SPATIAL_ALL = SPATIAL_LINE | SPATIAL_POST | SPATIAL_TRAIN,
+};
+
+struct SpatialHit
+{
+	SpatialKind	kind;
+	// server id of the line, post or train
+	uint		idx;
+	// distance from the query point, picking only
+	float		distance;
+};
+
+// a*x + b*y + c*z + d >= 0 inside
+struct SpatialPlane
+{
+	float a, b, c, d;
+};
+
+// Uniform grid over the ground plane. Rails and posts are binned once per map, trains per turn:
+// a train is binned as the segment between its positions of the displayed pair of turns, so it
+// is found at any point of the interpolation. Queries are meant for the render thread.
+class SpatialIndex
+{
+public:
+	SpatialIndex();
+
+	void build(const StaticMap& map);
+	void setTrains(const TrainFrame& frame);
+	void clear();
+
+	// objects whose bounds overlap the rectangle
+	void queryRect(float minX, float minZ, float maxX, float maxZ, uint kinds, std::vector<SpatialHit>& hits) const;
+	// objects not entirely outside any of the planes, height is the extent of the objects above the ground
+	void queryFrustum(const SpatialPlane* planes, size_t count, float height, uint kinds, std::vector<SpatialHit>& hits) const;
+	// nearest object within the radius of the point
+	bool pick(float x, float z, float radius, uint kinds, SpatialHit& hit) const;
+	// nearest object within the radius of the point where the ray meets the ground
+	bool pickRay(const float origin[3], const float dir[3], float radius, uint kinds, SpatialHit& hit) const;
+
+private:
+	struct Item
+	{
+		SpatialKind	kind;
+		uint		idx;
+		// segment, both ends are the same for a post
+		float		x1, z1;
+		float		x2, z2;
+	};
+
+	// items binned into cells, cell c holds items[cells[c]..cells[c + 1])
+	struct Grid
+	{
+		std::vector<Item>	items;
+		std::vector<uint>	cells;
+		std::vector<uint>	binned;
+	};
+
+	void bin(Grid& grid) const;
+	void cellRange(float minX, float minZ, float maxX, float maxZ, uint& x0, uint& z0, uint& x1, uint& z1) const;
+	// items of the cells in both grids, each item is visited once between two beginQuery() calls
+	void beginQuery() const;
+	template <typename Visitor>
+	void visit(uint x0, uint z0, uint x1, uint z1, uint kinds, Visitor visitor) const;
+
+private:
+	Grid				m_static;
+	Grid				m_trains;
+	float				m_originX;
+	float				m_originZ;
+	float				m_cellSize;
+	uint				m_columns;
+	uint				m_rows;
+	// items already reported by the running query, an item spans several cells
+	mutable std::vector<uint>	m_seen;
+	mutable uint				m_query;
+};
@@ -0,0 +1,468 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "static_map.h"
+#include "mapped_file.h"
+#include "log_interface.h"
+
+// id tables are indexed by server id, ids beyond it mean a broken message rather than a big map
+const uint MAX_MAP_ID = 1 << 24;
+
+
+// Start of the block. Points, lines, index tables and the name follow it in this order, numbers
+// are stored as they are in memory.
+struct StaticMap::Header
+{
+	static const uint32_t MAGIC = 0x4d534f54; // TOSM
+	static const uint32_t VERSION = 1;
+
+	uint32_t	magic;
+	uint32_t	version;
+	uint64_t	staticHash;
+	uint64_t	coordinatesHash;
+	uint32_t	idx;
+	uint32_t	width;
+	uint32_t	height;
+	uint32_t	pointCount;
+	uint32_t	lineCount;
+	uint32_t	nameLength;
+	uint32_t	tables[TABLE_COUNT + 1];
+
+	size_t linesOffset() const { return sizeof(Header) + pointCount * sizeof(Point); }
+	size_t indexOffset() const { return linesOffset() + lineCount * sizeof(Line); }
+	size_t nameOffset() const { return indexOffset() + tables[TABLE_COUNT] * sizeof(uint); }
+	size_t size() const { return nameOffset() + nameLength; }
+};
+
+
+namespace
+{
+uint maxId(const std::vector<StaticMapSource::Point>& points, bool post)
+{
+	uint result = 0;
+	for (const auto& p : points)
+	{
+		uint id = post ? p.postIdx : p.idx;
+		result = id > result ? id : result;
+	}
+	return result;
+}
+
+uint maxId(const std::vector<StaticMapSource::Line>& lines)
+{
+	uint result = 0;
+	for (const auto& l : lines)
+	{
+		result = l.idx > result ? l.idx : result;
+	}
+	return result;
+}
+
+bool fileExists(const char* path)
+{
+	FILE* file = nullptr;
+#ifdef _WIN32
+	if (fopen_s(&file, path, "rb") != 0)
+	{
+		file = nullptr;
+	}
+#else
+	file = fopen(path, "rb");
+#endif
+	if (file)
+	{
+		fclose(file);
+	}
+	return file != nullptr;
+}
+} // namespace
+
+StaticMap::StaticMap()
+	: m_header(nullptr)
+	, m_index(nullptr)
+{
+}
+
+StaticMap::~StaticMap()
+{
+}
+
+void StaticMap::clear()
+{
+	m_header = nullptr;
+	m_points = ArrayView<Point>();
+	m_lines = ArrayView<Line>();
+	m_index = nullptr;
+	m_file.reset();
+	m_storage.clear();
+}
+
+uint64_t StaticMap::hash(const char* begin, const char* end)
+{
+	uint64_t h = 14695981039346656037ull;
+	for (const char* c = begin; c != end; ++c)
+	{
+		h = (h ^ uchar(*c)) * 1099511628211ull;
+	}
+	return h;
+}
+
+bool StaticMap::compile(const StaticMapSource& source)
+{
+	clear();
+
+	uint pointIds = source.points.empty() ? 0 : maxId(source.points, false) + 1;
+	uint postIds = source.points.empty() ? 0 : maxId(source.points, true) + 1;
+	uint lineIds = source.lines.empty() ? 0 : maxId(source.lines) + 1;
+	if (pointIds > MAX_MAP_ID || postIds > MAX_MAP_ID || lineIds > MAX_MAP_ID)
+	{
+		LOG(MSG_ERROR, "Map ids are out of range!");
+		return false;
+	}
+
+	Header header = {};
+	header.magic = Header::MAGIC;
+	header.version = Header::VERSION;
+	header.staticHash = source.staticHash;
+	header.coordinatesHash = source.coordinatesHash;
+	header.idx = source.idx;
+	header.width = source.width;
+	header.height = source.height;
+	header.pointCount = uint32_t(source.points.size());
+	header.lineCount = uint32_t(source.lines.size());
+	header.nameLength = uint32_t(source.name.size());
+
+	uint sizes[TABLE_COUNT];
+	sizes[POINT_IDS] = pointIds;
+	sizes[LINE_IDS] = lineIds;
+	sizes[POST_IDS] = postIds;
+	sizes[ADJACENCY_OFFSETS] = uint(source.points.size()) + 1;
+	sizes[ADJACENCY] = uint(source.lines.size()) * 2;
+	for (uint t = 0; t < TABLE_COUNT; ++t)
+	{
+		header.tables[t + 1] = header.tables[t] + sizes[t];
+	}
+
+	std::vector<uint64_t> storage((header.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+	char*				  block = reinterpret_cast<char*>(storage.data());
+	Point*				  points = reinterpret_cast<Point*>(block + sizeof(Header));
+	Line*				  lines = reinterpret_cast<Line*>(block + header.linesOffset());
+	uint*				  index = reinterpret_cast<uint*>(block + header.indexOffset());
+
+	for (uint i = 0; i < header.tables[TABLE_COUNT]; ++i)
+	{
+		index[i] = INVALID;
+	}
+
+	uint* pointById = index + header.tables[POINT_IDS];
+	uint* lineById = index + header.tables[LINE_IDS];
+	uint* pointByPost = index + header.tables[POST_IDS];
+	uint* offsets = index + header.tables[ADJACENCY_OFFSETS];
+	uint* adjacency = index + header.tables[ADJACENCY];
+
+	for (uint i = 0; i < header.pointCount; ++i)
+	{
+		const auto& p = source.points[i];
+		pointById[p.idx] = i;
+		if (pointByPost[p.postIdx] == INVALID)
+		{
+			pointByPost[p.postIdx] = i;
+		}
+		points[i] = Point{p.idx, p.postIdx, 0.0f, 0.0f};
+	}
+
+	for (const auto& c : source.coordinates)
+	{
+		uint point = c.idx < pointIds ? pointById[c.idx] : INVALID;
+		if (point == INVALID)
+		{
+			LOG(MSG_ERROR, "Inconsistent coordinates. Cannot find post with id = %d!", c.idx);
+			return false;
+		}
+		points[point].x = float(c.x);
+		points[point].z = float(c.y);
+	}
+
+	// lines are counted per point first, then every point gets its slice of the adjacency
+	for (uint i = 0; i <= header.pointCount; ++i)
+	{
+		offsets[i] = 0;
+	}
+
+	for (uint i = 0; i < header.lineCount; ++i)
+	{
+		const auto& l = source.lines[i];
+		uint		point1 = l.point1 < pointIds ? pointById[l.point1] : INVALID;
+		uint		point2 = l.point2 < pointIds ? pointById[l.point2] : INVALID;
+		if (point1 == INVALID || point2 == INVALID)
+		{
+			LOG(MSG_ERROR, "Incorrect lines vs points connection!");
+			return false;
+		}
+
+		const Point& p1 = points[point1];
+		const Point& p2 = points[point2];
+		float		 dx = p2.x - p1.x;
+		float		 dz = p2.z - p1.z;
+		float		 len = sqrtf(dx * dx + dz * dz);
+		float		 invLen = len > 0.0f ? 1.0f / len : 0.0f;
+
+		lineById[l.idx] = i;
+		lines[i] = Line{l.idx, l.length, point1, point2, p1.x, p1.z, p2.x, p2.z, dx * invLen, dz * invLen};
+		++offsets[point1 + 1];
+		++offsets[point2 + 1];
+	}
+
+	for (uint i = 0; i < header.pointCount; ++i)
+	{
+		offsets[i + 1] += offsets[i];
+	}
+
+	std::vector<uint> fill(offsets, offsets + header.pointCount);
+	for (uint i = 0; i < header.lineCount; ++i)
+	{
+		adjacency[fill[lines[i].point1]++] = i;
+		adjacency[fill[lines[i].point2]++] = i;
+	}
+
+	memcpy(block + header.nameOffset(), source.name.data(), source.name.size());
+	memcpy(block, &header, sizeof(header));
+
+	m_storage = std::move(storage);
+	return attach(reinterpret_cast<const char*>(m_storage.data()), header.size());
+}
+
+bool StaticMap::load(const char* path)
+{
+	clear();
+
+	// a miss is the usual case for a new map, MappedFile would report it as an error
+	if (!fileExists(path))
+	{
+		return false;
+	}
+
+	std::unique_ptr<MappedFile> file(new MappedFile());
+	if (!file->open(path) || !attach(file->data(), file->size()))
+	{
+		LOG(MSG_WARNING, "Map cache %s is not usable", path);
+		clear();
+		return false;
+	}
+
+	m_file = std::move(file);
+	return true;
+}
+
+bool StaticMap::save(const char* path) const
+{
+	if (!m_header)
+	{
+		return false;
+	}
+
+	// written aside and renamed, a map half written by a crash is never mapped
+	std::string tmpPath = std::string(path) + ".tmp";
+	FILE*		file = nullptr;
+#ifdef _WIN32
+	if (fopen_s(&file, tmpPath.c_str(), "wb") != 0)
+	{
+		file = nullptr;
+	}
+#else
+	file = fopen(tmpPath.c_str(), "wb");
+#endif
+	if (!file)
+	{
+		LOG(MSG_ERROR, "Cannot create map cache %s", tmpPath.c_str());
+		return false;
+	}
+
+	size_t size = m_header->size();
+	bool   written = fwrite(m_header, 1, size, file) == size;
+	written = fclose(file) == 0 && written;
+
+	remove(path);
+	if (!written || rename(tmpPath.c_str(), path) != 0)
+	{
+		LOG(MSG_ERROR, "Cannot write map cache %s", path);
+		remove(tmpPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool StaticMap::attach(const char* data, size_t size)
+{
+	const Header* header = reinterpret_cast<const Header*>(data);
+	if (size < sizeof(Header) || header->magic != Header::MAGIC || header->version != Header::VERSION)
+	{
+		return false;
+	}
+
+	// counts are checked one by one, so that a damaged header cannot overflow the sizes
+	if (header->pointCount > MAX_MAP_ID || header->lineCount > MAX_MAP_ID || header->nameLength > size ||
+		header->tables[TABLE_COUNT] > size || header->size() != size)
+	{
+		return false;
+	}
+
+	if (header->tables[0] != 0)
+	{
+		return false;
+	}
+
+	for (uint t = 0; t < TABLE_COUNT; ++t)
+	{
+		if (header->tables[t] > header->tables[t + 1])
+		{
+			return false;
+		}
+	}
+
+	// the lookups index points, lines and the adjacency with what the tables hold, so every entry is
+	// range checked once here rather than on each lookup
+	const uint* tables = header->tables;
+	if (tables[ADJACENCY_OFFSETS + 1] - tables[ADJACENCY_OFFSETS] != header->pointCount + 1 ||
+		tables[ADJACENCY + 1] - tables[ADJACENCY] != header->lineCount * 2)
+	{
+		return false;
+	}
+
+	const Point* points = reinterpret_cast<const Point*>(data + sizeof(Header));
+	const Line*	 lines = reinterpret_cast<const Line*>(data + header->linesOffset());
+	const uint*	 index = reinterpret_cast<const uint*>(data + header->indexOffset());
+
+	for (uint i = 0; i < header->lineCount; ++i)
+	{
+		if (lines[i].point1 >= header->pointCount || lines[i].point2 >= header->pointCount)
+		{
+			return false;
+		}
+	}
+
+	// offsets are checked below, their limit is not used
+	const uint limits[TABLE_COUNT] = {header->pointCount, header->lineCount, header->pointCount, 0, header->lineCount};
+	for (uint t = 0; t < TABLE_COUNT; ++t)
+	{
+		if (t == ADJACENCY_OFFSETS)
+		{
+			continue;
+		}
+
+		for (uint i = tables[t]; i < tables[t + 1]; ++i)
+		{
+			// unused ids are INVALID, the adjacency has no gaps
+			if (index[i] >= limits[t] && (t == ADJACENCY || index[i] != INVALID))
+			{
+				return false;
+			}
+		}
+	}
+
+	const uint* offsets = index + tables[ADJACENCY_OFFSETS];
+	if (offsets[0] != 0 || offsets[header->pointCount] != header->lineCount * 2)
+	{
+		return false;
+	}
+
+	for (uint i = 0; i < header->pointCount; ++i)
+	{
+		if (offsets[i] > offsets[i + 1])
+		{
+			return false;
+		}
+	}
+
+	m_header = header;
+	m_points.first = points;
+	m_points.count = header->pointCount;
+	m_lines.first = lines;
+	m_lines.count = header->lineCount;
+	m_index = index;
+	return true;
+}
+
+uint StaticMap::idx() const
+{
+	return m_header ? m_header->idx : 0;
+}
+
+std::string StaticMap::name() const
+{
+	if (!m_header)
+	{
+		return std::string();
+	}
+
+	const char* name = reinterpret_cast<const char*>(m_header) + m_header->nameOffset();
+	return std::string(name, m_header->nameLength);
+}
+
+uint StaticMap::width() const
+{
+	return m_header ? m_header->width : 0;
+}
+
+uint StaticMap::height() const
+{
+	return m_header ? m_header->height : 0;
+}
+
+uint64_t StaticMap::staticHash() const
+{
+	return m_header ? m_header->staticHash : 0;
+}
+
+uint64_t StaticMap::coordinatesHash() const
+{
+	return m_header ? m_header->coordinatesHash : 0;
+}
+
+uint StaticMap::lookup(Table table, uint id) const
+{
+	if (!m_header)
+	{
+		return INVALID;
+	}
+
+	uint size = m_header->tables[table + 1] - m_header->tables[table];
+	return id < size ? m_index[m_header->tables[table] + id] : INVALID;
+}
+
+const StaticMap::Point* StaticMap::findPoint(uint idx) const
+{
+	uint point = lookup(POINT_IDS, idx);
+	return point != INVALID ? &m_points[point] : nullptr;
+}
+
+const StaticMap::Line* StaticMap::findLine(uint idx) const
+{
+	uint line = lookup(LINE_IDS, idx);
+	return line != INVALID ? &m_lines[line] : nullptr;
+}
+
+const StaticMap::Point* StaticMap::findPostPoint(uint postIdx) const
+{
+	uint point = lookup(POST_IDS, postIdx);
+	return point != INVALID ? &m_points[point] : nullptr;
+}
+
+StaticMap::LineRange StaticMap::linesOf(uint point) const
+{
+	const uint* offsets = m_index + m_header->tables[ADJACENCY_OFFSETS];
+	const uint* adjacency = m_index + m_header->tables[ADJACENCY];
+
+	LineRange range;
+	range.first = adjacency + offsets[point];
+	range.count = offsets[point + 1] - offsets[point];
+	return range;
+}
+
+void StaticMap::position(const Line& line, uint position, float& x, float& z)
+{
+	float t = line.length > 0 ? float(position) / float(line.length) : 0.0f;
+	x = line.x1 + (line.x2 - line.x1) * t;
+	z = line.z1 + (line.z2 - line.z1) * t;
+}
@@ -0,0 +1,154 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "defs.hpp"
+
+class MappedFile;
+
+// Static layer as read from the STATIC and COORDINATES messages, ids are the ones of the server.
+struct StaticMapSource
+{
+	struct Point
+	{
+		uint idx;
+		uint postIdx;
+	};
+
+	struct Line
+	{
+		uint idx;
+		uint length;
+		uint point1;
+		uint point2;
+	};
+
+	struct Coordinates
+	{
+		uint idx;
+		uint x;
+		uint y;
+	};
+
+	uint						idx = 0;
+	std::string					name;
+	std::vector<Point>			points;
+	std::vector<Line>			lines;
+	std::vector<Coordinates>	coordinates;
+	uint						width = 0;
+	uint						height = 0;
+	// of the raw messages the map was compiled from
+	uint64_t					staticHash = 0;
+	uint64_t					coordinatesHash = 0;
+};
+
+template <typename T>
+struct ArrayView
+{
+	const T*	first = nullptr;
+	size_t		count = 0;
+
+	const T* begin() const { return first; }
+	const T* end() const { return first + count; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	const T& front() const { return first[0]; }
+	const T& operator[](size_t i) const { return first[i]; }
+};
+
+// Immutable graph of the space. Points and lines are renumbered densely in load order and every
+// lookup is array indexing: server ids and posts map to dense indices through tables, lines of a
+// point are a CSR slice. World geometry of the lines is computed once, on compile.
+// The whole map is one block in the layout of its file, so a saved map is used right from a mapping.
+class StaticMap
+{
+public:
+	static const uint INVALID = uint(-1);
+
+	struct Point
+	{
+		uint	idx;
+		uint	postIdx;
+		// world position, the map lies in the XZ plane
+		float	x;
+		float	z;
+	};
+
+	struct Line
+	{
+		uint	idx;
+		uint	length;
+		// dense indices of the end points
+		uint	point1;
+		uint	point2;
+		float	x1, z1;
+		float	x2, z2;
+		// unit vector from the first point to the second one
+		float	dirX, dirZ;
+	};
+
+	typedef ArrayView<uint> LineRange;
+
+	StaticMap();
+	~StaticMap();
+	StaticMap(const StaticMap&) = delete;
+	StaticMap& operator=(const StaticMap&) = delete;
+
+	// Replaces the map, false if the source is inconsistent.
+	bool compile(const StaticMapSource& source);
+	// Maps a map saved before, false if the file is missing, damaged or of another version.
+	bool load(const char* path);
+	bool save(const char* path) const;
+	void clear();
+
+	// FNV-1a of a raw message, identifies the layers a map was compiled from
+	static uint64_t hash(const char* begin, const char* end);
+
+	bool empty() const { return m_points.empty(); }
+	uint idx() const;
+	std::string name() const;
+	uint width() const;
+	uint height() const;
+	uint64_t staticHash() const;
+	uint64_t coordinatesHash() const;
+
+	const ArrayView<Point>& points() const { return m_points; }
+	const ArrayView<Line>& lines() const { return m_lines; }
+
+	// by server id, nullptr if unknown
+	const Point* findPoint(uint idx) const;
+	const Line* findLine(uint idx) const;
+	const Point* findPostPoint(uint postIdx) const;
+	// dense indices of the lines ending in a point
+	LineRange linesOf(uint point) const;
+
+	// World position of a train on a line, heading towards the second point.
+	static void position(const Line& line, uint position, float& x, float& z);
+
+private:
+	enum Table
+	{
+		POINT_IDS,
+		LINE_IDS,
+		POST_IDS,
+		ADJACENCY_OFFSETS,
+		ADJACENCY,
+		TABLE_COUNT
+	};
+
+	struct Header;
+
+	bool attach(const char* data, size_t size);
+	uint lookup(Table table, uint id) const;
+
+private:
+	// the block is either compiled here or mapped from a file
+	std::vector<uint64_t>			m_storage;
+	std::unique_ptr<MappedFile>		m_file;
+
+	const Header*		m_header;
+	ArrayView<Point>	m_points;
+	ArrayView<Line>		m_lines;
+	// every index table in one array, table t occupies [tables[t], tables[t + 1]) of the header
+	const uint*			m_index;
+};
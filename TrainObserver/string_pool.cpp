@@ -0,0 +1,71 @@
+#include "string_pool.h"
+#include <string.h>
+
+
+bool StringPool::Key::operator==(const Key& other) const
+{
+	return size == other.size && memcmp(data, other.data, size) == 0;
+}
+
+size_t StringPool::KeyHash::operator()(const Key& key) const
+{
+	// FNV-1a, ids are short and a lookup hashes them once
+	size_t hash = sizeof(size_t) == 8 ? size_t(14695981039346656037ULL) : size_t(2166136261U);
+	size_t prime = sizeof(size_t) == 8 ? size_t(1099511628211ULL) : size_t(16777619U);
+	for (size_t i = 0; i < key.size; ++i)
+	{
+		hash = (hash ^ uchar(key.data[i])) * prime;
+	}
+	return hash;
+}
+
+StringPool::StringPool()
+{
+	m_strings.emplace_back();
+	m_ids.emplace(Key{m_strings.back().data(), 0}, StringId(EMPTY));
+}
+
+StringId StringPool::intern(const char* begin, const char* end)
+{
+	if (begin == end)
+	{
+		return EMPTY;
+	}
+
+	SimpleMutexHolder holder(m_mutex);
+	auto			  it = m_ids.find(Key{begin, size_t(end - begin)});
+	if (it != m_ids.end())
+	{
+		return it->second;
+	}
+
+	// only a new string is copied, the key points at the copy
+	StringId id = StringId(m_strings.size());
+	m_strings.emplace_back(begin, end);
+	m_ids.emplace(Key{m_strings.back().data(), m_strings.back().size()}, id);
+	return id;
+}
+
+const std::string& StringPool::str(StringId id) const
+{
+	SimpleMutexHolder holder(m_mutex);
+	return id < m_strings.size() ? m_strings[id] : m_strings[EMPTY];
+}
+
+size_t StringPool::size() const
+{
+	SimpleMutexHolder holder(m_mutex);
+	return m_strings.size();
+}
+
+size_t StringPool::memoryUsage() const
+{
+	SimpleMutexHolder holder(m_mutex);
+	size_t			  bytes = sizeof(*this) + m_ids.bucket_count() * sizeof(void*);
+	for (const std::string& s : m_strings)
+	{
+		// a hash node besides the string itself
+		bytes += sizeof(s) + s.capacity() + sizeof(Key) + sizeof(StringId) + sizeof(void*) * 2;
+	}
+	return bytes;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include "defs.hpp"
+#include "mutex.h"
+
+// Handle of an interned string, equal strings get equal handles. 0 is the empty string.
+typedef uint StringId;
+
+// Player ids and names and post names repeat in every turn, layers keep them as handles which
+// are resolved once, when a turn is decoded. Strings live as long as the pool. Thread safe.
+class StringPool
+{
+public:
+	static const StringId EMPTY = 0;
+
+	StringPool();
+	StringPool(const StringPool&) = delete;
+	StringPool& operator=(const StringPool&) = delete;
+
+	StringId intern(const char* begin, const char* end);
+	StringId intern(const std::string& str) { return intern(str.data(), str.data() + str.size()); }
+	// the reference stays valid as long as the pool
+	const std::string& str(StringId id) const;
+
+	size_t size() const;
+	size_t memoryUsage() const;
+
+private:
+	// characters of an interned string or of a string being looked up, nothing is copied
+	struct Key
+	{
+		const char*	data;
+		size_t		size;
+
+		bool operator==(const Key& other) const;
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const;
+	};
+
+private:
+	mutable SimpleMutex								m_mutex;
+	// keys point into m_strings, a lookup allocates nothing
+	std::unordered_map<Key, StringId, KeyHash>		m_ids;
+	// strings by handle, a deque never moves them as it grows
+	std::deque<std::string>							m_strings;
+};
@@ -0,0 +1,280 @@
+#include "trace.h"
+#include "log_interface.h"
+
+#include <algorithm>
+#include <string.h>
+
+
+static void encodeU32(uchar* out, uint32_t value)
+{
+	for (uint i = 0; i < 4; ++i)
+	{
+		out[i] = uchar(value >> (8 * i));
+	}
+}
+
+static void encodeU64(uchar* out, uint64_t value)
+{
+	for (uint i = 0; i < 8; ++i)
+	{
+		out[i] = uchar(value >> (8 * i));
+	}
+}
+
+static uint32_t decodeU32(const uchar* in)
+{
+	uint32_t value = 0;
+	for (uint i = 0; i < 4; ++i)
+	{
+		value |= uint32_t(in[i]) << (8 * i);
+	}
+	return value;
+}
+
+static uint64_t decodeU64(const uchar* in)
+{
+	uint64_t value = 0;
+	for (uint i = 0; i < 8; ++i)
+	{
+		value |= uint64_t(in[i]) << (8 * i);
+	}
+	return value;
+}
+
+void TraceRecordHeader::encode(uchar* out) const
+{
+	encodeU32(out, action);
+	encodeU32(out + 4, result);
+	encodeU32(out + 8, session);
+	encodeU32(out + 12, requestLength);
+	encodeU32(out + 16, responseLength);
+	encodeU64(out + 20, sentUs);
+	encodeU64(out + 28, receivedUs);
+}
+
+TraceRecordHeader TraceRecordHeader::decode(const uchar* in)
+{
+	TraceRecordHeader header;
+	header.action = decodeU32(in);
+	header.result = decodeU32(in + 4);
+	header.session = decodeU32(in + 8);
+	header.requestLength = decodeU32(in + 12);
+	header.responseLength = decodeU32(in + 16);
+	header.sentUs = decodeU64(in + 20);
+	header.receivedUs = decodeU64(in + 28);
+	return header;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+TraceWriter::TraceWriter()
+	: m_file(nullptr)
+	, m_sessions(0)
+{
+}
+
+TraceWriter::~TraceWriter()
+{
+	close();
+}
+
+bool TraceWriter::open(const char* path)
+{
+	close();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+#ifdef _WIN32
+	if (fopen_s(&m_file, path, "wb") != 0)
+	{
+		m_file = nullptr;
+	}
+#else
+	m_file = fopen(path, "wb");
+#endif
+	if (!m_file)
+	{
+		LOG(MSG_ERROR, "Cannot create trace file %s", path);
+		return false;
+	}
+
+	uchar header[TraceFileHeader::SIZE];
+	encodeU32(header, TraceFileHeader::MAGIC);
+	encodeU32(header + 4, TraceFileHeader::VERSION);
+	fwrite(header, 1, sizeof(header), m_file);
+
+	m_start = std::chrono::steady_clock::now();
+	LOG(MSG_NORMAL, "Recording server traffic to %s", path);
+	return true;
+}
+
+void TraceWriter::close()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_file)
+	{
+		fclose(m_file);
+		m_file = nullptr;
+	}
+}
+
+uint64_t TraceWriter::now() const
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+void TraceWriter::record(uint32_t session, Action action, const char* request, size_t requestLength, Result result,
+	const char* response, size_t responseLength, uint64_t sentUs, uint64_t receivedUs)
+{
+	uchar			  header[TraceRecordHeader::SIZE];
+	TraceRecordHeader record = {uint32_t(action), uint32_t(result), session, uint32_t(requestLength),
+		uint32_t(responseLength), sentUs, receivedUs};
+	record.encode(header);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_file)
+	{
+		return;
+	}
+
+	fwrite(header, 1, sizeof(header), m_file);
+	fwrite(request, 1, requestLength, m_file);
+	fwrite(response, 1, responseLength, m_file);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+TraceReader::TraceReader()
+{
+}
+
+TraceReader::~TraceReader()
+{
+}
+
+bool TraceReader::open(const char* path)
+{
+	close();
+
+	if (!m_file.open(path))
+	{
+		return false;
+	}
+
+	const uchar* pos = (const uchar*)m_file.data();
+	const uchar* end = (const uchar*)m_file.end();
+
+	if (m_file.size() < TraceFileHeader::SIZE || decodeU32(pos) != TraceFileHeader::MAGIC ||
+		decodeU32(pos + 4) != TraceFileHeader::VERSION)
+	{
+		LOG(MSG_ERROR, "File %s is not a trace of supported version", path);
+		close();
+		return false;
+	}
+	pos += TraceFileHeader::SIZE;
+
+	// index of the last TURN record of every session
+	std::unordered_map<uint32_t, size_t> lastTurns;
+	while (size_t(end - pos) >= TraceRecordHeader::SIZE)
+	{
+		TraceRecordHeader header = TraceRecordHeader::decode(pos);
+		pos += TraceRecordHeader::SIZE;
+
+		if (size_t(end - pos) < size_t(header.requestLength) + header.responseLength)
+		{
+			break;
+		}
+
+		TraceRecord record;
+		record.action = Action(header.action);
+		record.result = Result(header.result);
+		record.session = header.session;
+		record.sentUs = header.sentUs;
+		record.receivedUs = header.receivedUs;
+		record.request = (const char*)pos;
+		record.requestLength = header.requestLength;
+		pos += header.requestLength;
+		record.response = (const char*)pos;
+		record.responseLength = header.responseLength;
+		pos += header.responseLength;
+
+		auto turn = lastTurns.find(record.session);
+		record.turn = turn != lastTurns.end() ? m_records[turn->second].request : nullptr;
+		record.turnLength = turn != lastTurns.end() ? m_records[turn->second].requestLength : 0;
+		if (record.action == Action::TURN)
+		{
+			lastTurns[record.session] = m_records.size();
+		}
+
+		m_index[key(record.action, record.request, record.requestLength)].push_back(m_records.size());
+		if (record.turn)
+		{
+			m_turnIndex[key(record.action, record.request, record.requestLength, record.turn, record.turnLength)]
+				.push_back(m_records.size());
+		}
+		m_records.push_back(record);
+	}
+
+	// a trace of a crashed session may end with a partial record
+	if (pos != end)
+	{
+		LOG(MSG_WARNING, "Trace %s is truncated, %u complete records loaded", path, uint(m_records.size()));
+	}
+
+	return true;
+}
+
+void TraceReader::close()
+{
+	m_records.clear();
+	m_index.clear();
+	m_turnIndex.clear();
+	m_file.close();
+}
+
+size_t TraceReader::find(Action action, const char* request, size_t requestLength, const char* turn,
+	size_t turnLength, size_t from) const
+{
+	if (turn)
+	{
+		auto it = m_turnIndex.find(key(action, request, requestLength, turn, turnLength));
+		if (it != m_turnIndex.end())
+		{
+			return find(it->second, from);
+		}
+	}
+
+	auto it = m_index.find(key(action, request, requestLength));
+	return it != m_index.end() ? find(it->second, from) : NOT_FOUND;
+}
+
+bool TraceReader::isAfterTurn(const TraceRecord& record, const char* turn, size_t turnLength)
+{
+	if (!record.turn || !turn)
+	{
+		return !record.turn && !turn;
+	}
+	return record.turnLength == turnLength && memcmp(record.turn, turn, turnLength) == 0;
+}
+
+size_t TraceReader::find(const std::vector<size_t>& records, size_t from)
+{
+	auto rec = std::lower_bound(records.begin(), records.end(), from);
+	return rec != records.end() ? *rec : records.front();
+}
+
+std::string TraceReader::key(Action action, const char* request, size_t requestLength)
+{
+	std::string result((const char*)&action, sizeof(action));
+	result.append(request, requestLength);
+	return result;
+}
+
+std::string TraceReader::key(Action action, const char* request, size_t requestLength, const char* turn,
+	size_t turnLength)
+{
+	// the request length keeps request and turn apart
+	std::string result = key(action, request, requestLength);
+	result.append((const char*)&requestLength, sizeof(requestLength));
+	result.append(turn, turnLength);
+	return result;
+}
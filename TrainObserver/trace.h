@@ -0,0 +1,120 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "defs.hpp"
+#include "mapped_file.h"
+
+// Binary trace of server traffic. The file starts with TraceFileHeader followed by records:
+// a fixed TraceRecordHeader, request payload, then response body. All integers are little-endian.
+// Records of the connections sharing a writer interleave, the session field tells them apart.
+struct TraceFileHeader
+{
+	static const size_t	  SIZE = 8;
+	static const uint32_t MAGIC = 0x52544f54; // "TOTR"
+	static const uint32_t VERSION = 2;
+};
+
+struct TraceRecordHeader
+{
+	static const size_t SIZE = 36;
+
+	uint32_t action;
+	uint32_t result;
+	// connection of the writer, a reconnect starts a new session
+	uint32_t session;
+	uint32_t requestLength;
+	uint32_t responseLength;
+	// microseconds since the trace was started
+	uint64_t sentUs;
+	uint64_t receivedUs;
+
+	void encode(uchar* out) const;
+	static TraceRecordHeader decode(const uchar* in);
+};
+
+// One request/response pair, payloads point into the mapped trace.
+struct TraceRecord
+{
+	Action		action;
+	Result		result;
+	uint32_t	session;
+	uint64_t	sentUs;
+	uint64_t	receivedUs;
+	const char* request;
+	size_t		requestLength;
+	const char* response;
+	size_t		responseLength;
+	// request of the last TURN sent before this one on the same session, nullptr before the first
+	const char* turn;
+	size_t		turnLength;
+};
+
+// Appends request/response pairs to a trace file. Several connections may share one writer.
+class TraceWriter
+{
+public:
+	TraceWriter();
+	~TraceWriter();
+	TraceWriter(const TraceWriter&) = delete;
+	TraceWriter& operator=(const TraceWriter&) = delete;
+
+	bool open(const char* path);
+	void close();
+	bool isOpen() const { return m_file != nullptr; }
+
+	// id for the records of a new connection
+	uint32_t newSession() { return m_sessions++; }
+	// timestamp for record(), microseconds since open()
+	uint64_t now() const;
+	void	 record(uint32_t session, Action action, const char* request, size_t requestLength, Result result,
+			const char* response, size_t responseLength, uint64_t sentUs, uint64_t receivedUs);
+
+private:
+	FILE*									m_file;
+	std::atomic<uint32_t>					m_sessions;
+	std::chrono::steady_clock::time_point	m_start;
+	std::mutex								m_mutex;
+};
+
+// Memory mapped trace with records indexed by their request.
+class TraceReader
+{
+public:
+	static const size_t NOT_FOUND = size_t(-1);
+
+	TraceReader();
+	~TraceReader();
+	TraceReader(const TraceReader&) = delete;
+	TraceReader& operator=(const TraceReader&) = delete;
+
+	bool open(const char* path);
+	void close();
+
+	size_t				size() const { return m_records.size(); }
+	const TraceRecord&	record(size_t idx) const { return m_records[idx]; }
+
+	// First record at or after from with the same action and request payload, wraps around the end.
+	// Records sent after the same TURN request on their session go first: a MAP request of the
+	// dynamic layer is the same for every turn, only the TURN before it tells which turn it got.
+	size_t find(Action action, const char* request, size_t requestLength, const char* turn, size_t turnLength,
+		size_t from) const;
+	static bool isAfterTurn(const TraceRecord& record, const char* turn, size_t turnLength);
+
+private:
+	static std::string key(Action action, const char* request, size_t requestLength);
+	static std::string key(Action action, const char* request, size_t requestLength, const char* turn,
+		size_t turnLength);
+	static size_t	   find(const std::vector<size_t>& records, size_t from);
+
+private:
+	MappedFile											m_file;
+	std::vector<TraceRecord>							m_records;
+	std::unordered_map<std::string, std::vector<size_t>>	m_index;
+	// same records keyed by the TURN request before them as well
+	std::unordered_map<std::string, std::vector<size_t>>	m_turnIndex;
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include <memory>
+#include <stdint.h>
+#include <stddef.h>
+#include "defs.hpp"
+
+// Native socket handle wide enough for both SOCKET (UINT_PTR) and POSIX file descriptors.
+typedef intptr_t NativeSocket;
+const NativeSocket INVALID_NATIVE_SOCKET = -1;
+
+enum IoEvent : uint
+{
+	IO_READ = 1,
+	IO_WRITE = 2,
+	IO_ERROR = 4
+};
+
+// One piece of a gathered write.
+struct IoSlice
+{
+	const char* data;
+	size_t		size;
+};
+
+enum class IoStatus
+{
+	OK,
+	WOULD_BLOCK,
+	CLOSED,
+	FAILED
+};
+
+// Byte stream to the game server. Implementations are non-blocking: read/write transfer whatever
+// is possible right now and wait() parks the caller until the stream becomes ready.
+class ITransport
+{
+public:
+	virtual ~ITransport() {}
+
+	virtual bool init() = 0;
+	virtual void reset() = 0;
+	virtual bool connect(const char* servername, uint16_t portNumber) = 0;
+	virtual bool isConnected() const = 0;
+
+	virtual IoStatus write(const char* buf, size_t nbytes, size_t& written) = 0;
+	// Gathered write of several slices with a single call. Partial writes are reported in written.
+	virtual IoStatus writev(const IoSlice* slices, size_t count, size_t& written) = 0;
+	virtual IoStatus read(char* buf, size_t nbytes, size_t& received) = 0;
+
+	// Blocks until one of IoEvent flags is signaled. timeoutMs < 0 waits forever.
+	virtual bool wait(uint events, int timeoutMs) = 0;
+
+	// Handle usable with EventLoop, INVALID_NATIVE_SOCKET for in-process transports.
+	virtual NativeSocket handle() const = 0;
+};
+
+// TCP transport for the current platform (WinSock or POSIX sockets).
+std::unique_ptr<ITransport> createSocketTransport();
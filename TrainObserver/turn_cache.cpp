@@ -0,0 +1,100 @@
+#include "turn_cache.h"
+#include "space.h"
+
+
+TurnCache::TurnCache(size_t budgetBytes)
+	: m_bytes(0)
+	, m_budget(budgetBytes)
+	, m_hits(0)
+	, m_misses(0)
+	, m_evictions(0)
+{
+}
+
+void TurnCache::setBudget(size_t budgetBytes)
+{
+	SimpleMutexHolder holder(m_mutex);
+	m_budget = budgetBytes;
+	evict();
+}
+
+void TurnCache::put(int turn, LayerPtr layer)
+{
+	size_t bytes = layer->memoryUsage();
+
+	SimpleMutexHolder holder(m_mutex);
+	auto			  it = m_entries.find(turn);
+	if (it != m_entries.end())
+	{
+		m_bytes -= it->second.bytes;
+		m_lru.erase(it->second.lru);
+		m_entries.erase(it);
+	}
+
+	m_lru.push_front(turn);
+	m_entries[turn] = Entry{layer, bytes, m_lru.begin()};
+	m_bytes += bytes;
+	evict();
+}
+
+TurnCache::LayerPtr TurnCache::get(int turn)
+{
+	SimpleMutexHolder holder(m_mutex);
+	auto			  it = m_entries.find(turn);
+	if (it == m_entries.end())
+	{
+		++m_misses;
+		return nullptr;
+	}
+
+	++m_hits;
+	m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+	return it->second.layer;
+}
+
+TurnCache::LayerPtr TurnCache::peek(int turn) const
+{
+	SimpleMutexHolder holder(m_mutex);
+	auto			  it = m_entries.find(turn);
+	return it != m_entries.end() ? it->second.layer : nullptr;
+}
+
+bool TurnCache::contains(int turn) const
+{
+	SimpleMutexHolder holder(m_mutex);
+	return m_entries.count(turn) != 0;
+}
+
+void TurnCache::clear()
+{
+	SimpleMutexHolder holder(m_mutex);
+	m_entries.clear();
+	m_lru.clear();
+	m_bytes = 0;
+}
+
+TurnCacheStats TurnCache::stats() const
+{
+	SimpleMutexHolder holder(m_mutex);
+	TurnCacheStats	  stats;
+	stats.hits = m_hits;
+	stats.misses = m_misses;
+	stats.evictions = m_evictions;
+	stats.turns = m_entries.size();
+	stats.bytes = m_bytes;
+	stats.budget = m_budget;
+	return stats;
+}
+
+void TurnCache::evict()
+{
+	// the most recent turn stays even if it alone is over the budget
+	while (m_bytes > m_budget && m_lru.size() > 1)
+	{
+		auto it = m_entries.find(m_lru.back());
+		m_bytes -= it->second.bytes;
+		m_entries.erase(it);
+		m_lru.pop_back();
+		++m_evictions;
+	}
+}
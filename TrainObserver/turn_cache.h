@@ -0,0 +1,62 @@
+#pragma once
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include "defs.hpp"
+#include "mutex.h"
+
+struct DynamicLayer;
+
+struct TurnCacheStats
+{
+	uint64_t	hits = 0;
+	uint64_t	misses = 0;
+	uint64_t	evictions = 0;
+	size_t		turns = 0;
+	size_t		bytes = 0;
+	size_t		budget = 0;
+};
+
+// Decoded turns by number. Least recently used turns are evicted once the layers take more
+// memory than the budget. Safe to use from any thread.
+class TurnCache
+{
+public:
+	typedef std::shared_ptr<const DynamicLayer> LayerPtr;
+
+	static const size_t DEFAULT_BUDGET = 256 * 1024 * 1024;
+
+	explicit TurnCache(size_t budgetBytes = DEFAULT_BUDGET);
+
+	void setBudget(size_t budgetBytes);
+	void put(int turn, LayerPtr layer);
+	// Lookup accounted as a hit or a miss, a hit makes the turn the most recently used.
+	LayerPtr get(int turn);
+	// Lookup which leaves counters and LRU order alone.
+	LayerPtr peek(int turn) const;
+	bool contains(int turn) const;
+	void clear();
+
+	TurnCacheStats stats() const;
+
+private:
+	struct Entry
+	{
+		LayerPtr				layer;
+		size_t					bytes;
+		std::list<int>::iterator	lru;
+	};
+
+	void evict();
+
+private:
+	mutable SimpleMutex				m_mutex;
+	std::unordered_map<int, Entry>	m_entries;
+	// most recently used first
+	std::list<int>					m_lru;
+	size_t							m_bytes;
+	size_t							m_budget;
+	uint64_t						m_hits;
+	uint64_t						m_misses;
+	uint64_t						m_evictions;
+};
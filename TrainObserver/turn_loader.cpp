@@ -0,0 +1,192 @@
+#include "turn_loader.h"
+
+
+TurnLoader::TurnLoader(RequestFn request, CompleteFn complete)
+	: m_request(request)
+	, m_complete(complete)
+	, m_maxInFlight(MAX_TURNS_IN_FLIGHT)
+	, m_current(-1)
+	, m_currentDropped(false)
+	, m_stop(false)
+{
+	m_worker = std::thread([this] { run(); });
+}
+
+TurnLoader::~TurnLoader()
+{
+	stop();
+}
+
+void TurnLoader::load(AsyncConnection& connection, int turn, Priority priority)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_stop || (m_current == turn && !m_currentDropped))
+	{
+		return;
+	}
+
+	for (const InFlight& flight : m_inFlight)
+	{
+		if (flight.pending.turn == turn)
+		{
+			return;
+		}
+	}
+
+	auto it = m_queued.find(turn);
+	if (it != m_queued.end())
+	{
+		it->second.priority = priority > it->second.priority ? priority : it->second.priority;
+		return;
+	}
+
+	m_queued[turn] = Queued{&connection, priority};
+	m_wakeup.notify_one();
+}
+
+bool TurnLoader::isLoading(int turn) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if ((m_current == turn && !m_currentDropped) || m_queued.count(turn) != 0)
+	{
+		return true;
+	}
+
+	for (const InFlight& flight : m_inFlight)
+	{
+		if (flight.pending.turn == turn)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void TurnLoader::setMaxInFlight(size_t turns)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_maxInFlight = turns == 0 ? 1 : turns > MAX_TURNS_IN_FLIGHT ? size_t(MAX_TURNS_IN_FLIGHT) : turns;
+	m_wakeup.notify_one();
+}
+
+void TurnLoader::retain(int first, int last)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto it = m_queued.begin(); it != m_queued.end();)
+	{
+		it = it->first < first || it->first > last ? m_queued.erase(it) : std::next(it);
+	}
+
+	// the turn the worker holds is dropped once the worker is back under the lock, requests of it
+	// which are not sent yet are cancelled right away
+	if (m_current >= 0 && (m_current < first || m_current > last))
+	{
+		m_currentDropped = true;
+		if (m_currentCancel)
+		{
+			*m_currentCancel = true;
+		}
+	}
+
+	// responses already on the wire are dropped on arrival
+	for (auto it = m_inFlight.begin(); it != m_inFlight.end();)
+	{
+		if (it->pending.turn < first || it->pending.turn > last)
+		{
+			*it->pending.cancel = true;
+			it = m_inFlight.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+	m_wakeup.notify_one();
+}
+
+void TurnLoader::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+		m_queued.clear();
+		m_currentDropped = true;
+		if (m_currentCancel)
+		{
+			*m_currentCancel = true;
+		}
+		for (InFlight& flight : m_inFlight)
+		{
+			*flight.pending.cancel = true;
+		}
+		m_inFlight.clear();
+		m_wakeup.notify_one();
+	}
+
+	if (m_worker.joinable())
+	{
+		m_worker.join();
+	}
+}
+
+void TurnLoader::run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!m_stop)
+	{
+		// keep a few turns on the wire, the highest priority and then the earliest turn goes first
+		if (!m_queued.empty() && m_inFlight.size() < m_maxInFlight)
+		{
+			auto next = m_queued.begin();
+			for (auto it = m_queued.begin(); it != m_queued.end(); ++it)
+			{
+				next = it->second.priority > next->second.priority ? it : next;
+			}
+
+			int		 turn = next->first;
+			InFlight flight;
+			flight.connection = next->second.connection;
+			m_current = turn;
+			m_queued.erase(next);
+
+			lock.unlock();
+			m_request(*flight.connection, turn, flight.pending);
+			lock.lock();
+
+			// retain() or stop() may have dropped the turn while its requests were being put on the wire
+			if (m_currentDropped || m_stop)
+			{
+				if (flight.pending.cancel)
+				{
+					*flight.pending.cancel = true;
+				}
+			}
+			else
+			{
+				m_inFlight.push_back(std::move(flight));
+			}
+			m_current = -1;
+			m_currentDropped = false;
+			continue;
+		}
+
+		if (!m_inFlight.empty())
+		{
+			InFlight flight = std::move(m_inFlight.front());
+			m_inFlight.pop_front();
+			m_current = flight.pending.turn;
+			m_currentCancel = flight.pending.cancel;
+
+			lock.unlock();
+			m_complete(*flight.connection, flight.pending);
+			lock.lock();
+
+			m_current = -1;
+			m_currentCancel.reset();
+			m_currentDropped = false;
+			continue;
+		}
+
+		m_wakeup.wait(lock);
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include "async_connection.h"
+
+// TURN + MAP requests of one turn which are on the wire
+struct PendingTurn
+{
+	int				turn = -1;
+	ResponseFuture	turnResponse;
+	ResponseFuture	mapResponse;
+	CancelFlag		cancel;
+};
+
+// Persistent worker loading turns. Queued turns go on the wire by priority, a few at a time, and
+// are decoded on the worker as their responses arrive, so callers never wait for a turn.
+class TurnLoader
+{
+public:
+	enum Priority
+	{
+		PREFETCH,
+		// turns on display go before any prefetch
+		DISPLAY,
+	};
+
+	// puts the requests of the turn on the wire
+	typedef std::function<void(AsyncConnection& connection, int turn, PendingTurn& pending)> RequestFn;
+	// waits for the responses, decodes and keeps the turn
+	typedef std::function<void(AsyncConnection& connection, PendingTurn& pending)> CompleteFn;
+
+	// every turn takes a TURN and a MAP slot of the connection window
+	static const size_t MAX_TURNS_IN_FLIGHT = ConnectionManager::MAX_PENDING_REQUESTS / 2;
+
+	TurnLoader(RequestFn request, CompleteFn complete);
+	~TurnLoader();
+	TurnLoader(const TurnLoader&) = delete;
+	TurnLoader& operator=(const TurnLoader&) = delete;
+
+	// Queues the turn unless it is queued or loading, a queued turn is raised to a higher priority.
+	void load(AsyncConnection& connection, int turn, Priority priority);
+	bool isLoading(int turn) const;
+	// Turns put on the wire at once, bounded by MAX_TURNS_IN_FLIGHT. Later turns stay queued, so a
+	// turn put on display gets ahead of them.
+	void setMaxInFlight(size_t turns);
+	// Drops the turns outside of [first, last], the requests of those on the wire are cancelled.
+	void retain(int first, int last);
+	// Cancels everything and joins the worker.
+	void stop();
+
+private:
+	struct Queued
+	{
+		AsyncConnection*	connection;
+		Priority			priority;
+	};
+
+	struct InFlight
+	{
+		AsyncConnection*	connection;
+		PendingTurn			pending;
+	};
+
+	void run();
+
+private:
+	RequestFn						m_request;
+	CompleteFn						m_complete;
+	std::thread						m_worker;
+
+	mutable std::mutex				m_mutex;
+	std::condition_variable			m_wakeup;
+	std::map<int, Queued>			m_queued;
+	std::deque<InFlight>			m_inFlight;
+	size_t							m_maxInFlight;
+	// turn the worker requests or decodes outside of the lock, -1 if none
+	int								m_current;
+	// flag of m_current once its requests are on the wire
+	CancelFlag						m_currentCancel;
+	// m_current left the retained range, it is cancelled instead of kept
+	bool							m_currentDropped;
+	bool							m_stop;
+};
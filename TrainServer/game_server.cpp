@@ -0,0 +1,360 @@
+#include "game_server.h"
+#include "log_interface.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+
+#ifdef _WIN32
+
+#define NOMINMAX
+#include <winsock2.h>
+#include <Ws2tcpip.h>
+
+#define SOCKET_LAST_ERROR WSAGetLastError()
+#define SOCKET_WOULD_BLOCK(err) ((err) == WSAEWOULDBLOCK)
+#define SEND_FLAGS 0
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#define SOCKET_LAST_ERROR errno
+#define SOCKET_WOULD_BLOCK(err) ((err) == EAGAIN || (err) == EWOULDBLOCK)
+#define SEND_FLAGS MSG_NOSIGNAL
+#define SOCKET_ERROR (-1)
+
+#endif
+
+namespace
+{
+const int	 LISTEN_BACKLOG = 64;
+const size_t RECEIVE_CHUNK = 64 * 1024;
+// the loop wakes up at least this often to notice stop()
+const int	 MAX_POLL_TIMEOUT_MS = 100;
+// bytes a throttled connection may send at once, keeps the rate smooth without tiny writes
+const double MIN_BURST = 16 * 1024;
+
+#ifdef _WIN32
+bool startupSockets()
+{
+	WSADATA wsaData;
+	return WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+}
+
+void cleanupSockets()
+{
+	WSACleanup();
+}
+
+void closeNative(NativeSocket s)
+{
+	closesocket(SOCKET(s));
+}
+
+bool setNonBlocking(NativeSocket s)
+{
+	u_long mode = 1;
+	return ioctlsocket(SOCKET(s), FIONBIO, &mode) == 0;
+}
+#else
+bool startupSockets()
+{
+	return true;
+}
+
+void cleanupSockets()
+{
+}
+
+void closeNative(NativeSocket s)
+{
+	::close(int(s));
+}
+
+bool setNonBlocking(NativeSocket s)
+{
+	int flags = fcntl(int(s), F_GETFL, 0);
+	return flags >= 0 && fcntl(int(s), F_SETFL, flags | O_NONBLOCK) == 0;
+}
+#endif
+} // namespace
+
+GameServer::GameServer(ProtocolFactory factory, const NetworkProfile& profile)
+	: m_factory(factory)
+	, m_profile(profile)
+	, m_listener(INVALID_NATIVE_SOCKET)
+	, m_stop(false)
+	, m_random(std::random_device()())
+	, m_bytesReceived(0)
+	, m_bytesSent(0)
+	, m_connections(0)
+{
+	startupSockets();
+}
+
+GameServer::~GameServer()
+{
+	for (auto& s : m_sessions)
+	{
+		closeNative(s.first);
+	}
+	m_sessions.clear();
+
+	if (m_listener != INVALID_NATIVE_SOCKET)
+	{
+		closeNative(m_listener);
+	}
+
+	m_loop.reset();
+	cleanupSockets();
+}
+
+bool GameServer::listen(uint16_t portNumber)
+{
+	if (!m_loop.init())
+	{
+		LOG(MSG_ERROR, "Failed to create event loop");
+		return false;
+	}
+
+	m_listener = NativeSocket(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+	if (m_listener == INVALID_NATIVE_SOCKET)
+	{
+		LOG(MSG_ERROR, "socket failed with error: %d", SOCKET_LAST_ERROR);
+		return false;
+	}
+
+	int reuse = 1;
+	setsockopt(m_listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(portNumber);
+
+	if (::bind(m_listener, (const sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+		::listen(m_listener, LISTEN_BACKLOG) == SOCKET_ERROR || !setNonBlocking(m_listener))
+	{
+		LOG(MSG_ERROR, "Cannot listen on port %d: %d", portNumber, SOCKET_LAST_ERROR);
+		return false;
+	}
+
+	m_loop.add(m_listener, IO_READ, [this](uint) { accept(); });
+
+	LOG(MSG_NORMAL, "Listening on port %d. Latency %u ms, jitter %u ms, bandwidth %u B/s", portNumber,
+		m_profile.latencyMs, m_profile.jitterMs, m_profile.bandwidth);
+	return true;
+}
+
+void GameServer::run()
+{
+	while (!m_stop)
+	{
+		if (m_loop.poll(nextTimeout(now())) < 0)
+		{
+			LOG(MSG_ERROR, "Event loop failed");
+			break;
+		}
+
+		uint64_t time = now();
+		for (auto it = m_sessions.begin(); it != m_sessions.end();)
+		{
+			Session& session = *it->second;
+			if (!session.closed)
+			{
+				flush(session, time);
+			}
+
+			if (session.closed)
+			{
+				m_loop.remove(session.socket);
+				closeNative(session.socket);
+				it = m_sessions.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	LOG(MSG_NORMAL, "Server stopped. Connections: %llu, received: %llu bytes, sent: %llu bytes",
+		(unsigned long long)m_connections, (unsigned long long)m_bytesReceived, (unsigned long long)m_bytesSent);
+}
+
+void GameServer::accept()
+{
+	for (;;)
+	{
+		NativeSocket s = NativeSocket(::accept(m_listener, nullptr, nullptr));
+		if (s == INVALID_NATIVE_SOCKET)
+		{
+			return;
+		}
+
+		int noDelay = 1;
+		setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+		setNonBlocking(s);
+
+		std::unique_ptr<Session> session(new Session());
+		session->socket = s;
+		session->protocol = m_factory();
+		session->lastDueUs = 0;
+		session->budget = 0.0;
+		session->budgetUs = now();
+		session->events = IO_READ;
+		session->closed = false;
+
+		Session* pSession = session.get();
+		m_sessions[s] = std::move(session);
+		m_loop.add(s, IO_READ, [this, pSession](uint events) {
+			if (events & (IO_READ | IO_ERROR))
+				receive(*pSession);
+			if ((events & IO_WRITE) && !pSession->closed)
+				flush(*pSession, now());
+		});
+
+		++m_connections;
+	}
+}
+
+void GameServer::receive(Session& session)
+{
+	char buf[RECEIVE_CHUNK];
+	for (;;)
+	{
+		int received = ::recv(session.socket, buf, int(sizeof(buf)), 0);
+		if (received == 0)
+		{
+			close(session);
+			return;
+		}
+
+		if (received < 0)
+		{
+			if (!SOCKET_WOULD_BLOCK(SOCKET_LAST_ERROR))
+			{
+				close(session);
+			}
+			return;
+		}
+
+		m_bytesReceived += uint64_t(received);
+
+		Chunk chunk = {0, std::string(), 0};
+		if (!session.protocol->process(buf, size_t(received), chunk.data))
+		{
+			close(session);
+			return;
+		}
+
+		if (!chunk.data.empty())
+		{
+			// jitter must not reorder the stream
+			uint64_t delay = uint64_t(m_profile.latencyMs) * 1000;
+			if (m_profile.jitterMs > 0)
+			{
+				delay += std::uniform_int_distribution<uint64_t>(0, uint64_t(m_profile.jitterMs) * 1000)(m_random);
+			}
+			chunk.dueUs = std::max(now() + delay, session.lastDueUs);
+			session.lastDueUs = chunk.dueUs;
+			session.outgoing.push_back(std::move(chunk));
+		}
+	}
+}
+
+void GameServer::flush(Session& session, uint64_t time)
+{
+	bool blocked = false;
+	while (!session.outgoing.empty() && session.outgoing.front().dueUs <= time)
+	{
+		Chunk& chunk = session.outgoing.front();
+		size_t size = chunk.data.size() - chunk.sent;
+
+		if (m_profile.bandwidth > 0)
+		{
+			double burst = std::max(MIN_BURST, m_profile.bandwidth / 10.0);
+			session.budget = std::min(burst, session.budget + (time - session.budgetUs) * m_profile.bandwidth / 1e6);
+			session.budgetUs = time;
+			if (session.budget < 1.0)
+			{
+				break;
+			}
+			size = std::min(size, size_t(session.budget));
+		}
+
+		int sent = ::send(session.socket, chunk.data.data() + chunk.sent, int(size), SEND_FLAGS);
+		if (sent < 0)
+		{
+			if (SOCKET_WOULD_BLOCK(SOCKET_LAST_ERROR))
+			{
+				blocked = true;
+			}
+			else
+			{
+				close(session);
+				return;
+			}
+			break;
+		}
+
+		m_bytesSent += uint64_t(sent);
+		session.budget -= sent;
+		chunk.sent += size_t(sent);
+		if (chunk.sent == chunk.data.size())
+		{
+			session.outgoing.pop_front();
+		}
+	}
+
+	updateEvents(session, blocked ? IO_READ | IO_WRITE : IO_READ);
+}
+
+void GameServer::close(Session& session)
+{
+	session.closed = true;
+	session.outgoing.clear();
+}
+
+void GameServer::updateEvents(Session& session, uint events)
+{
+	if (session.events != events)
+	{
+		session.events = events;
+		m_loop.modify(session.socket, events);
+	}
+}
+
+int GameServer::nextTimeout(uint64_t time) const
+{
+	int timeout = MAX_POLL_TIMEOUT_MS;
+	for (const auto& s : m_sessions)
+	{
+		const Session& session = *s.second;
+		if (session.outgoing.empty() || (session.events & IO_WRITE))
+		{
+			continue;
+		}
+
+		// throttled sessions wake up every millisecond to refill their budget
+		uint64_t due = session.outgoing.front().dueUs;
+		int		 wait = due > time ? int((due - time + 999) / 1000) : (m_profile.bandwidth > 0 ? 1 : 0);
+		timeout = std::min(timeout, wait);
+	}
+
+	return timeout;
+}
+
+uint64_t GameServer::now() const
+{
+	using namespace std::chrono;
+	return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
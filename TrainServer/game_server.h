@@ -0,0 +1,80 @@
+#pragma once
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include "event_loop.h"
+#include "loopback_transport.h"
+
+// Network conditions applied to every connection.
+struct NetworkProfile
+{
+	// delay of each response batch, jitter is added uniformly on top of it
+	uint latencyMs = 0;
+	uint jitterMs = 0;
+	// per connection send rate, 0 is unlimited
+	uint bandwidth = 0;
+};
+
+// Headless TCP server speaking the game protocol. Every connection gets its own protocol
+// state from the factory, responses are shaped according to the network profile.
+class GameServer
+{
+public:
+	typedef std::function<std::unique_ptr<LoopbackServer>()> ProtocolFactory;
+
+	GameServer(ProtocolFactory factory, const NetworkProfile& profile);
+	~GameServer();
+	GameServer(const GameServer&) = delete;
+	GameServer& operator=(const GameServer&) = delete;
+
+	bool listen(uint16_t portNumber);
+	// Serves connections until stop() is called.
+	void run();
+	void stop() { m_stop = true; }
+
+private:
+	struct Chunk
+	{
+		uint64_t	dueUs;
+		std::string data;
+		size_t		sent;
+	};
+
+	struct Session
+	{
+		NativeSocket					socket;
+		std::unique_ptr<LoopbackServer>	protocol;
+		std::deque<Chunk>				outgoing;
+		uint64_t						lastDueUs;
+		double							budget;
+		uint64_t						budgetUs;
+		uint							events;
+		bool							closed;
+	};
+
+	void accept();
+	void receive(Session& session);
+	void flush(Session& session, uint64_t now);
+	void close(Session& session);
+	void updateEvents(Session& session, uint events);
+	int	 nextTimeout(uint64_t now) const;
+	uint64_t now() const;
+
+private:
+	ProtocolFactory		m_factory;
+	NetworkProfile		m_profile;
+	EventLoop			m_loop;
+	NativeSocket		m_listener;
+	std::atomic<bool>	m_stop;
+	std::mt19937		m_random;
+
+	std::unordered_map<NativeSocket, std::unique_ptr<Session>> m_sessions;
+
+	uint64_t m_bytesReceived;
+	uint64_t m_bytesSent;
+	uint64_t m_connections;
+};
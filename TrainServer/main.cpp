@@ -0,0 +1,174 @@
+#include <memory>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "game_server.h"
+#include "log_interface.h"
+#include "payload_bench.h"
+#include "replay_check.h"
+#include "replay_transport.h"
+#include "synthetic_game.h"
+#include "trace.h"
+
+const uint16_t DEFAULT_PORT = 2000;
+const char*	   REPLAY_CHECK_TRACE = "replay_check.trace";
+
+static GameServer* g_server = nullptr;
+
+static void onSignal(int)
+{
+	if (g_server)
+	{
+		g_server->stop();
+	}
+}
+
+static void usage()
+{
+	printf("Stand-in game server for TrainObserver.\n"
+		   "Usage: TrainServer [options]\n"
+		   "  --port <n>         listening port, %d by default\n"
+		   "  --trace <file>     serve a game recorded by TrainObserver -record\n"
+		   "  --games <n>        synthetic games to offer\n"
+		   "  --turns <n>        length of synthetic games\n"
+		   "  --points <n>       points on the synthetic map\n"
+		   "  --trains <n>       trains in the synthetic game\n"
+		   "  --players <n>      players in the synthetic game\n"
+		   "  --latency <ms>     delay of every response\n"
+		   "  --jitter <ms>      random delay added on top of latency\n"
+		   "  --bandwidth <B/s>  send rate of each connection\n"
+		   "  --bench <rounds>   time parsing of the MAP payloads of the game or trace and exit\n"
+		   "  --replay-check <sessions>\n"
+		   "                     record the synthetic game over several sessions, replay it, compare and exit\n",
+		DEFAULT_PORT);
+}
+
+int main(int argc, char* argv[])
+{
+	uint16_t			port = DEFAULT_PORT;
+	std::string			tracePath;
+	SyntheticGameConfig config;
+	NetworkProfile		profile;
+	uint				benchRounds = 0;
+	uint				replaySessions = 0;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* name = argv[i];
+		if (strcmp(name, "--help") == 0 || i + 1 >= argc)
+		{
+			usage();
+			return strcmp(name, "--help") == 0 ? 0 : 1;
+		}
+
+		const char* value = argv[++i];
+		uint		number = uint(strtoul(value, nullptr, 10));
+
+		if (strcmp(name, "--port") == 0)
+			port = uint16_t(number);
+		else if (strcmp(name, "--trace") == 0)
+			tracePath = value;
+		else if (strcmp(name, "--games") == 0)
+			config.games = number;
+		else if (strcmp(name, "--turns") == 0)
+			config.turns = number;
+		else if (strcmp(name, "--points") == 0)
+			config.points = number;
+		else if (strcmp(name, "--trains") == 0)
+			config.trains = number;
+		else if (strcmp(name, "--players") == 0)
+			config.players = number;
+		else if (strcmp(name, "--latency") == 0)
+			profile.latencyMs = number;
+		else if (strcmp(name, "--jitter") == 0)
+			profile.jitterMs = number;
+		else if (strcmp(name, "--bandwidth") == 0)
+			profile.bandwidth = number;
+		else if (strcmp(name, "--bench") == 0)
+			benchRounds = number;
+		else if (strcmp(name, "--replay-check") == 0)
+			replaySessions = number;
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	GameServer::ProtocolFactory factory;
+	if (!tracePath.empty())
+	{
+		auto trace = std::make_shared<TraceReader>();
+		if (!trace->open(tracePath.c_str()))
+		{
+			return 1;
+		}
+
+		if (benchRounds > 0)
+		{
+			std::vector<BenchPayload> payloads;
+			for (size_t i = 0; i < trace->size(); ++i)
+			{
+				const TraceRecord& record = trace->record(i);
+				if (record.action == Action::MAP && record.result == Result::OKEY)
+				{
+					payloads.push_back(BenchPayload{"MAP " + std::string(record.request, record.requestLength),
+						record.response, record.response + record.responseLength});
+				}
+			}
+			runPayloadBench(payloads, benchRounds);
+			return 0;
+		}
+
+		LOG(MSG_NORMAL, "Serving %u recorded requests from %s", uint(trace->size()), tracePath.c_str());
+		factory = [trace] { return std::unique_ptr<LoopbackServer>(new ReplayServer(trace)); };
+	}
+	else
+	{
+		auto game = std::make_shared<SyntheticGame>(config);
+
+		if (replaySessions > 0)
+		{
+			bool same = runReplayCheck(game, replaySessions, REPLAY_CHECK_TRACE);
+			remove(REPLAY_CHECK_TRACE);
+			return same ? 0 : 1;
+		}
+
+		if (benchRounds > 0)
+		{
+			std::string dynamic;
+			game->dynamicLayer(1, dynamic);
+
+			const std::string* layers[] = {&game->staticLayer(), &game->coordinatesLayer(), &dynamic};
+			const char*		   names[] = {"STATIC", "COORDINATES", "DYNAMIC"};
+			std::vector<BenchPayload> payloads;
+			for (size_t i = 0; i < 3; ++i)
+			{
+				payloads.push_back(BenchPayload{names[i], layers[i]->data(), layers[i]->data() + layers[i]->size()});
+			}
+			runPayloadBench(payloads, benchRounds);
+			return 0;
+		}
+
+		LOG(MSG_NORMAL, "Serving synthetic games: %u turns, %u points, %u trains", config.turns, config.points,
+			config.trains);
+		factory = [game] { return std::unique_ptr<LoopbackServer>(new SyntheticGameServer(game)); };
+	}
+
+	GameServer server(factory, profile);
+	if (!server.listen(port))
+	{
+		return 1;
+	}
+
+	g_server = &server;
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+
+	server.run();
+
+	g_server = nullptr;
+	return 0;
+}
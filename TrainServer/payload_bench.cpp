@@ -0,0 +1,189 @@
+#include "payload_bench.h"
+#include "json_query_builder.h"
+
+#include <chrono>
+#include <stdio.h>
+
+namespace
+{
+// arrays of the MAP layers and the members the observer reads from their items
+struct BenchArray
+{
+	const char* name;
+	const char* members[12];
+};
+
+const BenchArray BENCH_ARRAYS[] = {
+	{"lines", {"idx", "length", "points"}},
+	{"points", {"idx", "post_idx"}},
+	{"coordinates", {"idx", "x", "y"}},
+	{"trains",
+		{"idx", "line_idx", "position", "cooldown", "goods", "goods_capacity", "speed", "level", "player_idx"}},
+	{"posts",
+		{"idx", "armor", "armor_capacity", "level", "population", "population_capacity", "product",
+			"product_capacity", "type", "name", "player_idx"}},
+	{"ratings", {"idx", "name", "rating"}},
+};
+
+// records of the DYNAMIC layer as the observer binds them, strings are kept as their length
+// because the pool the observer interns them into is not part of the server
+struct BenchTrain
+{
+	uint idx, line_idx, position, cooldown, goods, goods_capacity, level;
+	int	 speed;
+	size_t player;
+};
+
+struct BenchPost
+{
+	uint idx, armor, armor_capacity, level, population, population_capacity, product, product_capacity, type;
+	size_t name, player;
+};
+
+struct BenchRating
+{
+	uint	rating;
+	size_t	idx, name;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsedMs(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// members found, so the lookups can not be optimized away
+template <typename Lookup>
+size_t readMembers(const JSONQueryReader& root, Lookup lookup)
+{
+	size_t found = 0;
+	for (const BenchArray& array : BENCH_ARRAYS)
+	{
+		for (JSONQueryReader item : root.getValue(array.name).asArray())
+		{
+			for (size_t m = 0; m < sizeof(array.members) / sizeof(array.members[0]) && array.members[m]; ++m)
+			{
+				found += lookup(item, array, m).isValid() ? 1 : 0;
+			}
+		}
+	}
+	return found;
+}
+
+// Streams the payload through JSONRecordReader the way Space::parseDynamicLayer does, no tree is
+// built. Returns the records filled, or -1 with the error when the payload is not valid JSON.
+long readRecords(const BenchPayload& payload, std::string& error)
+{
+	long records = 0;
+
+	JSONRecordBinding<BenchTrain> trains([&records](const BenchTrain&) { ++records; });
+	trains.field("idx", &BenchTrain::idx)
+		.field("line_idx", &BenchTrain::line_idx)
+		.field("position", &BenchTrain::position)
+		.field("cooldown", &BenchTrain::cooldown)
+		.field("goods", &BenchTrain::goods)
+		.field("goods_capacity", &BenchTrain::goods_capacity)
+		.field("speed", &BenchTrain::speed)
+		.field("level", &BenchTrain::level)
+		.field("player_idx", [](BenchTrain& train, const char* first, const char* last) { train.player = size_t(last - first); });
+
+	JSONRecordBinding<BenchPost> posts([&records](const BenchPost&) { ++records; });
+	posts.field("idx", &BenchPost::idx)
+		.field("armor", &BenchPost::armor)
+		.field("armor_capacity", &BenchPost::armor_capacity)
+		.field("level", &BenchPost::level)
+		.field("population", &BenchPost::population)
+		.field("population_capacity", &BenchPost::population_capacity)
+		.field("product", &BenchPost::product)
+		.field("product_capacity", &BenchPost::product_capacity)
+		.field("type", &BenchPost::type)
+		.field("name", [](BenchPost& post, const char* first, const char* last) { post.name = size_t(last - first); })
+		.field("player_idx", [](BenchPost& post, const char* first, const char* last) { post.player = size_t(last - first); });
+
+	JSONRecordBinding<BenchRating> ratings([&records](const BenchRating&) { ++records; });
+	ratings.field("idx", [](BenchRating& rating, const char* first, const char* last) { rating.idx = size_t(last - first); })
+		.field("name", [](BenchRating& rating, const char* first, const char* last) { rating.name = size_t(last - first); })
+		.field("rating", &BenchRating::rating);
+
+	JSONRecordReader reader;
+	reader.bind("trains", trains);
+	reader.bind("posts", posts);
+	reader.bind("ratings", ratings);
+	if (!reader.parse(payload.begin, payload.end))
+	{
+		error = reader.error();
+		return -1;
+	}
+	return records;
+}
+} // namespace
+
+void runPayloadBench(const std::vector<BenchPayload>& payloads, uint rounds)
+{
+	rounds = rounds > 0 ? rounds : 1;
+
+	std::vector<std::vector<Json::Key>> keys;
+	for (const BenchArray& array : BENCH_ARRAYS)
+	{
+		keys.emplace_back();
+		for (size_t m = 0; m < sizeof(array.members) / sizeof(array.members[0]) && array.members[m]; ++m)
+		{
+			keys.back().emplace_back(array.members[m]);
+		}
+	}
+
+	printf("%-24s %10s %10s %10s %10s %10s %10s %10s\n", "payload", "bytes", "parse ms", "names ms", "keys ms", "lookups",
+		"records ms", "records");
+	for (const BenchPayload& payload : payloads)
+	{
+		JSONDocument document;
+		double		 parseMs = 0.0, namesMs = 0.0, keysMs = 0.0, recordsMs = 0.0;
+		size_t		 lookups = 0;
+		long		 records = 0;
+		std::string	 error;
+
+		for (uint r = 0; r < rounds; ++r)
+		{
+			Clock::time_point start = Clock::now();
+			if (!document.parse(payload.begin, payload.end))
+			{
+				printf("%-24s failed to parse: %s\n", payload.name.c_str(), document.error().c_str());
+				break;
+			}
+			parseMs += elapsedMs(start);
+
+			start = Clock::now();
+			lookups = readMembers(document.root(), [](const JSONQueryReader& item, const BenchArray& array, size_t m) {
+				return item.getValue(array.members[m]);
+			});
+			namesMs += elapsedMs(start);
+
+			start = Clock::now();
+			size_t byKey = readMembers(document.root(), [&](const JSONQueryReader& item, const BenchArray& array, size_t m) {
+				return item.getValue(keys[&array - BENCH_ARRAYS][m]);
+			});
+			keysMs += elapsedMs(start);
+
+			if (byKey != lookups)
+			{
+				printf("%-24s lookups by key differ: %u of %u\n", payload.name.c_str(), uint(byKey), uint(lookups));
+				break;
+			}
+
+			// the path the observer takes for DYNAMIC, other layers have no bound arrays and are only scanned
+			start = Clock::now();
+			records = readRecords(payload, error);
+			recordsMs += elapsedMs(start);
+			if (records < 0)
+			{
+				printf("%-24s failed to read records: %s\n", payload.name.c_str(), error.c_str());
+				break;
+			}
+		}
+
+		printf("%-24s %10u %10.3f %10.3f %10.3f %10u %10.3f %10ld\n", payload.name.c_str(),
+			uint(payload.end - payload.begin), parseMs / rounds, namesMs / rounds, keysMs / rounds, uint(lookups),
+			recordsMs / rounds, records);
+	}
+}
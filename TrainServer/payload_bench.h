@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "defs.hpp"
+
+// MAP response to measure, the text has to outlive the bench.
+struct BenchPayload
+{
+	std::string name;
+	const char* begin;
+	const char* end;
+};
+
+// Parses every payload the given number of times and reads the members the observer reads from
+// each item of its arrays, once by name and once by precomputed key. Then streams it through the
+// record reader the observer uses for DYNAMIC layers. Prints a line per payload.
+void runPayloadBench(const std::vector<BenchPayload>& payloads, uint rounds);
@@ -0,0 +1,120 @@
+#include "replay_check.h"
+#include "buffer_pool.h"
+#include "game_downloader.h"
+#include "replay_transport.h"
+#include "synthetic_game.h"
+#include "trace.h"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <stdio.h>
+
+namespace
+{
+const uint CHECKED_GAME = 1;
+// delay of every read while recording, so that responses of the sessions interleave like on a network
+const int RECORD_READ_DELAY_US = 50;
+
+class DelayedTransport : public ITransport
+{
+public:
+	explicit DelayedTransport(std::unique_ptr<ITransport> transport)
+		: m_transport(std::move(transport))
+	{
+	}
+
+	bool init() override { return m_transport->init(); }
+	void reset() override { m_transport->reset(); }
+	bool connect(const char* servername, uint16_t portNumber) override
+	{
+		return m_transport->connect(servername, portNumber);
+	}
+	bool isConnected() const override { return m_transport->isConnected(); }
+
+	IoStatus write(const char* buf, size_t nbytes, size_t& written) override
+	{
+		return m_transport->write(buf, nbytes, written);
+	}
+	IoStatus writev(const IoSlice* slices, size_t count, size_t& written) override
+	{
+		return m_transport->writev(slices, count, written);
+	}
+	IoStatus read(char* buf, size_t nbytes, size_t& received) override
+	{
+		std::this_thread::sleep_for(std::chrono::microseconds(RECORD_READ_DELAY_US));
+		return m_transport->read(buf, nbytes, received);
+	}
+	bool wait(uint events, int timeoutMs) override { return m_transport->wait(events, timeoutMs); }
+
+	NativeSocket handle() const override { return m_transport->handle(); }
+
+private:
+	std::unique_ptr<ITransport> m_transport;
+};
+
+// Downloads all turns of the game through transports of the factory, returns bodies by turn.
+bool download(GameDownloader::TransportFactory factory, std::shared_ptr<TraceWriter> trace, int lastTurn,
+	uint sessions, std::vector<std::string>& bodies)
+{
+	std::mutex mutex;
+	bodies.assign(size_t(lastTurn) + 1, std::string());
+
+	GameDownloader downloader(factory);
+	downloader.setTrace(trace);
+	bool started = downloader.start("loopback", 0, CHECKED_GAME, 0, lastTurn, sessions,
+		[&](int turn, const MessageBuffer& body) {
+			std::lock_guard<std::mutex> lock(mutex);
+			bodies[turn].assign(body.data(), body.size());
+			return true;
+		});
+	downloader.wait();
+
+	DownloadProgress progress = downloader.progress();
+	return started && progress.loaded == progress.total;
+}
+} // namespace
+
+bool runReplayCheck(std::shared_ptr<const SyntheticGame> game, uint sessions, const char* tracePath)
+{
+	int lastTurn = int(game->config().turns);
+
+	auto writer = std::make_shared<TraceWriter>();
+	if (!writer->open(tracePath))
+	{
+		return false;
+	}
+
+	std::vector<std::string> recorded;
+	bool					 loaded = download(
+		[game] {
+			return std::unique_ptr<ITransport>(new DelayedTransport(std::unique_ptr<ITransport>(
+				new LoopbackTransport(std::make_shared<SyntheticGameServer>(game)))));
+		},
+		writer, lastTurn, sessions, recorded);
+	writer->close();
+	if (!loaded)
+	{
+		printf("recording of %d turns over %u sessions failed\n", lastTurn + 1, sessions);
+		return false;
+	}
+
+	auto reader = std::make_shared<TraceReader>();
+	if (!reader->open(tracePath))
+	{
+		return false;
+	}
+
+	std::vector<std::string> replayed;
+	loaded = download([reader] { return createReplayTransport(reader); }, nullptr, lastTurn, sessions, replayed);
+
+	uint differ = 0;
+	for (int turn = 0; turn <= lastTurn; ++turn)
+	{
+		differ += recorded[turn] != replayed[turn] ? 1 : 0;
+	}
+
+	printf("%d turns over %u sessions, %u records in the trace: %u turns differ after replay\n", lastTurn + 1,
+		sessions, uint(reader->size()), differ);
+	return loaded && differ == 0;
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <memory>
+#include "defs.hpp"
+
+class SyntheticGame;
+
+// Downloads every turn of the synthetic game over several sessions while recording them to the
+// trace, then downloads them again from the replayed trace and compares each turn body.
+// Prints the outcome, returns false if any turn differs or fails to load.
+bool runReplayCheck(std::shared_ptr<const SyntheticGame> game, uint sessions, const char* tracePath);
@@ -0,0 +1,22 @@
+#include "log_interface.h"
+
+#if ENABLE_LOG
+
+#include <stdarg.h>
+#include <stdio.h>
+
+// the server has no windows, everything goes to the console
+void log(OutputImportance priority, const char* msg, ...)
+{
+	static const char* prefixes[] = {"[INFO]", "[WARNING]", "[ERROR]"};
+
+	char	buffer[2000];
+	va_list argList;
+	va_start(argList, msg);
+	vsnprintf(buffer, sizeof(buffer), msg, argList);
+	va_end(argList);
+
+	fprintf(priority == MSG_NORMAL ? stdout : stderr, "%s %s\n", prefixes[priority], buffer);
+}
+
+#endif
@@ -0,0 +1,216 @@
+#include "synthetic_game.h"
+#include "json_query_builder.h"
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+// distance between neighbour points of the grid in map units
+const uint GRID_STEP = 100;
+
+// appends printf formatted text to the document
+static void append(std::string& out, const char* format, ...)
+{
+	char	buf[512];
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(buf, sizeof(buf), format, args);
+	va_end(args);
+
+	if (length > 0)
+	{
+		out.append(buf, size_t(length) < sizeof(buf) ? size_t(length) : sizeof(buf) - 1);
+	}
+}
+
+// member of a request payload, zero if it is missing or the payload is damaged
+template <typename T>
+static T requestField(const std::string& request, const char* name)
+{
+	JSONDocument document;
+	document.parse(request);
+	return document.root().get<T>(name);
+}
+
+SyntheticGame::SyntheticGame(const SyntheticGameConfig& config)
+	: m_config(config)
+	, m_side(uint(ceil(sqrt(double(config.points > 1 ? config.points : 2)))))
+	, m_posts(0)
+{
+	m_config.points = config.points > 1 ? config.points : 2;
+	m_config.players = config.players > 0 ? config.players : 1;
+	m_config.postFrequency = config.postFrequency > 0 ? config.postFrequency : 1;
+
+	// points are laid out row by row, every point is connected to its right and bottom neighbours
+	for (uint p = 0; p < m_config.points; ++p)
+	{
+		if ((p + 1) % m_side != 0 && p + 1 < m_config.points)
+		{
+			m_lines.push_back({3 + p % 5, p + 1, p + 2});
+		}
+		if (p + m_side < m_config.points)
+		{
+			m_lines.push_back({3 + (p + 2) % 5, p + 1, p + m_side + 1});
+		}
+	}
+	m_posts = (m_config.points + m_config.postFrequency - 1) / m_config.postFrequency;
+
+	buildGames();
+	buildStatic();
+	buildCoordinates();
+}
+
+void SyntheticGame::buildGames()
+{
+	m_games = "{\"games\":[";
+	for (uint g = 1; g <= m_config.games; ++g)
+	{
+		append(m_games, "%s{\"idx\":%u,\"name\":\"synthetic-%u\",\"length\":%u,\"num_players\":%u,\"state\":3}",
+			g > 1 ? "," : "", g, g, m_config.turns, m_config.players);
+	}
+	m_games += "]}";
+}
+
+void SyntheticGame::buildStatic()
+{
+	m_static = "{\"idx\":1,\"name\":\"synthetic\",\"lines\":[";
+	for (size_t l = 0; l < m_lines.size(); ++l)
+	{
+		append(m_static, "%s{\"idx\":%u,\"length\":%u,\"points\":[%u,%u]}", l > 0 ? "," : "", uint(l + 1),
+			m_lines[l].length, m_lines[l].pid_1, m_lines[l].pid_2);
+	}
+
+	m_static += "],\"points\":[";
+	for (uint p = 0; p < m_config.points; ++p)
+	{
+		uint post = p % m_config.postFrequency == 0 ? p / m_config.postFrequency + 1 : 0;
+		if (post)
+			append(m_static, "%s{\"idx\":%u,\"post_idx\":%u}", p > 0 ? "," : "", p + 1, post);
+		else
+			append(m_static, "%s{\"idx\":%u,\"post_idx\":null}", p > 0 ? "," : "", p + 1);
+	}
+	m_static += "]}";
+}
+
+void SyntheticGame::buildCoordinates()
+{
+	m_coordinates = "{\"idx\":1,\"coordinates\":[";
+	for (uint p = 0; p < m_config.points; ++p)
+	{
+		append(m_coordinates, "%s{\"idx\":%u,\"x\":%u,\"y\":%u}", p > 0 ? "," : "", p + 1,
+			GRID_STEP / 2 + (p % m_side) * GRID_STEP, GRID_STEP / 2 + (p / m_side) * GRID_STEP);
+	}
+	append(m_coordinates, "],\"size\":[%u,%u]}", m_side * GRID_STEP, m_side * GRID_STEP);
+}
+
+void SyntheticGame::dynamicLayer(int turn, std::string& out) const
+{
+	out = "{\"idx\":1,\"trains\":[";
+	for (uint t = 0; t < m_config.trains; ++t)
+	{
+		// every train runs back and forth on its line, moving to the next line after each round
+		uint		lineIdx = (t * 7 + uint(turn) / 16) % uint(m_lines.size());
+		const Line& line = m_lines[lineIdx];
+		uint		phase = (uint(turn) + t) % (2 * line.length);
+		bool		forward = phase < line.length;
+		uint		position = forward ? phase : 2 * line.length - phase;
+
+		append(out,
+			"%s{\"idx\":%u,\"line_idx\":%u,\"position\":%u,\"speed\":%d,\"cooldown\":0,\"goods\":%u,"
+			"\"goods_capacity\":40,\"level\":%u,\"player_idx\":\"player-%u\"}",
+			t > 0 ? "," : "", t + 1, lineIdx + 1, position, forward ? 1 : -1, (uint(turn) + t) % 40, 1 + t % 3,
+			t % m_config.players);
+	}
+
+	out += "],\"posts\":[";
+	for (uint p = 0; p < m_posts; ++p)
+	{
+		uint type = 1 + p % 3;
+		append(out,
+			"%s{\"idx\":%u,\"point_idx\":%u,\"type\":%u,\"name\":\"post-%u\",\"armor\":%u,\"armor_capacity\":200,"
+			"\"level\":1,\"population\":%u,\"population_capacity\":10,\"product\":%u,\"product_capacity\":200,"
+			"\"player_idx\":\"%s%u\"}",
+			p > 0 ? "," : "", p + 1, p * m_config.postFrequency + 1, type, p + 1, (uint(turn) + p) % 200,
+			1 + (uint(turn) / 50 + p) % 10, (uint(turn) * 3 + p) % 200, type == 1 ? "player-" : "",
+			type == 1 ? p % m_config.players : 0);
+	}
+
+	out += "],\"ratings\":[";
+	for (uint pl = 0; pl < m_config.players; ++pl)
+	{
+		append(out, "%s{\"idx\":\"player-%u\",\"name\":\"Player %u\",\"rating\":%u}", pl > 0 ? "," : "", pl, pl + 1,
+			uint(turn) * (pl + 1));
+	}
+	out += "]}";
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+SyntheticGameServer::SyntheticGameServer(std::shared_ptr<const SyntheticGame> game)
+	: m_game(game)
+	, m_turn(0)
+	, m_observer(false)
+{
+}
+
+Result SyntheticGameServer::handle(Action action, const std::string& request, std::string& response)
+{
+	response.clear();
+
+	switch (action)
+	{
+	case Action::LOGIN:
+		append(response, "{\"idx\":\"player-0\",\"name\":\"player\",\"rating\":0}");
+		return Result::OKEY;
+
+	case Action::LOGOUT:
+		return Result::OKEY;
+
+	case Action::OBSERVER:
+		m_observer = true;
+		response = m_game->gamesList();
+		return Result::OKEY;
+
+	case Action::GAME:
+	{
+		uint idx = requestField<uint>(request, "idx");
+		if (!m_observer || idx == 0 || idx > m_game->config().games)
+		{
+			return Result::RESOURCE_NOT_FOUND;
+		}
+		m_turn = 0;
+		return Result::OKEY;
+	}
+
+	case Action::TURN:
+	{
+		// an observer picks the turn to look at, a player just waits for the next one
+		int turn = m_observer ? requestField<int>(request, "idx") : m_turn + 1;
+		if (turn < 0 || turn > int(m_game->config().turns))
+		{
+			return Result::RESOURCE_NOT_FOUND;
+		}
+		m_turn = turn;
+		return Result::OKEY;
+	}
+
+	case Action::MAP:
+		switch (requestField<uint>(request, "layer"))
+		{
+		case SpaceLayer::STATIC:
+			response = m_game->staticLayer();
+			return Result::OKEY;
+		case SpaceLayer::DYNAMIC:
+			m_game->dynamicLayer(m_turn, response);
+			return Result::OKEY;
+		case SpaceLayer::COORDINATES:
+			response = m_game->coordinatesLayer();
+			return Result::OKEY;
+		default:
+			return Result::RESOURCE_NOT_FOUND;
+		}
+
+	default:
+		return Result::BAD_COMMAND;
+	}
+}
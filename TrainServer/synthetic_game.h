@@ -0,0 +1,67 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "loopback_transport.h"
+
+struct SyntheticGameConfig
+{
+	uint games = 1;
+	uint turns = 1000;
+	uint points = 400;
+	uint trains = 64;
+	uint players = 4;
+	// every n-th point has a post
+	uint postFrequency = 5;
+};
+
+// Generated game world shared by all connections. Static layers are built once, dynamic
+// layers are produced on request from the turn number so any turn can be asked in any order.
+class SyntheticGame
+{
+public:
+	explicit SyntheticGame(const SyntheticGameConfig& config);
+
+	const SyntheticGameConfig& config() const { return m_config; }
+	const std::string&		   gamesList() const { return m_games; }
+	const std::string&		   staticLayer() const { return m_static; }
+	const std::string&		   coordinatesLayer() const { return m_coordinates; }
+	void					   dynamicLayer(int turn, std::string& out) const;
+
+private:
+	struct Line
+	{
+		uint length;
+		uint pid_1;
+		uint pid_2;
+	};
+
+	void buildGames();
+	void buildStatic();
+	void buildCoordinates();
+
+private:
+	SyntheticGameConfig m_config;
+	uint				m_side;
+	std::vector<Line>	m_lines;
+	uint				m_posts;
+
+	std::string m_games;
+	std::string m_static;
+	std::string m_coordinates;
+};
+
+// Protocol state of one observer connection to a synthetic game.
+class SyntheticGameServer : public LoopbackServer
+{
+public:
+	explicit SyntheticGameServer(std::shared_ptr<const SyntheticGame> game);
+
+protected:
+	Result handle(Action action, const std::string& request, std::string& response) override;
+
+private:
+	std::shared_ptr<const SyntheticGame> m_game;
+	int									 m_turn;
+	bool								 m_observer;
+};
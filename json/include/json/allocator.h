@@ -6,8 +6,14 @@
 #ifndef CPPTL_JSON_ALLOCATOR_H_INCLUDED
 #define CPPTL_JSON_ALLOCATOR_H_INCLUDED
 
+#if !defined(JSON_IS_AMALGAMATION)
+#include "config.h"
+#endif // if !defined(JSON_IS_AMALGAMATION)
+#include <cstddef>
 #include <cstring>
 #include <memory>
+#include <type_traits>
+#include <vector>
 
 #pragma pack(push, 8)
 
@@ -91,6 +97,82 @@ bool operator!=(const SecureAllocator<T>&, const SecureAllocator<U>&) {
 	return false;
 }
 
+/** \brief Memory of one document, handed out from a few large blocks.
+ *
+ * Nothing is freed on its own: all blocks go at once when the last reference
+ * is released. Values built by a reader with "useArena" keep a reference
+ * each, so an arena outlives every value allocated from it. References are
+ * not atomic, a document belongs to one thread at a time.
+ */
+class JSON_API Arena {
+public:
+  explicit Arena(size_t blockSize = 64 * 1024);
+  ~Arena();
+
+  void* allocate(size_t size);
+  void retain() { ++references_; }
+  void release() {
+    if (--references_ == 0)
+      delete this;
+  }
+  /// bytes taken from the system
+  size_t capacity() const { return capacity_; }
+
+private:
+  Arena(Arena const&);              // no impl
+  void operator=(Arena const&);     // no impl
+
+  std::vector<char*> blocks_;
+  char* current_;
+  char* end_;
+  size_t blockSize_;
+  size_t capacity_;
+  unsigned references_;
+};
+
+/** STL allocator on an Arena, or on the global heap without one.
+ *
+ * Copies of containers go to the heap, so a copy taken out of an arena
+ * document does not depend on it.
+ */
+template<typename T>
+class ArenaAllocator {
+public:
+  typedef T value_type;
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+
+  ArenaAllocator() : arena_(0) {}
+  explicit ArenaAllocator(Arena* arena) : arena_(arena) {}
+  template<typename U> ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+  T* allocate(size_t n) {
+    if (arena_)
+      return static_cast<T*>(arena_->allocate(n * sizeof(T)));
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+  void deallocate(T* p, size_t) {
+    if (!arena_)
+      ::operator delete(p);
+  }
+  ArenaAllocator select_on_container_copy_construction() const { return ArenaAllocator(); }
+
+  Arena* arena() const { return arena_; }
+
+private:
+  Arena* arena_;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() != b.arena();
+}
+
 } //namespace Json
 
 #pragma pack(pop)
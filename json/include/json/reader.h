@@ -115,6 +115,10 @@ public:
     - `"allowSpecialFloats": false or true`
       - If true, special float values (NaNs and infinities) are allowed 
         and their values are lossfree restorable.
+    - `"useArena": false or true`
+      - If true, every document is allocated from its own Arena, which is
+        released in one go with the last value of the document. Copies of
+        the values are independent of it.
 
     You can examine 'settings_` yourself
     to see the defaults. You can also write and read them just like any
@@ -151,6 +155,40 @@ public:
   static void strictMode(Json::Value* settings);
 };
 
+/** \brief Receives a document as a flat sequence of events, see parseEvents().
+ *
+ * Nothing is allocated per value: strings and keys are ranges which stay
+ * valid for the duration of the call only, they point into the document
+ * itself unless the string has escapes. Integers which fit LargestInt are
+ * reported by onInt(), larger ones by onUInt() and anything else by
+ * onDouble(). Returning false from a callback stops the parse.
+ */
+class JSON_API EventHandler {
+public:
+  virtual ~EventHandler() {}
+  virtual bool onNull() { return true; }
+  virtual bool onBool(bool /*value*/) { return true; }
+  virtual bool onInt(LargestInt /*value*/) { return true; }
+  virtual bool onUInt(LargestUInt /*value*/) { return true; }
+  virtual bool onDouble(double /*value*/) { return true; }
+  virtual bool onString(char const* /*begin*/, char const* /*end*/) { return true; }
+  virtual bool onKey(char const* /*begin*/, char const* /*end*/) { return true; }
+  virtual bool onObjectBegin() { return true; }
+  virtual bool onObjectEnd() { return true; }
+  virtual bool onArrayBegin() { return true; }
+  virtual bool onArrayEnd() { return true; }
+};
+
+/** \brief Scans a strict JSON document and reports it to \c handler without
+ * building any Value.
+ *
+ * Comments, special floats and single quotes are not accepted.
+ * \param errs [out] the reason and offset of the failure (if not NULL)
+ * \return \c false on a syntax error or when the handler stopped the parse.
+ */
+bool JSON_API parseEvents(char const* beginDoc, char const* endDoc,
+                          EventHandler& handler, JSONCPP_STRING* errs);
+
 /** Consume entire stream and use its begin/end.
   * Someday we might have a real StreamReader, but for now this
   * is convenient.
@@ -7,17 +7,16 @@
 #define CPPTL_JSON_H_INCLUDED
 
 #if !defined(JSON_IS_AMALGAMATION)
+#include "allocator.h"
 #include "forwards.h"
 #endif // if !defined(JSON_IS_AMALGAMATION)
 #include <string>
 #include <vector>
+#include <cstddef>
 #include <exception>
+#include <iterator>
+#include <utility>
 
-#ifndef JSON_USE_CPPTL_SMALLMAP
-#include <map>
-#else
-#include <cpptl/smallmap.h>
-#endif
 #ifdef JSON_USE_CPPTL
 #include <cpptl/forwards.h>
 #endif
@@ -140,6 +139,35 @@ private:
   const char* c_str_;
 };
 
+/** \brief Member name with its hash computed once.
+ *
+ * Meant for the same member looked up in many objects: a lookup by key compares
+ * the stored hashes of the members instead of their names.
+ * The name is not copied, it has to outlive the key.
+ *
+ * Example of usage:
+ * \code
+ * static const Json::Key idx("idx");
+ * for (Json::ArrayIndex i = 0; i < points.size(); ++i)
+ *   if (Json::Value const* id = points[i].find(idx))
+ *     ids.push_back(id->asUInt());
+ * \endcode
+ */
+class JSON_API Key {
+public:
+  explicit Key(const char* name);
+  Key(const char* begin, const char* end);
+
+  const char* data() const { return data_; }
+  unsigned length() const { return length_; }
+  unsigned hash() const { return hash_; }
+
+private:
+  const char* data_;
+  unsigned length_;
+  unsigned hash_;
+};
+
 /** \brief Represents a <a HREF="http://www.json.org">JSON</a> value.
  *
  * This class is a discriminated union wrapper that can represents a:
@@ -227,13 +255,17 @@ private:
     enum DuplicationPolicy {
       noDuplication = 0,
       duplicate,
-      duplicateOnCopy
+      duplicateOnCopy,
+      // owned by an arena: never freed, copies are duplicated
+      arenaString
     };
     CZString(ArrayIndex index);
     CZString(char const* str, unsigned length, DuplicationPolicy allocate);
+    /// same name as other, stored elsewhere
+    CZString(char const* str, CZString const& other, DuplicationPolicy allocate);
     CZString(CZString const& other);
 #if JSON_HAS_RVALUE_REFERENCES
-    CZString(CZString&& other);
+    CZString(CZString&& other) JSONCPP_NOEXCEPT;
 #endif
     ~CZString();
     CZString& operator=(const CZString& other);
@@ -248,7 +280,10 @@ private:
     //const char* c_str() const; ///< \deprecated
     char const* data() const;
     unsigned length() const;
+    /// of the name, the index for array keys
+    unsigned hash() const;
     bool isStaticString() const;
+    bool matches(Key const& key) const;
 
   private:
     void swap(CZString& other);
@@ -263,14 +298,11 @@ private:
       ArrayIndex index_;
       StringStorage storage_;
     };
+    unsigned hash_;
   };
 
 public:
-#ifndef JSON_USE_CPPTL_SMALLMAP
-  typedef std::map<CZString, Value> ObjectValues;
-#else
-  typedef CppTL::SmallMap<CZString, Value> ObjectValues;
-#endif // ifndef JSON_USE_CPPTL_SMALLMAP
+  class ObjectValues;
 #endif // ifndef JSONCPP_DOC_EXCLUDE_IMPLEMENTATION
 
 public:
@@ -290,6 +322,9 @@ Json::Value obj_value(Json::objectValue); // {}
 \endcode
   */
   Value(ValueType type = nullValue);
+  /// Array or object whose members, keys and strings are allocated from
+  /// \c arena, see CharReaderBuilder "useArena". NULL is the same as Value(type).
+  Value(ValueType type, Arena* arena);
   Value(Int value);
   Value(UInt value);
 #if defined(JSON_HAS_INT64)
@@ -299,6 +334,8 @@ Json::Value obj_value(Json::objectValue); // {}
   Value(double value);
   Value(const char* value); ///< Copy til first 0. (NULL causes to seg-fault.)
   Value(const char* begin, const char* end); ///< Copy all, incl zeroes.
+  /// Copy all into \c arena, or to the heap if it is NULL.
+  Value(const char* begin, const char* end, Arena* arena);
   /** \brief Constructs a value from a static string.
 
    * Like other value string constructor but do not duplicate the string for
@@ -324,13 +361,17 @@ Json::Value obj_value(Json::objectValue); // {}
   Value(const Value& other);
 #if JSON_HAS_RVALUE_REFERENCES
   /// Move constructor
-  Value(Value&& other);
+  Value(Value&& other) JSONCPP_NOEXCEPT;
 #endif
   ~Value();
 
   /// Deep copy, then swap(other).
   /// \note Over-write existing comments. To preserve comments, use #swapPayload().
-  Value& operator=(Value other);
+  Value& operator=(const Value& other);
+#if JSON_HAS_RVALUE_REFERENCES
+  /// Swap with other, which is left holding the previous value.
+  Value& operator=(Value&& other) JSONCPP_NOEXCEPT;
+#endif
 
   /// Swap everything.
   void swap(Value& other);
@@ -510,6 +551,9 @@ Json::Value obj_value(Json::objectValue); // {}
   /// and operator[]const
   /// \note As stated elsewhere, behavior is undefined if (end-begin) >= 2^30
   Value const* find(char const* begin, char const* end) const;
+  /// Same as find(begin, end), the cheapest lookup of a name used over and over.
+  /// \return NULL if there is no such member, or this is not an object.
+  Value const* find(Key const& key) const;
   /// Most general and efficient version of object-mutators.
   /// \note As stated elsewhere, behavior is undefined if (end-begin) >= 2^30
   /// \return non-zero, but JSON_ASSERT if this is neither object nor nullValue.
@@ -602,6 +646,7 @@ private:
 
   Value& resolveReference(const char* key);
   Value& resolveReference(const char* key, const char* end);
+  Arena* arena() const;
 
   struct CommentInfo {
     CommentInfo();
@@ -632,6 +677,8 @@ private:
   ValueType type_ : 8;
   unsigned int allocated_ : 1; // Notes: if declared as bool, bitfield is useless.
                                // If not allocated_, string_ must be null-terminated.
+  // string_ or map_ is in an arena this value holds a reference to
+  unsigned int arena_ : 1;
   CommentInfo* comments_;
 
   // [start, limit) byte offsets in the source JSON text from which this Value
@@ -640,6 +687,112 @@ private:
   ptrdiff_t limit_;
 };
 
+#ifndef JSONCPP_DOC_EXCLUDE_IMPLEMENTATION
+/** \brief Members of an object or elements of an array.
+ *
+ * Every entry is a node of its own, as with std::map, and a flat vector of
+ * pointers to them is kept sorted by key, so iteration goes in key order.
+ * Array elements are found by position, small objects by a scan of the key
+ * hashes stored next to the pointers and larger ones by a binary search.
+ * \note An insertion or a removal keeps references to the other entries valid,
+ * like std::map does. It invalidates iterators into the same container.
+ */
+class JSON_API Value::ObjectValues {
+public:
+  typedef std::pair<CZString, Value> value_type;
+  typedef ArenaAllocator<value_type> allocator_type;
+
+private:
+  struct Slot {
+    value_type* entry;
+    unsigned hash;
+  };
+  typedef std::vector<Slot, ArenaAllocator<Slot> > Slots;
+
+public:
+  /// Random access over the entries in key order.
+  template <typename Entry, typename SlotIterator> class Iterator {
+  public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef Entry value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef Entry* pointer;
+    typedef Entry& reference;
+
+    Iterator() : slot_() {}
+    explicit Iterator(SlotIterator slot) : slot_(slot) {}
+    template <typename OtherEntry, typename OtherSlot>
+    Iterator(const Iterator<OtherEntry, OtherSlot>& other)
+        : slot_(other.slot()) {}
+
+    reference operator*() const { return *slot_->entry; }
+    pointer operator->() const { return slot_->entry; }
+    Iterator& operator++() {
+      ++slot_;
+      return *this;
+    }
+    Iterator& operator--() {
+      --slot_;
+      return *this;
+    }
+    Iterator operator+(difference_type n) const { return Iterator(slot_ + n); }
+    difference_type operator-(const Iterator& other) const {
+      return slot_ - other.slot_;
+    }
+    bool operator==(const Iterator& other) const { return slot_ == other.slot_; }
+    bool operator!=(const Iterator& other) const { return slot_ != other.slot_; }
+
+    SlotIterator slot() const { return slot_; }
+
+  private:
+    SlotIterator slot_;
+  };
+  typedef Iterator<value_type, Slots::iterator> iterator;
+  typedef Iterator<const value_type, Slots::const_iterator> const_iterator;
+
+  explicit ObjectValues(const allocator_type& allocator = allocator_type());
+  /// The copy is on the heap, whatever other is on.
+  ObjectValues(const ObjectValues& other);
+  ~ObjectValues();
+
+  iterator begin() { return iterator(slots_.begin()); }
+  iterator end() { return iterator(slots_.end()); }
+  const_iterator begin() const { return const_iterator(slots_.begin()); }
+  const_iterator end() const { return const_iterator(slots_.end()); }
+  size_t size() const { return slots_.size(); }
+  bool empty() const { return slots_.empty(); }
+  void clear();
+  allocator_type get_allocator() const { return allocator_type(slots_.get_allocator()); }
+
+  iterator lower_bound(const CZString& key);
+  iterator find(const CZString& key);
+  const_iterator find(const CZString& key) const;
+  const_iterator find(const Key& key) const;
+  /// \pre position is the lower_bound() of the key
+  iterator insert(iterator position, const value_type& entry);
+  /// \pre position is the lower_bound() of the key
+  iterator insert(iterator position, CZString&& key);
+  void erase(iterator position);
+  size_t erase(const CZString& key);
+  Value& operator[](const CZString& key);
+
+  bool operator<(const ObjectValues& other) const;
+  bool operator==(const ObjectValues& other) const;
+
+private:
+  ObjectValues& operator=(const ObjectValues&); // no impl
+
+  size_t lowerBound(const CZString& key) const;
+  /// Makes room for one more slot, so that inserting it cannot throw.
+  iterator reserve(iterator position, const CZString& key);
+  /// \pre room was made by reserve()
+  iterator link(iterator position, value_type& entry);
+  void destroy(value_type* entry);
+
+  Slots slots_;
+};
+#endif // ifndef JSONCPP_DOC_EXCLUDE_IMPLEMENTATION
+
 /** \brief Experimental and untested: represents an element of the "path" to
  * access a node.
  */
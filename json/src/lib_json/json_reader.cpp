@@ -9,6 +9,7 @@
 #include <json/reader.h>
 #include <json/value.h>
 #include "json_tool.h"
+#include "json_scanner.h"
 #endif // if !defined(JSON_IS_AMALGAMATION)
 #include <utility>
 #include <cstdio>
@@ -94,6 +95,7 @@ public:
   bool failIfExtra_;
   bool rejectDupKeys_;
   bool allowSpecialFloats_;
+  bool useArena_;
   int stackLimit_;
 };  // OurFeatures
 
@@ -223,6 +225,8 @@ private:
 
   OurFeatures const features_;
   bool collectComments_;
+  // of the document being parsed, NULL unless useArena_
+  Arena* arena_;
 };  // OurReader
 
 // complete copy of Read impl, for OurReader
@@ -237,7 +241,7 @@ bool OurReader::containsNewLine(OurReader::Location begin, OurReader::Location e
 OurReader::OurReader(OurFeatures const& features)
     : errors_(), document_(), begin_(), end_(), current_(), lastValueEnd_(),
       lastValue_(), commentsBefore_(),
-      features_(features), collectComments_() {
+      features_(features), collectComments_(), arena_() {
 }
 
 bool OurReader::parse(const char* beginDoc,
@@ -260,6 +264,22 @@ bool OurReader::parse(const char* beginDoc,
     nodes_.pop();
   nodes_.push(&root);
 
+  // containers and strings of the document keep the arena alive, the reader
+  // only holds it while parsing
+  struct ArenaScope {
+    Arena*& arena_;
+    ArenaScope(Arena*& arena, bool use) : arena_(arena) {
+      arena_ = use ? new Arena() : 0;
+      if (arena_)
+        arena_->retain();
+    }
+    ~ArenaScope() {
+      if (arena_)
+        arena_->release();
+      arena_ = 0;
+    }
+  } arenaScope(arena_, features_.useArena_);
+
   bool successful = readValue();
   Token token;
   skipCommentTokens(token);
@@ -499,15 +519,7 @@ bool OurReader::readToken(Token& token) {
   return true;
 }
 
-void OurReader::skipSpaces() {
-  while (current_ != end_) {
-    Char c = *current_;
-    if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
-      ++current_;
-    else
-      break;
-  }
-}
+void OurReader::skipSpaces() { current_ = Scan::skipSpaces(current_, end_); }
 
 bool OurReader::match(Location pattern, int patternLength) {
   if (end_ - current_ < patternLength)
@@ -626,15 +638,14 @@ bool OurReader::readNumber(bool checkInf) {
   return true;
 }
 bool OurReader::readString() {
-  Char c = 0;
-  while (current_ != end_) {
-    c = getNextChar();
-    if (c == '\\')
-      getNextChar();
-    else if (c == '"')
+  while ((current_ = Scan::findQuoteOrEscape(current_, end_)) != end_) {
+    if (*current_++ == '"')
+      return true;
+    if (current_ == end_)
       break;
+    ++current_; // escaped char
   }
-  return c == '"';
+  return false;
 }
 
 
@@ -653,7 +664,7 @@ bool OurReader::readStringSingleQuote() {
 bool OurReader::readObject(Token& tokenStart) {
   Token tokenName;
   JSONCPP_STRING name;
-  Value init(objectValue);
+  Value init(objectValue, arena_);
   currentValue().swapPayload(init);
   currentValue().setOffsetStart(tokenStart.start_ - begin_);
   while (readToken(tokenName)) {
@@ -713,7 +724,7 @@ bool OurReader::readObject(Token& tokenStart) {
 }
 
 bool OurReader::readArray(Token& tokenStart) {
-  Value init(arrayValue);
+  Value init(arrayValue, arena_);
   currentValue().swapPayload(init);
   currentValue().setOffsetStart(tokenStart.start_ - begin_);
   skipSpaces();
@@ -852,7 +863,7 @@ bool OurReader::decodeString(Token& token) {
   JSONCPP_STRING decoded_string;
   if (!decodeString(token, decoded_string))
     return false;
-  Value decoded(decoded_string);
+  Value decoded(decoded_string.data(), decoded_string.data() + decoded_string.size(), arena_);
   currentValue().swapPayload(decoded);
   currentValue().setOffsetStart(token.start_ - begin_);
   currentValue().setOffsetLimit(token.end_ - begin_);
@@ -864,6 +875,11 @@ bool OurReader::decodeString(Token& token, JSONCPP_STRING& decoded) {
   Location current = token.start_ + 1; // skip '"'
   Location end = token.end_ - 1;       // do not include '"'
   while (current != end) {
+    Location run = Scan::findQuoteOrEscape(current, end);
+    decoded.append(current, run);
+    if (run == end)
+      break;
+    current = run;
     Char c = *current++;
     if (c == '"')
       break;
@@ -905,8 +921,6 @@ bool OurReader::decodeString(Token& token, JSONCPP_STRING& decoded) {
       default:
         return addError("Bad escape sequence in string", token, current);
       }
-    } else {
-      decoded += c;
     }
   }
   return true;
@@ -1150,6 +1164,7 @@ CharReader* CharReaderBuilder::newCharReader() const
   features.failIfExtra_ = settings_["failIfExtra"].asBool();
   features.rejectDupKeys_ = settings_["rejectDupKeys"].asBool();
   features.allowSpecialFloats_ = settings_["allowSpecialFloats"].asBool();
+  features.useArena_ = settings_["useArena"].asBool();
   return new OurCharReader(collectComments, features);
 }
 static void getValidReaderKeys(std::set<JSONCPP_STRING>* valid_keys)
@@ -1165,6 +1180,7 @@ static void getValidReaderKeys(std::set<JSONCPP_STRING>* valid_keys)
   valid_keys->insert("failIfExtra");
   valid_keys->insert("rejectDupKeys");
   valid_keys->insert("allowSpecialFloats");
+  valid_keys->insert("useArena");
 }
 bool CharReaderBuilder::validate(Json::Value* invalid) const
 {
@@ -1200,6 +1216,7 @@ void CharReaderBuilder::strictMode(Json::Value* settings)
   (*settings)["failIfExtra"] = true;
   (*settings)["rejectDupKeys"] = true;
   (*settings)["allowSpecialFloats"] = false;
+  (*settings)["useArena"] = false;
 //! [CharReaderBuilderStrictMode]
 }
 // static
@@ -1216,9 +1233,359 @@ void CharReaderBuilder::setDefaults(Json::Value* settings)
   (*settings)["failIfExtra"] = false;
   (*settings)["rejectDupKeys"] = false;
   (*settings)["allowSpecialFloats"] = false;
+  (*settings)["useArena"] = false;
 //! [CharReaderBuilderDefaults]
 }
 
+// Implementation of parseEvents
+// ////////////////////////////////
+
+// Strict single pass reader behind parseEvents(). Unlike OurReader it keeps
+// no nodes: every value goes to the handler as soon as it is scanned.
+class EventReader {
+public:
+  typedef char Char;
+  typedef const Char* Location;
+
+  EventReader(Location beginDoc, Location endDoc, EventHandler& handler);
+  bool parse();
+  JSONCPP_STRING getFormattedErrorMessages() const;
+
+private:
+  EventReader(EventReader const&);  // no impl
+  void operator=(EventReader const&);  // no impl
+
+  bool readValue(size_t depth);
+  bool readObject(size_t depth);
+  bool readArray(size_t depth);
+  bool readString(Location& begin, Location& end);
+  bool readNumber();
+  bool decodeDouble(Location begin, Location end);
+  bool decodeEscapes(Location begin, Location end);
+  bool decodeHex4(Location& current, unsigned int& unicode);
+  bool match(Location pattern, int patternLength);
+  void skipSpaces();
+  bool addError(const char* message);
+  bool stopped();
+
+  Location begin_;
+  Location end_;
+  Location current_;
+  EventHandler& handler_;
+  // decoded text of strings with escapes
+  JSONCPP_STRING scratch_;
+  JSONCPP_STRING error_;
+  Location errorLocation_;
+};
+
+EventReader::EventReader(Location beginDoc, Location endDoc, EventHandler& handler)
+    : begin_(beginDoc), end_(endDoc), current_(beginDoc), handler_(handler),
+      errorLocation_(0) {}
+
+bool EventReader::parse() {
+  if (!readValue(0))
+    return false;
+  skipSpaces();
+  if (current_ != end_)
+    return addError("Extra non-whitespace after JSON value.");
+  return true;
+}
+
+JSONCPP_STRING EventReader::getFormattedErrorMessages() const {
+  if (error_.empty())
+    return JSONCPP_STRING();
+  char offset[32];
+  snprintf(offset, sizeof(offset), "%lu", static_cast<unsigned long>(errorLocation_ - begin_));
+  return "* Offset " + JSONCPP_STRING(offset) + "\n  " + error_ + "\n";
+}
+
+bool EventReader::addError(const char* message) {
+  if (error_.empty()) {
+    error_ = message;
+    errorLocation_ = current_;
+  }
+  return false;
+}
+
+bool EventReader::stopped() { return addError("Parse stopped by the handler."); }
+
+void EventReader::skipSpaces() { current_ = Scan::skipSpaces(current_, end_); }
+
+bool EventReader::match(Location pattern, int patternLength) {
+  if (end_ - current_ < patternLength)
+    return false;
+  int index = patternLength;
+  while (index--)
+    if (current_[index] != pattern[index])
+      return false;
+  current_ += patternLength;
+  return true;
+}
+
+bool EventReader::readValue(size_t depth) {
+  if (depth > stackLimit_g)
+    return addError("Exceeded stackLimit in readValue().");
+  skipSpaces();
+  if (current_ == end_)
+    return addError("Syntax error: value, object or array expected.");
+
+  switch (*current_) {
+  case '{':
+    ++current_;
+    return readObject(depth);
+  case '[':
+    ++current_;
+    return readArray(depth);
+  case '"': {
+    Location begin, end;
+    if (!readString(begin, end))
+      return false;
+    return handler_.onString(begin, end) || stopped();
+  }
+  case 't':
+    if (!match("true", 4))
+      break;
+    return handler_.onBool(true) || stopped();
+  case 'f':
+    if (!match("false", 5))
+      break;
+    return handler_.onBool(false) || stopped();
+  case 'n':
+    if (!match("null", 4))
+      break;
+    return handler_.onNull() || stopped();
+  default:
+    if (*current_ == '-' || (*current_ >= '0' && *current_ <= '9'))
+      return readNumber();
+    break;
+  }
+  return addError("Syntax error: value, object or array expected.");
+}
+
+bool EventReader::readObject(size_t depth) {
+  if (!handler_.onObjectBegin())
+    return stopped();
+  skipSpaces();
+  if (current_ != end_ && *current_ == '}') {
+    ++current_;
+    return handler_.onObjectEnd() || stopped();
+  }
+  for (;;) {
+    skipSpaces();
+    if (current_ == end_ || *current_ != '"')
+      return addError("Missing '}' or object member name");
+    Location begin, end;
+    if (!readString(begin, end))
+      return false;
+    if (!handler_.onKey(begin, end))
+      return stopped();
+
+    skipSpaces();
+    if (current_ == end_ || *current_ != ':')
+      return addError("Missing ':' after object member name");
+    ++current_;
+    if (!readValue(depth + 1))
+      return false;
+
+    skipSpaces();
+    Char c = current_ != end_ ? *current_++ : 0;
+    if (c == '}')
+      return handler_.onObjectEnd() || stopped();
+    if (c != ',')
+      return addError("Missing ',' or '}' in object declaration");
+  }
+}
+
+bool EventReader::readArray(size_t depth) {
+  if (!handler_.onArrayBegin())
+    return stopped();
+  skipSpaces();
+  if (current_ != end_ && *current_ == ']') {
+    ++current_;
+    return handler_.onArrayEnd() || stopped();
+  }
+  for (;;) {
+    if (!readValue(depth + 1))
+      return false;
+
+    skipSpaces();
+    Char c = current_ != end_ ? *current_++ : 0;
+    if (c == ']')
+      return handler_.onArrayEnd() || stopped();
+    if (c != ',')
+      return addError("Missing ',' or ']' in array declaration");
+  }
+}
+
+bool EventReader::readString(Location& begin, Location& end) {
+  Location start = ++current_; // skip '"'
+  bool escaped = false;
+  while ((current_ = Scan::findQuoteOrEscape(current_, end_)) != end_ &&
+         *current_ != '"') {
+    escaped = true;
+    if (++current_ == end_)
+      break;
+    ++current_; // escaped char
+  }
+  if (current_ == end_)
+    return addError("Missing '\"' at the end of a string");
+
+  Location stop = current_++;
+  if (!escaped) {
+    begin = start;
+    end = stop;
+    return true;
+  }
+  if (!decodeEscapes(start, stop))
+    return false;
+  begin = scratch_.data();
+  end = begin + scratch_.size();
+  return true;
+}
+
+bool EventReader::decodeEscapes(Location current, Location end) {
+  scratch_.clear();
+  while (current != end) {
+    // only escapes are left between start and the closing quote
+    Location run = Scan::findQuoteOrEscape(current, end);
+    scratch_.append(current, run);
+    if (run == end)
+      break;
+    current = run + 1;
+    Char escape = *current++;
+    switch (escape) {
+    case '"':
+      scratch_ += '"';
+      break;
+    case '/':
+      scratch_ += '/';
+      break;
+    case '\\':
+      scratch_ += '\\';
+      break;
+    case 'b':
+      scratch_ += '\b';
+      break;
+    case 'f':
+      scratch_ += '\f';
+      break;
+    case 'n':
+      scratch_ += '\n';
+      break;
+    case 'r':
+      scratch_ += '\r';
+      break;
+    case 't':
+      scratch_ += '\t';
+      break;
+    case 'u': {
+      unsigned int unicode;
+      if (end - current < 4 || !decodeHex4(current, unicode))
+        return addError("Bad unicode escape sequence in string: four digits expected.");
+      if (unicode >= 0xD800 && unicode <= 0xDBFF) {
+        // surrogate pairs
+        unsigned int surrogatePair;
+        if (end - current < 6 || current[0] != '\\' || current[1] != 'u')
+          return addError("expecting another \\u token to begin the second half of "
+                          "a unicode surrogate pair");
+        current += 2;
+        if (!decodeHex4(current, surrogatePair))
+          return addError("Bad unicode escape sequence in string: hexadecimal digit expected.");
+        unicode = 0x10000 + ((unicode & 0x3FF) << 10) + (surrogatePair & 0x3FF);
+      }
+      scratch_ += codePointToUTF8(unicode);
+    } break;
+    default:
+      return addError("Bad escape sequence in string");
+    }
+  }
+  return true;
+}
+
+bool EventReader::decodeHex4(Location& current, unsigned int& unicode) {
+  unicode = 0;
+  for (int index = 0; index < 4; ++index) {
+    Char c = *current++;
+    unicode *= 16;
+    if (c >= '0' && c <= '9')
+      unicode += static_cast<unsigned int>(c - '0');
+    else if (c >= 'a' && c <= 'f')
+      unicode += static_cast<unsigned int>(c - 'a' + 10);
+    else if (c >= 'A' && c <= 'F')
+      unicode += static_cast<unsigned int>(c - 'A' + 10);
+    else
+      return false;
+  }
+  return true;
+}
+
+bool EventReader::readNumber() {
+  // integers are accumulated while scanning, fractions and exponents go to decodeDouble
+  Location start = current_;
+  bool isNegative = *current_ == '-';
+  if (isNegative)
+    ++current_;
+  if (current_ == end_ || *current_ < '0' || *current_ > '9')
+    return addError("Syntax error: value, object or array expected.");
+
+  LargestUInt maxIntegerValue =
+      isNegative ? LargestUInt(Value::maxLargestInt) + 1 : Value::maxLargestUInt;
+  LargestUInt threshold = maxIntegerValue / 10;
+  LargestUInt value = 0;
+  bool overflow = false;
+  while (current_ != end_ && *current_ >= '0' && *current_ <= '9') {
+    LargestUInt digit = static_cast<LargestUInt>(*current_++ - '0');
+    if (value > threshold || (value == threshold && digit > maxIntegerValue % 10))
+      overflow = true;
+    value = value * 10 + digit;
+  }
+
+  bool integral = !overflow;
+  if (current_ != end_ && *current_ == '.') {
+    integral = false;
+    ++current_;
+    while (current_ != end_ && *current_ >= '0' && *current_ <= '9')
+      ++current_;
+  }
+  if (current_ != end_ && (*current_ == 'e' || *current_ == 'E')) {
+    integral = false;
+    ++current_;
+    if (current_ != end_ && (*current_ == '+' || *current_ == '-'))
+      ++current_;
+    while (current_ != end_ && *current_ >= '0' && *current_ <= '9')
+      ++current_;
+  }
+
+  if (!integral)
+    return decodeDouble(start, current_);
+  if (isNegative)
+    return handler_.onInt(-LargestInt(value - 1) - 1) || stopped();
+  if (value <= LargestUInt(Value::maxLargestInt))
+    return handler_.onInt(LargestInt(value)) || stopped();
+  return handler_.onUInt(value) || stopped();
+}
+
+bool EventReader::decodeDouble(Location begin, Location end) {
+  const int bufferSize = 32;
+  double value = 0;
+  int count;
+  ptrdiff_t const length = end - begin;
+  char format[] = "%lf";
+  if (length <= bufferSize) {
+    Char buffer[bufferSize + 1];
+    memcpy(buffer, begin, static_cast<size_t>(length));
+    buffer[length] = 0;
+    fixNumericLocaleInput(buffer, buffer + length);
+    count = sscanf(buffer, format, &value);
+  } else {
+    JSONCPP_STRING buffer(begin, end);
+    count = sscanf(buffer.c_str(), format, &value);
+  }
+  if (count != 1)
+    return addError("Syntax error: malformed number.");
+  return handler_.onDouble(value) || stopped();
+}
+
 //////////////////////////////////
 // global functions
 
@@ -1236,6 +1603,15 @@ bool parseFromStream(
   return reader->parse(begin, end, root, errs);
 }
 
+bool parseEvents(char const* beginDoc, char const* endDoc,
+                 EventHandler& handler, JSONCPP_STRING* errs) {
+  EventReader reader(beginDoc, endDoc, handler);
+  bool successful = reader.parse();
+  if (errs)
+    *errs = reader.getFormattedErrorMessages();
+  return successful;
+}
+
 JSONCPP_ISTREAM& operator>>(JSONCPP_ISTREAM& sin, Value& root) {
   CharReaderBuilder b;
   JSONCPP_STRING errs;
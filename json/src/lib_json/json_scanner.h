@@ -0,0 +1,232 @@
+// Copyright 2007-2010 Baptiste Lepilleur and The JsonCpp Authors
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#ifndef LIB_JSONCPP_JSON_SCANNER_H_INCLUDED
+#define LIB_JSONCPP_JSON_SCANNER_H_INCLUDED
+
+/* This header provides the byte scanning loops of the readers: skipping
+ * whitespace and finding the end of a string run. On x86 the scans look at
+ * 16 (SSE2) or 32 (AVX2) bytes per step, AVX2 is picked at run time when the
+ * CPU supports it. Define JSONCPP_NO_SIMD to build the plain loops only.
+ *
+ * It is an internal header that must not be exposed.
+ */
+
+#if !defined(JSONCPP_NO_SIMD) &&                                               \
+    (defined(__SSE2__) || defined(_M_X64) ||                                   \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define JSONCPP_SCAN_SSE2 1
+#include <emmintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define JSONCPP_SCAN_AVX2 1
+#define JSONCPP_SCAN_TARGET_AVX2
+#include <immintrin.h>
+#include <intrin.h>
+#elif defined(__GNUC__) && (defined(__clang__) || __GNUC__ >= 5)
+#define JSONCPP_SCAN_AVX2 1
+#define JSONCPP_SCAN_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+#endif
+
+namespace Json {
+namespace Scan {
+
+typedef const char* (*Kernel)(const char* current, const char* end);
+
+static inline bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline bool isQuoteOrEscape(char c) { return c == '"' || c == '\\'; }
+
+static const char* skipSpacesScalar(const char* current, const char* end) {
+  while (current != end && isSpace(*current))
+    ++current;
+  return current;
+}
+
+static const char* findQuoteOrEscapeScalar(const char* current,
+                                           const char* end) {
+  while (current != end && !isQuoteOrEscape(*current))
+    ++current;
+  return current;
+}
+
+#if defined(JSONCPP_SCAN_SSE2)
+
+/// Index of the lowest set bit, mask must not be 0.
+static inline unsigned firstSetBit(unsigned mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return static_cast<unsigned>(index);
+#else
+  return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+static inline unsigned spaceMask16(const char* current) {
+  __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current));
+  __m128i spaces = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(' ')),
+                   _mm_cmpeq_epi8(block, _mm_set1_epi8('\t'))),
+      _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('\r')),
+                   _mm_cmpeq_epi8(block, _mm_set1_epi8('\n'))));
+  return static_cast<unsigned>(_mm_movemask_epi8(spaces));
+}
+
+static inline unsigned quoteOrEscapeMask16(const char* current) {
+  __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current));
+  __m128i found = _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('"')),
+                               _mm_cmpeq_epi8(block, _mm_set1_epi8('\\')));
+  return static_cast<unsigned>(_mm_movemask_epi8(found));
+}
+
+static const char* skipSpacesSSE2(const char* current, const char* end) {
+  for (; end - current >= 16; current += 16) {
+    unsigned others = ~spaceMask16(current) & 0xFFFFu;
+    if (others)
+      return current + firstSetBit(others);
+  }
+  return skipSpacesScalar(current, end);
+}
+
+static const char* findQuoteOrEscapeSSE2(const char* current,
+                                         const char* end) {
+  for (; end - current >= 16; current += 16) {
+    unsigned found = quoteOrEscapeMask16(current);
+    if (found)
+      return current + firstSetBit(found);
+  }
+  return findQuoteOrEscapeScalar(current, end);
+}
+
+#endif // if defined(JSONCPP_SCAN_SSE2)
+
+#if defined(JSONCPP_SCAN_AVX2)
+
+JSONCPP_SCAN_TARGET_AVX2 static const char* skipSpacesAVX2(const char* current,
+                                                           const char* end) {
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i cr = _mm256_set1_epi8('\r');
+  const __m256i lf = _mm256_set1_epi8('\n');
+  for (; end - current >= 32; current += 32) {
+    __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(current));
+    __m256i spaces =
+        _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, space),
+                                        _mm256_cmpeq_epi8(block, tab)),
+                        _mm256_or_si256(_mm256_cmpeq_epi8(block, cr),
+                                        _mm256_cmpeq_epi8(block, lf)));
+    unsigned others = ~static_cast<unsigned>(_mm256_movemask_epi8(spaces));
+    if (others)
+      return current + firstSetBit(others);
+  }
+  return skipSpacesSSE2(current, end);
+}
+
+JSONCPP_SCAN_TARGET_AVX2 static const char*
+findQuoteOrEscapeAVX2(const char* current, const char* end) {
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i escape = _mm256_set1_epi8('\\');
+  for (; end - current >= 32; current += 32) {
+    __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(current));
+    __m256i found = _mm256_or_si256(_mm256_cmpeq_epi8(block, quote),
+                                    _mm256_cmpeq_epi8(block, escape));
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(found));
+    if (mask)
+      return current + firstSetBit(mask);
+  }
+  return findQuoteOrEscapeSSE2(current, end);
+}
+
+static bool cpuHasAVX2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+  __cpuid(info, 1);
+  // the OS has to save the ymm registers too
+  const int osxsave = 1 << 27, avx = 1 << 28;
+  if ((info[2] & (osxsave | avx)) != (osxsave | avx) ||
+      (_xgetbv(0) & 6) != 6)
+    return false;
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif // if defined(JSONCPP_SCAN_AVX2)
+
+struct Kernels {
+  Kernel skipSpaces;
+  Kernel findQuoteOrEscape;
+};
+
+/// Widest scans the CPU runs, chosen on the first call.
+static const Kernels& kernels() {
+  struct Select {
+    static Kernels best() {
+#if defined(JSONCPP_SCAN_AVX2)
+      if (cpuHasAVX2()) {
+        Kernels avx2 = {&skipSpacesAVX2, &findQuoteOrEscapeAVX2};
+        return avx2;
+      }
+#endif
+#if defined(JSONCPP_SCAN_SSE2)
+      Kernels sse2 = {&skipSpacesSSE2, &findQuoteOrEscapeSSE2};
+#else
+      Kernels sse2 = {&skipSpacesScalar, &findQuoteOrEscapeScalar};
+#endif
+      return sse2;
+    }
+  };
+  static const Kernels selected = Select::best();
+  return selected;
+}
+
+enum {
+  /// Whitespace runs up to this length are skipped without the kernels.
+  shortSpaces = 8
+};
+
+/** Returns the first char in [current, end) that is not JSON whitespace, or
+ * end. Separators and shallow indentation are short runs, a block load costs
+ * more than looking at them one by one.
+ */
+static inline const char* skipSpaces(const char* current, const char* end) {
+  for (int n = 0; n < shortSpaces; ++n, ++current) {
+    if (current == end || !isSpace(*current))
+      return current;
+  }
+  return kernels().skipSpaces(current, end);
+}
+
+/** Returns the first '"' or '\\' in [current, end), or end. Member names and
+ * short strings end within the first block, which is checked inline.
+ */
+static inline const char* findQuoteOrEscape(const char* current,
+                                            const char* end) {
+#if defined(JSONCPP_SCAN_SSE2)
+  if (end - current >= 16) {
+    unsigned found = quoteOrEscapeMask16(current);
+    if (found)
+      return current + firstSetBit(found);
+    current += 16;
+  }
+#endif
+  return kernels().findQuoteOrEscape(current, end);
+}
+
+} // namespace Scan
+} // namespace Json
+
+#endif // LIB_JSONCPP_JSON_SCANNER_H_INCLUDED
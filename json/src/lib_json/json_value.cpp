@@ -9,6 +9,7 @@
 #include <json/writer.h>
 #endif // if !defined(JSON_IS_AMALGAMATION)
 #include <math.h>
+#include <new>
 #include <sstream>
 #include <utility>
 #include <cstring>
@@ -174,6 +175,77 @@ static inline void releaseStringValue(char* value, unsigned) {
 }
 #endif // JSONCPP_USING_SECURE_MEMORY
 
+/* Arena strings are prefixed like the allocated ones, with the arena they
+ * hold a reference to stored right before the length.
+ */
+static inline char* duplicateAndPrefixStringValue(
+    const char* value,
+    unsigned int length,
+    Arena* arena)
+{
+  JSON_ASSERT_MESSAGE(length <= static_cast<unsigned>(Value::maxInt) - sizeof(unsigned) - 1U,
+                      "in Json::Value::duplicateAndPrefixStringValue(): "
+                      "length too big for prefixing");
+  char* block = static_cast<char*>(
+      arena->allocate(sizeof(Arena*) + sizeof(unsigned) + length + 1U));
+  *reinterpret_cast<Arena**>(block) = arena;
+  char* newString = block + sizeof(Arena*);
+  *reinterpret_cast<unsigned*>(newString) = length;
+  memcpy(newString + sizeof(unsigned), value, length);
+  newString[sizeof(unsigned) + length] = 0;
+  arena->retain();
+  return newString;
+}
+
+static inline void releaseArenaStringValue(char* value) {
+  (*reinterpret_cast<Arena**>(value - sizeof(Arena*)))->release();
+}
+
+/// FNV-1a of a member name
+static inline unsigned hashKey(char const* key, unsigned length) {
+  unsigned hash = 2166136261U;
+  for (unsigned i = 0; i < length; ++i) {
+    hash ^= static_cast<unsigned char>(key[i]);
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+// //////////////////////////////////////////////////////////////////
+// class Arena
+// //////////////////////////////////////////////////////////////////
+
+// enough for every member of a Value
+static size_t const arenaAlignment = 8;
+
+Arena::Arena(size_t blockSize)
+    : current_(0), end_(0), blockSize_(blockSize), capacity_(0), references_(0) {}
+
+Arena::~Arena() {
+  for (size_t i = 0; i < blocks_.size(); ++i)
+    free(blocks_[i]);
+}
+
+void* Arena::allocate(size_t size) {
+  size = (size + arenaAlignment - 1) & ~(arenaAlignment - 1);
+  if (static_cast<size_t>(end_ - current_) < size) {
+    // what does not fit a block gets a block of its own
+    size_t blockSize = size > blockSize_ ? size : blockSize_;
+    char* block = static_cast<char*>(malloc(blockSize));
+    if (block == NULL)
+      throwRuntimeError("in Json::Arena::allocate(): Failed to allocate a block");
+    blocks_.push_back(block);
+    capacity_ += blockSize;
+    if (size > blockSize_)
+      return block;
+    current_ = block;
+    end_ = block + blockSize;
+  }
+  void* result = current_;
+  current_ += size;
+  return result;
+}
+
 } // namespace Json
 
 // //////////////////////////////////////////////////////////////////
@@ -254,29 +326,38 @@ void Value::CommentInfo::setComment(const char* text, size_t len) {
 // Notes: policy_ indicates if the string was allocated when
 // a string is stored.
 
-Value::CZString::CZString(ArrayIndex aindex) : cstr_(0), index_(aindex) {}
+Value::CZString::CZString(ArrayIndex aindex)
+    : cstr_(0), index_(aindex), hash_(aindex) {}
 
 Value::CZString::CZString(char const* str, unsigned ulength, DuplicationPolicy allocate)
-    : cstr_(str) {
+    : cstr_(str), hash_(hashKey(str, ulength)) {
   // allocate != duplicate
   storage_.policy_ = allocate & 0x3;
   storage_.length_ = ulength & 0x3FFFFFFF;
 }
 
+Value::CZString::CZString(char const* str, CZString const& other, DuplicationPolicy allocate)
+    : cstr_(str), hash_(other.hash_) {
+  storage_.policy_ = allocate & 0x3;
+  storage_.length_ = other.storage_.length_;
+}
+
 Value::CZString::CZString(const CZString& other) {
   cstr_ = (other.storage_.policy_ != noDuplication && other.cstr_ != 0
 				 ? duplicateStringValue(other.cstr_, other.storage_.length_)
 				 : other.cstr_);
+  // arenaString goes to duplicate as well: the copy may outlive the arena
   storage_.policy_ = static_cast<unsigned>(other.cstr_
                  ? (static_cast<DuplicationPolicy>(other.storage_.policy_) == noDuplication
                      ? noDuplication : duplicate)
                  : static_cast<DuplicationPolicy>(other.storage_.policy_)) & 3U;
   storage_.length_ = other.storage_.length_;
+  hash_ = other.hash_;
 }
 
 #if JSON_HAS_RVALUE_REFERENCES
-Value::CZString::CZString(CZString&& other)
-  : cstr_(other.cstr_), index_(other.index_) {
+Value::CZString::CZString(CZString&& other) JSONCPP_NOEXCEPT
+  : cstr_(other.cstr_), index_(other.index_), hash_(other.hash_) {
   other.cstr_ = nullptr;
 }
 #endif
@@ -290,19 +371,20 @@ Value::CZString::~CZString() {
 void Value::CZString::swap(CZString& other) {
   std::swap(cstr_, other.cstr_);
   std::swap(index_, other.index_);
+  std::swap(hash_, other.hash_);
 }
 
 Value::CZString& Value::CZString::operator=(const CZString& other) {
   cstr_ = other.cstr_;
   index_ = other.index_;
+  hash_ = other.hash_;
   return *this;
 }
 
 #if JSON_HAS_RVALUE_REFERENCES
 Value::CZString& Value::CZString::operator=(CZString&& other) {
-  cstr_ = other.cstr_;
-  index_ = other.index_;
-  other.cstr_ = nullptr;
+  // the string held so far goes with other, which frees it
+  swap(other);
   return *this;
 }
 #endif
@@ -338,8 +420,191 @@ ArrayIndex Value::CZString::index() const { return index_; }
 //const char* Value::CZString::c_str() const { return cstr_; }
 const char* Value::CZString::data() const { return cstr_; }
 unsigned Value::CZString::length() const { return storage_.length_; }
+unsigned Value::CZString::hash() const { return hash_; }
 bool Value::CZString::isStaticString() const { return storage_.policy_ == noDuplication; }
 
+bool Value::CZString::matches(Key const& key) const {
+  return hash_ == key.hash() && cstr_ && storage_.length_ == key.length() &&
+         memcmp(cstr_, key.data(), key.length()) == 0;
+}
+
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// class Value::ObjectValues
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+
+// up to this many members an object is scanned by hash
+static size_t const objectScanLimit = 16;
+// room made for the members of an object on the first one
+static size_t const objectFirstCapacity = 4;
+
+Value::ObjectValues::ObjectValues(const allocator_type& allocator)
+    : slots_(ArenaAllocator<Slot>(allocator)) {}
+
+Value::ObjectValues::ObjectValues(const ObjectValues& other) {
+  slots_.reserve(other.size());
+  for (const_iterator it = other.begin(); it != other.end(); ++it) {
+    value_type entry(*it);
+    link(end(), entry);
+  }
+}
+
+Value::ObjectValues::~ObjectValues() { clear(); }
+
+void Value::ObjectValues::clear() {
+  for (size_t i = 0; i < slots_.size(); ++i)
+    destroy(slots_[i].entry);
+  slots_.clear();
+}
+
+size_t Value::ObjectValues::lowerBound(const CZString& key) const {
+  // arrays are filled in order, the key usually goes right at the end
+  if (slots_.empty() || slots_.back().entry->first < key)
+    return slots_.size();
+  size_t first = 0;
+  size_t count = slots_.size();
+  while (count > 0) {
+    size_t half = count / 2;
+    if (slots_[first + half].entry->first < key) {
+      first += half + 1;
+      count -= half + 1;
+    } else {
+      count = half;
+    }
+  }
+  return first;
+}
+
+Value::ObjectValues::iterator
+Value::ObjectValues::lower_bound(const CZString& key) {
+  return begin() + static_cast<std::ptrdiff_t>(lowerBound(key));
+}
+
+Value::ObjectValues::iterator Value::ObjectValues::find(const CZString& key) {
+  const ObjectValues& self = *this;
+  return begin() + (self.find(key) - self.begin());
+}
+
+Value::ObjectValues::const_iterator
+Value::ObjectValues::find(const CZString& key) const {
+  if (!key.data()) {
+    // array without holes: the element sits at its index
+    ArrayIndex index = key.index();
+    if (index < slots_.size() && slots_[index].entry->first.index() == index)
+      return begin() + static_cast<std::ptrdiff_t>(index);
+  } else if (slots_.size() <= objectScanLimit) {
+    for (size_t i = 0; i < slots_.size(); ++i) {
+      if (slots_[i].hash == key.hash() && slots_[i].entry->first == key)
+        return begin() + static_cast<std::ptrdiff_t>(i);
+    }
+    return end();
+  }
+  const_iterator it = begin() + static_cast<std::ptrdiff_t>(lowerBound(key));
+  return it != end() && it->first == key ? it : end();
+}
+
+Value::ObjectValues::const_iterator
+Value::ObjectValues::find(const Key& key) const {
+  if (slots_.size() <= objectScanLimit) {
+    for (size_t i = 0; i < slots_.size(); ++i) {
+      if (slots_[i].hash == key.hash() && slots_[i].entry->first.matches(key))
+        return begin() + static_cast<std::ptrdiff_t>(i);
+    }
+    return end();
+  }
+  return find(CZString(key.data(), key.length(), CZString::noDuplication));
+}
+
+Value::ObjectValues::iterator
+Value::ObjectValues::insert(iterator position, const value_type& entry) {
+  position = reserve(position, entry.first);
+  value_type copy(entry);
+  return link(position, copy);
+}
+
+Value::ObjectValues::iterator
+Value::ObjectValues::insert(iterator position, CZString&& key) {
+  position = reserve(position, key);
+  value_type entry(std::move(key), Value());
+  return link(position, entry);
+}
+
+Value::ObjectValues::iterator
+Value::ObjectValues::reserve(iterator position, const CZString& key) {
+  if (slots_.size() < slots_.capacity())
+    return position;
+  // objects mostly have a few members, growing one by one would move them
+  // several times; arrays are left to grow as they go, many are short
+  size_t offset = static_cast<size_t>(position - begin());
+  size_t capacity = slots_.size() * 2;
+  if (capacity == 0)
+    capacity = key.data() ? objectFirstCapacity : 1;
+  slots_.reserve(capacity);
+  return begin() + static_cast<std::ptrdiff_t>(offset);
+}
+
+Value::ObjectValues::iterator
+Value::ObjectValues::link(iterator position, value_type& entry) {
+  // the entry is built before, moving it into its node does not throw
+  ArenaAllocator<value_type> allocator(get_allocator());
+  value_type* node = allocator.allocate(1);
+  new (node) value_type(std::move(entry.first), std::move(entry.second));
+  Slot slot = {node, node->first.hash()};
+  return iterator(slots_.insert(position.slot(), slot));
+}
+
+void Value::ObjectValues::destroy(value_type* entry) {
+  entry->~value_type();
+  ArenaAllocator<value_type>(get_allocator()).deallocate(entry, 1);
+}
+
+void Value::ObjectValues::erase(iterator position) {
+  destroy(&*position);
+  slots_.erase(position.slot());
+}
+
+size_t Value::ObjectValues::erase(const CZString& key) {
+  iterator it = find(key);
+  if (it == end())
+    return 0;
+  erase(it);
+  return 1;
+}
+
+Value& Value::ObjectValues::operator[](const CZString& key) {
+  iterator it = lower_bound(key);
+  if (it == end() || !(it->first == key))
+    it = insert(it, value_type(key, Value()));
+  return it->second;
+}
+
+bool Value::ObjectValues::operator<(const ObjectValues& other) const {
+  return std::lexicographical_compare(begin(), end(), other.begin(), other.end());
+}
+
+bool Value::ObjectValues::operator==(const ObjectValues& other) const {
+  return size() == other.size() && std::equal(begin(), end(), other.begin());
+}
+
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// class Key
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+
+Key::Key(const char* name)
+    : data_(name), length_(static_cast<unsigned>(strlen(name))),
+      hash_(hashKey(data_, length_)) {}
+
+Key::Key(const char* begin, const char* end)
+    : data_(begin), length_(static_cast<unsigned>(end - begin)),
+      hash_(hashKey(data_, length_)) {}
+
 // //////////////////////////////////////////////////////////////////
 // //////////////////////////////////////////////////////////////////
 // //////////////////////////////////////////////////////////////////
@@ -357,6 +622,8 @@ Value::Value(ValueType vtype) {
   initBasic(vtype);
   switch (vtype) {
   case nullValue:
+    // moved around by the containers of the parent
+    value_.uint_ = 0;
     break;
   case intValue:
   case uintValue:
@@ -381,6 +648,21 @@ Value::Value(ValueType vtype) {
   }
 }
 
+Value::Value(ValueType vtype, Arena* arena) {
+  initBasic(nullValue);
+  if (!arena || (vtype != arrayValue && vtype != objectValue)) {
+    Value init(vtype);
+    swapPayload(init);
+    return;
+  }
+  type_ = vtype;
+  typedef ObjectValues::allocator_type Allocator;
+  value_.map_ = new (arena->allocate(sizeof(ObjectValues)))
+      ObjectValues(Allocator(arena));
+  arena_ = true;
+  arena->retain();
+}
+
 Value::Value(Int value) {
   initBasic(intValue);
   value_.int_ = value;
@@ -418,6 +700,17 @@ Value::Value(const char* beginValue, const char* endValue) {
       duplicateAndPrefixStringValue(beginValue, static_cast<unsigned>(endValue - beginValue));
 }
 
+Value::Value(const char* beginValue, const char* endValue, Arena* arena) {
+  initBasic(stringValue, true);
+  unsigned length = static_cast<unsigned>(endValue - beginValue);
+  if (arena) {
+    value_.string_ = duplicateAndPrefixStringValue(beginValue, length, arena);
+    arena_ = true;
+  } else {
+    value_.string_ = duplicateAndPrefixStringValue(beginValue, length);
+  }
+}
+
 Value::Value(const JSONCPP_STRING& value) {
   initBasic(stringValue, true);
   value_.string_ =
@@ -442,7 +735,7 @@ Value::Value(bool value) {
 }
 
 Value::Value(Value const& other)
-    : type_(other.type_), allocated_(false)
+    : type_(other.type_), allocated_(false), arena_(false)
       ,
       comments_(0), start_(other.start_), limit_(other.limit_)
 {
@@ -487,8 +780,9 @@ Value::Value(Value const& other)
 
 #if JSON_HAS_RVALUE_REFERENCES
 // Move constructor
-Value::Value(Value&& other) {
+Value::Value(Value&& other) JSONCPP_NOEXCEPT {
   initBasic(nullValue);
+  value_.uint_ = 0;
   swap(other);
 }
 #endif
@@ -502,12 +796,21 @@ Value::~Value() {
   case booleanValue:
     break;
   case stringValue:
-    if (allocated_)
+    if (arena_)
+      releaseArenaStringValue(value_.string_);
+    else if (allocated_)
       releasePrefixedStringValue(value_.string_);
     break;
   case arrayValue:
   case objectValue:
-    delete value_.map_;
+    if (arena_) {
+      // the nodes go back to nobody, only the members are destroyed
+      Arena* owner = arena();
+      value_.map_->~ObjectValues();
+      owner->release();
+    } else {
+      delete value_.map_;
+    }
     break;
   default:
     JSON_ASSERT_UNREACHABLE;
@@ -518,10 +821,18 @@ Value::~Value() {
   value_.uint_ = 0;
 }
 
-Value& Value::operator=(Value other) {
+Value& Value::operator=(const Value& other) {
+  Value copy(other);
+  swap(copy);
+  return *this;
+}
+
+#if JSON_HAS_RVALUE_REFERENCES
+Value& Value::operator=(Value&& other) JSONCPP_NOEXCEPT {
   swap(other);
   return *this;
 }
+#endif
 
 void Value::swapPayload(Value& other) {
   ValueType temp = type_;
@@ -531,12 +842,16 @@ void Value::swapPayload(Value& other) {
   int temp2 = allocated_;
   allocated_ = other.allocated_;
   other.allocated_ = temp2 & 0x1;
+  int temp3 = arena_;
+  arena_ = other.arena_;
+  other.arena_ = temp3 & 0x1;
 }
 
 void Value::copyPayload(const Value& other) {
   type_ = other.type_;
   value_ = other.value_;
   allocated_ = other.allocated_;
+  arena_ = other.arena_;
 }
 
 void Value::swap(Value& other) {
@@ -1044,6 +1359,7 @@ const Value& Value::operator[](int index) const {
 void Value::initBasic(ValueType vtype, bool allocated) {
   type_ = vtype;
   allocated_ = allocated;
+  arena_ = false;
   comments_ = 0;
   start_ = 0;
   limit_ = 0;
@@ -1084,12 +1400,30 @@ Value& Value::resolveReference(char const* key, char const* cend)
   if (it != value_.map_->end() && (*it).first == actualKey)
     return (*it).second;
 
+  if (Arena* owner = arena()) {
+    // the key is copied into the arena once and moved into the node
+    unsigned length = static_cast<unsigned>(cend - key);
+    char* arenaKey = static_cast<char*>(owner->allocate(length + 1U));
+    memcpy(arenaKey, key, length);
+    arenaKey[length] = 0;
+    it = value_.map_->insert(it, CZString(arenaKey, actualKey, CZString::arenaString));
+    return (*it).second;
+  }
+
   ObjectValues::value_type defaultValue(actualKey, nullSingleton());
   it = value_.map_->insert(it, defaultValue);
   Value& value = (*it).second;
   return value;
 }
 
+Arena* Value::arena() const {
+  if (!arena_)
+    return 0;
+  if (type_ == stringValue)
+    return *reinterpret_cast<Arena* const*>(value_.string_ - sizeof(Arena*));
+  return value_.map_->get_allocator().arena();
+}
+
 Value Value::get(ArrayIndex index, const Value& defaultValue) const {
   const Value* value = &((*this)[index]);
   return value == &nullSingleton() ? defaultValue : *value;
@@ -1108,6 +1442,13 @@ Value const* Value::find(char const* key, char const* cend) const
   if (it == value_.map_->end()) return NULL;
   return &(*it).second;
 }
+Value const* Value::find(Key const& key) const
+{
+  if (type_ != objectValue) return NULL;
+  ObjectValues::const_iterator it = value_.map_->find(key);
+  if (it == value_.map_->end()) return NULL;
+  return &(*it).second;
+}
 const Value& Value::operator[](const char* key) const
 {
   Value const* found = find(key, key + strlen(key));
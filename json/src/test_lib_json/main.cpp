@@ -13,6 +13,7 @@
 #include <limits>
 #include <sstream>
 #include <string>
+#include <vector>
 #include <iomanip>
 
 // Make numeric limits more convenient to talk about.
@@ -1715,6 +1716,117 @@ JSONTEST_FIXTURE(ValueTest, precision) {
     JSONTEST_ASSERT_STRING_EQUAL(expected, result);
 }
 
+JSONTEST_FIXTURE(ValueTest, keyLookup) {
+  const Json::Key idx("idx");
+  const Json::Key missing("idy");
+  // scanned by hash, then searched by name
+  for (int count = 1; count <= 20; count += 19) {
+    Json::Value object(Json::objectValue);
+    for (int i = 0; i < count; ++i)
+      object["m" + std::to_string(i)] = i;
+    object["idx"] = 7;
+    JSONTEST_ASSERT(object.find(idx) != NULL);
+    JSONTEST_ASSERT_EQUAL(7, object.find(idx)->asInt());
+    JSONTEST_ASSERT(object.find(missing) == NULL);
+    JSONTEST_ASSERT_EQUAL(count - 1, object["m" + std::to_string(count - 1)].asInt());
+  }
+  JSONTEST_ASSERT(Json::Value().find(idx) == NULL);
+  JSONTEST_ASSERT(Json::Value(Json::arrayValue).find(idx) == NULL);
+
+  const char name[] = "idx\0tail";
+  Json::Value object;
+  object[JSONCPP_STRING(name, sizeof(name) - 1)] = 1;
+  JSONTEST_ASSERT(object.find(Json::Key(name, name + sizeof(name) - 1)) != NULL);
+  JSONTEST_ASSERT(object.find(idx) == NULL);
+}
+
+JSONTEST_FIXTURE(ValueTest, memberOrder) {
+  Json::Value object;
+  const char* names[] = {"d", "b", "e", "a", "c", "ab"};
+  for (int i = 0; i < 6; ++i)
+    object[names[i]] = i;
+  object.removeMember("e");
+
+  Json::Value::Members members = object.getMemberNames();
+  const char* expected[] = {"a", "ab", "b", "c", "d"};
+  JSONTEST_ASSERT_EQUAL(5u, members.size());
+  for (size_t i = 0; i < members.size(); ++i)
+    JSONTEST_ASSERT_STRING_EQUAL(expected[i], members[i]);
+  JSONTEST_ASSERT_EQUAL(3, object["a"].asInt());
+
+  Json::StreamWriterBuilder b;
+  b.settings_["indentation"] = "";
+  JSONTEST_ASSERT_STRING_EQUAL("{\"a\":3,\"ab\":5,\"b\":1,\"c\":4,\"d\":0}",
+                               Json::writeString(b, object));
+}
+
+JSONTEST_FIXTURE(ValueTest, sparseArrays) {
+  Json::Value array;
+  array[5] = 5;
+  array[2] = 2;
+  JSONTEST_ASSERT_EQUAL(6u, array.size());
+  JSONTEST_ASSERT_EQUAL(2, array[2].asInt());
+  JSONTEST_ASSERT_EQUAL(5, array[5].asInt());
+  JSONTEST_ASSERT(array[3].isNull());
+
+  array.resize(3);
+  JSONTEST_ASSERT_EQUAL(3u, array.size());
+  array.append(3);
+  JSONTEST_ASSERT_EQUAL(3, array[3].asInt());
+}
+
+JSONTEST_FIXTURE(ValueTest, appendOwnElement) {
+  Json::Value array;
+  array.append("first element, too long for any small string buffer");
+  // every append may move the elements, the one copied included
+  for (int i = 0; i < 100; ++i)
+    array.append(array[0]);
+  JSONTEST_ASSERT_EQUAL(101u, array.size());
+  JSONTEST_ASSERT_STRING_EQUAL(array[0].asString(), array[100].asString());
+}
+
+JSONTEST_FIXTURE(ValueTest, referenceStability) {
+  // inserting or removing members leaves references to the others valid
+  Json::Value root;
+  Json::Value& list = root["list"];
+  for (int i = 0; i < 20; ++i)
+    root["m" + std::to_string(i)] = i;
+  list.append(1);
+  JSONTEST_ASSERT_EQUAL(1u, root["list"].size());
+  JSONTEST_ASSERT_EQUAL(&list, &root["list"]);
+
+  root.removeMember("m0");
+  root["a"] = "first in order";
+  JSONTEST_ASSERT_EQUAL(&list, &root["list"]);
+
+  Json::Value array;
+  Json::Value& first = array.append("first element, too long for a small string");
+  for (int i = 0; i < 100; ++i)
+    array.append(i);
+  JSONTEST_ASSERT_EQUAL(&first, &array[0]);
+  JSONTEST_ASSERT_STRING_EQUAL("first element, too long for a small string",
+                               first.asString());
+
+  // the same holds for documents parsed into an arena
+  Json::CharReaderBuilder builder;
+  builder.settings_["useArena"] = true;
+  Json::Value parsed;
+  JSONCPP_STRING errors;
+  const char doc[] = "{\"b\": {\"x\": 1}, \"d\": [1, 2]}";
+  std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+  JSONTEST_ASSERT(reader->parse(doc, doc + sizeof(doc) - 1, &parsed, &errors));
+  Json::Value& b = parsed["b"];
+  Json::Value& d = parsed["d"];
+  for (int i = 0; i < 20; ++i) {
+    parsed["m" + std::to_string(i)] = i;
+    d.append(i);
+  }
+  parsed["a"] = 0;
+  JSONTEST_ASSERT_EQUAL(&b, &parsed["b"]);
+  JSONTEST_ASSERT_EQUAL(1, b["x"].asInt());
+  JSONTEST_ASSERT_EQUAL(22u, d.size());
+}
+
 struct WriterTest : JsonTest::TestCase {};
 
 JSONTEST_FIXTURE(WriterTest, dropNullPlaceholders) {
@@ -2398,6 +2510,230 @@ JSONTEST_FIXTURE(CharReaderAllowSpecialFloatsTest, issue209) {
   delete reader;
 }
 
+struct EventParserTest : JsonTest::TestCase {};
+
+// writes every event as a token, so a whole document is checked with one comparison
+struct EventTrace : Json::EventHandler {
+  JSONCPP_STRING trace;
+  const char* lastString;
+  int stopAt;
+
+  EventTrace() : lastString(0), stopAt(-1) {}
+  bool add(const JSONCPP_STRING& event) {
+    trace += event + " ";
+    return stopAt < 0 || --stopAt > 0;
+  }
+  bool onNull() JSONCPP_OVERRIDE { return add("null"); }
+  bool onBool(bool value) JSONCPP_OVERRIDE { return add(value ? "true" : "false"); }
+  bool onInt(Json::LargestInt value) JSONCPP_OVERRIDE {
+    return add("i" + Json::valueToString(value));
+  }
+  bool onUInt(Json::LargestUInt value) JSONCPP_OVERRIDE {
+    return add("u" + Json::valueToString(value));
+  }
+  bool onDouble(double value) JSONCPP_OVERRIDE {
+    return add("d" + Json::valueToString(value));
+  }
+  bool onString(char const* begin, char const* end) JSONCPP_OVERRIDE {
+    lastString = begin;
+    return add("'" + JSONCPP_STRING(begin, end) + "'");
+  }
+  bool onKey(char const* begin, char const* end) JSONCPP_OVERRIDE {
+    return add(JSONCPP_STRING(begin, end) + ":");
+  }
+  bool onObjectBegin() JSONCPP_OVERRIDE { return add("{"); }
+  bool onObjectEnd() JSONCPP_OVERRIDE { return add("}"); }
+  bool onArrayBegin() JSONCPP_OVERRIDE { return add("["); }
+  bool onArrayEnd() JSONCPP_OVERRIDE { return add("]"); }
+};
+
+JSONTEST_FIXTURE(EventParserTest, events) {
+  EventTrace handler;
+  JSONCPP_STRING errs;
+  char const doc[] =
+      " { \"trains\" : [ { \"idx\": 1, \"speed\": -1, \"events\": [] } ],"
+      " \"a\": [true, false, null, {}], \"b\": \"x\" } ";
+  bool ok = Json::parseEvents(doc, doc + std::strlen(doc), handler, &errs);
+  JSONTEST_ASSERT(ok);
+  JSONTEST_ASSERT(errs.size() == 0);
+  JSONTEST_ASSERT_STRING_EQUAL(
+      "{ trains: [ { idx: i1 speed: i-1 events: [ ] } ] "
+      "a: [ true false null { } ] b: 'x' } ",
+      handler.trace);
+  // strings without escapes are passed in place
+  JSONTEST_ASSERT(handler.lastString == std::strrchr(doc, 'x'));
+}
+
+JSONTEST_FIXTURE(EventParserTest, numbers) {
+  EventTrace handler;
+  char const doc[] = "[0, -0, 4294967296, 9223372036854775807, -9223372036854775808,"
+                     " 18446744073709551615, 18446744073709551616, 1.5, -2e3]";
+  bool ok = Json::parseEvents(doc, doc + std::strlen(doc), handler, 0);
+  JSONTEST_ASSERT(ok);
+  JSONTEST_ASSERT_STRING_EQUAL(
+      "[ i0 i0 i4294967296 i9223372036854775807 i-9223372036854775808 "
+      "u18446744073709551615 d1.8446744073709552e+19 d1.5 d-2000.0 ] ",
+      handler.trace);
+}
+
+JSONTEST_FIXTURE(EventParserTest, escapes) {
+  EventTrace handler;
+  char const doc[] = "{\"k\\\"ey\": \"a\\n\\u00e9\\ud83d\\ude00\"}";
+  bool ok = Json::parseEvents(doc, doc + std::strlen(doc), handler, 0);
+  JSONTEST_ASSERT(ok);
+  JSONTEST_ASSERT_STRING_EQUAL(
+      "{ k\"ey: 'a\n\xc3\xa9\xf0\x9f\x98\x80' } ", handler.trace);
+}
+
+JSONTEST_FIXTURE(EventParserTest, errors) {
+  char const* docs[] = {"", "{", "[1,]", "{\"a\" 1}", "[1] 2", "\"abc",
+                        "[\"\\u12\"]", "tru", "-", "// comment\n1"};
+  for (size_t i = 0; i < sizeof(docs) / sizeof(docs[0]); ++i) {
+    EventTrace handler;
+    JSONCPP_STRING errs;
+    bool ok = Json::parseEvents(docs[i], docs[i] + std::strlen(docs[i]), handler, &errs);
+    JSONTEST_ASSERT(!ok);
+    JSONTEST_ASSERT(errs.find("* Offset ") == 0);
+  }
+}
+
+JSONTEST_FIXTURE(EventParserTest, stopByHandler) {
+  EventTrace handler;
+  handler.stopAt = 3;
+  JSONCPP_STRING errs;
+  char const doc[] = "[1, 2, 3, 4]";
+  bool ok = Json::parseEvents(doc, doc + std::strlen(doc), handler, &errs);
+  JSONTEST_ASSERT(!ok);
+  JSONTEST_ASSERT_STRING_EQUAL("[ i1 i2 ", handler.trace);
+  JSONTEST_ASSERT_STRING_EQUAL("* Offset 5\n  Parse stopped by the handler.\n", errs);
+}
+
+struct ScanTest : JsonTest::TestCase {};
+
+// parses from a buffer of the exact document size, so reads past the end show
+// up under the address sanitizer
+static bool parseExact(const JSONCPP_STRING& doc, Json::Value* root,
+                       EventTrace* handler) {
+  std::vector<char> buffer(doc.begin(), doc.end());
+  const char* begin = buffer.empty() ? 0 : &buffer[0];
+  if (handler)
+    return Json::parseEvents(begin, begin + buffer.size(), *handler, 0);
+  Json::CharReaderBuilder b;
+  Json::CharReader* reader(b.newCharReader());
+  JSONCPP_STRING errs;
+  bool ok = reader->parse(begin, begin + buffer.size(), root, &errs);
+  delete reader;
+  return ok;
+}
+
+JSONTEST_FIXTURE(ScanTest, longStrings) {
+  // escapes and the closing quote at every offset of the 16 and 32 byte blocks
+  for (size_t length = 0; length < 80; ++length) {
+    for (size_t at = 0; at < length; at += 7) {
+      JSONCPP_STRING text(length, 'a');
+      JSONCPP_STRING escaped = text.substr(0, at) + "\\\"" + text.substr(at);
+      text.insert(at, "\"");
+      JSONCPP_STRING doc = "[\"" + escaped + "\", \"" + JSONCPP_STRING(length, 'b') + "\"]";
+
+      Json::Value root;
+      JSONTEST_ASSERT(parseExact(doc, &root, 0)) << doc;
+      JSONTEST_ASSERT_STRING_EQUAL(text, root[0].asString());
+      JSONTEST_ASSERT_STRING_EQUAL(JSONCPP_STRING(length, 'b'), root[1].asString());
+
+      EventTrace handler;
+      JSONTEST_ASSERT(parseExact(doc, 0, &handler)) << doc;
+      JSONTEST_ASSERT_STRING_EQUAL(
+          "[ '" + text + "' '" + JSONCPP_STRING(length, 'b') + "' ] ", handler.trace);
+    }
+  }
+}
+
+JSONTEST_FIXTURE(ScanTest, longSpaces) {
+  const char spaces[] = " \t\r\n";
+  for (size_t length = 0; length < 80; ++length) {
+    JSONCPP_STRING gap;
+    for (size_t i = 0; i < length; ++i)
+      gap += spaces[i % 4];
+    JSONCPP_STRING doc = gap + "{" + gap + "\"k\"" + gap + ":" + gap + "[1," + gap +
+                         "2]" + gap + "}" + gap;
+
+    Json::Value root;
+    JSONTEST_ASSERT(parseExact(doc, &root, 0)) << length;
+    JSONTEST_ASSERT_EQUAL(2, root["k"][1].asInt());
+
+    EventTrace handler;
+    JSONTEST_ASSERT(parseExact(doc, 0, &handler)) << length;
+    JSONTEST_ASSERT_STRING_EQUAL("{ k: [ i1 i2 ] } ", handler.trace);
+  }
+}
+
+JSONTEST_FIXTURE(ScanTest, unterminated) {
+  for (size_t length = 0; length < 80; ++length) {
+    JSONCPP_STRING body(length, 'a');
+    const JSONCPP_STRING docs[] = {"\"" + body, "\"" + body + "\\",
+                                   "[\"" + body + "\\\"", "[" + JSONCPP_STRING(length, ' ')};
+    for (size_t i = 0; i < sizeof(docs) / sizeof(docs[0]); ++i) {
+      Json::Value root;
+      JSONTEST_ASSERT(!parseExact(docs[i], &root, 0)) << docs[i];
+      EventTrace handler;
+      JSONTEST_ASSERT(!parseExact(docs[i], 0, &handler)) << docs[i];
+    }
+  }
+}
+
+struct CharReaderArenaTest : JsonTest::TestCase {};
+
+static bool parseDocument(char const* doc, bool useArena, Json::Value* root) {
+  Json::CharReaderBuilder b;
+  b["useArena"] = useArena;
+  Json::CharReader* reader(b.newCharReader());
+  JSONCPP_STRING errs;
+  bool ok = reader->parse(doc, doc + std::strlen(doc), root, &errs);
+  delete reader;
+  return ok;
+}
+
+JSONTEST_FIXTURE(CharReaderArenaTest, sameAsHeap) {
+  char const doc[] = "{ \"trains\": [ {\"idx\": 1, \"player_idx\": \"a\\u00e9\"},"
+                     " {\"idx\": 2, \"events\": []} ], \"name\": \"map02\", \"size\": [10, 20] }";
+  Json::Value heap;
+  Json::Value arena;
+  JSONTEST_ASSERT(parseDocument(doc, false, &heap));
+  JSONTEST_ASSERT(parseDocument(doc, true, &arena));
+  JSONTEST_ASSERT(heap == arena);
+  JSONTEST_ASSERT_STRING_EQUAL("a\xc3\xa9", arena["trains"][0]["player_idx"].asString());
+  JSONTEST_ASSERT_EQUAL(2, arena["trains"][1]["idx"].asInt());
+}
+
+JSONTEST_FIXTURE(CharReaderArenaTest, valuesOutliveDocument) {
+  char const doc[] = "{ \"a\": { \"key\": \"value\" }, \"b\": [\"x\", \"y\"], \"c\": \"z\" }";
+  Json::Value copy;
+  Json::Value moved;
+  Json::Value str;
+  {
+    Json::Value root;
+    JSONTEST_ASSERT(parseDocument(doc, true, &root));
+    copy = root["a"];
+    moved.swap(root["b"]);
+    str.swap(root["c"]);
+    // members added later are owned by the document as usual
+    root["a"]["added"] = JSONCPP_STRING(100, 'q');
+    root["d"] = root;
+  }
+  JSONTEST_ASSERT_STRING_EQUAL("value", copy["key"].asString());
+  JSONTEST_ASSERT_STRING_EQUAL("y", moved[1].asString());
+  JSONTEST_ASSERT_STRING_EQUAL("z", str.asString());
+  moved.append("w");
+  JSONTEST_ASSERT_EQUAL(3u, moved.size());
+}
+
+JSONTEST_FIXTURE(CharReaderArenaTest, failedParse) {
+  Json::Value root;
+  JSONTEST_ASSERT(!parseDocument("{ \"a\": [1, 2", true, &root));
+  JSONTEST_ASSERT(parseDocument("\"top\"", true, &root));
+  JSONTEST_ASSERT_STRING_EQUAL("top", root.asString());
+}
+
 struct BuilderTest : JsonTest::TestCase {};
 
 JSONTEST_FIXTURE(BuilderTest, settings) {
@@ -2543,6 +2879,11 @@ int main(int argc, const char* argv[]) {
   JSONTEST_REGISTER_FIXTURE(runner, ValueTest, zeroesInKeys);
   JSONTEST_REGISTER_FIXTURE(runner, ValueTest, specialFloats);
   JSONTEST_REGISTER_FIXTURE(runner, ValueTest, precision);
+  JSONTEST_REGISTER_FIXTURE(runner, ValueTest, keyLookup);
+  JSONTEST_REGISTER_FIXTURE(runner, ValueTest, memberOrder);
+  JSONTEST_REGISTER_FIXTURE(runner, ValueTest, sparseArrays);
+  JSONTEST_REGISTER_FIXTURE(runner, ValueTest, appendOwnElement);
+  JSONTEST_REGISTER_FIXTURE(runner, ValueTest, referenceStability);
 
   JSONTEST_REGISTER_FIXTURE(runner, WriterTest, dropNullPlaceholders);
   JSONTEST_REGISTER_FIXTURE(runner, StreamWriterTest, dropNullPlaceholders);
@@ -2579,6 +2920,20 @@ int main(int argc, const char* argv[]) {
 
   JSONTEST_REGISTER_FIXTURE(runner, CharReaderAllowSpecialFloatsTest, issue209);
 
+  JSONTEST_REGISTER_FIXTURE(runner, CharReaderArenaTest, sameAsHeap);
+  JSONTEST_REGISTER_FIXTURE(runner, CharReaderArenaTest, valuesOutliveDocument);
+  JSONTEST_REGISTER_FIXTURE(runner, CharReaderArenaTest, failedParse);
+
+  JSONTEST_REGISTER_FIXTURE(runner, EventParserTest, events);
+  JSONTEST_REGISTER_FIXTURE(runner, EventParserTest, numbers);
+  JSONTEST_REGISTER_FIXTURE(runner, EventParserTest, escapes);
+  JSONTEST_REGISTER_FIXTURE(runner, EventParserTest, errors);
+  JSONTEST_REGISTER_FIXTURE(runner, EventParserTest, stopByHandler);
+
+  JSONTEST_REGISTER_FIXTURE(runner, ScanTest, longStrings);
+  JSONTEST_REGISTER_FIXTURE(runner, ScanTest, longSpaces);
+  JSONTEST_REGISTER_FIXTURE(runner, ScanTest, unterminated);
+
   JSONTEST_REGISTER_FIXTURE(runner, BuilderTest, settings);
 
   JSONTEST_REGISTER_FIXTURE(runner, IteratorTest, distance);
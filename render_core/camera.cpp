@@ -235,6 +235,30 @@ bool Camera::worldPosToScreenPos(const Vector3& worldPos, ScreenPos& screenPos)
 	return true;
 }
 
+void Camera::screenPosToRay(int x, int y, Vector3& origin, Vector3& dir) const
+{
+	float xClip = 2.0f * float(x) / float(m_screenWidth) - 1.0f;
+	float yClip = 1.0f - 2.0f * float(y) / float(m_screenHeight);
+
+	origin = m_invView.applyPoint(nearPlanePoint(xClip, yClip));
+	dir = m_invView.applyPoint(farPlanePoint(xClip, yClip)) - origin;
+	dir.Normalize();
+}
+
+void Camera::frustumPlanes(Vector4 planes[6]) const
+{
+	const Matrix& m = m_viewProjection;
+	for (int i = 0; i < 4; ++i)
+	{
+		planes[0](i) = m(i, 3) + m(i, 0);
+		planes[1](i) = m(i, 3) - m(i, 0);
+		planes[2](i) = m(i, 3) + m(i, 1);
+		planes[3](i) = m(i, 3) - m(i, 1);
+		planes[4](i) = m(i, 2);
+		planes[5](i) = m(i, 3) - m(i, 2);
+	}
+}
+
 void Camera::updateProjection()
 {
 	D3DXMatrixPerspectiveFovLH(&m_proj, m_fov, m_aspectRatio, m_nearPlane, m_farPlane);
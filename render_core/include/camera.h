@@ -57,6 +57,10 @@ public:
 	const Vector3& pos() const;
 
 	bool worldPosToScreenPos(const Vector3& worldPos, ScreenPos& screenPos);
+	// ray from the near plane through a pixel of the screen, dir is normalized
+	void screenPosToRay(int x, int y, Vector3& origin, Vector3& dir) const;
+	// left, right, bottom, top, near, far planes of the view, (a, b, c, d) with normals pointing inside
+	void frustumPlanes(Vector4 planes[6]) const;
 
 
 private: